@@ -42,6 +42,8 @@
 #include <libnautilus-extension/nautilus-info-provider.h>
 #include <nautilus-directory.h>
 #include "nautilus-directory-private.h"
+#include "nautilus-directory-snapshot.h"
+#include "nautilus-item-count.h"
 
 
 #include "nautilus-file-private.h"
@@ -68,9 +70,39 @@
 
 #define DIRECTORY_LOAD_ITEMS_PER_CALLBACK 100
 
+/* The file list load asks for more files per callback while batches
+ * come back quickly, and fewer when they take long, aiming for one
+ * batch every DIRECTORY_LOAD_BATCH_USECS.
+ */
+#define DIRECTORY_LOAD_MIN_ITEMS_PER_CALLBACK 25
+#define DIRECTORY_LOAD_MAX_ITEMS_PER_CALLBACK 3200
+#define DIRECTORY_LOAD_BATCH_USECS 20000
+
+/* Local directories are counted this many at a time in a worker thread,
+ * taken from the files queued after the one whose count is wanted.
+ */
+#define LOCAL_COUNT_BATCH_SIZE 64
+#define LOCAL_COUNT_LOOK_AHEAD 256
+
+/* Time one dequeue idle may spend turning infos into files, so the
+ * view still redraws every frame while a huge directory loads.
+ */
+#define DEQUEUE_PENDING_BUDGET_USECS 8000
+
 /* Keep async. jobs down to this number for all directories. */
 #define MAX_ASYNC_JOBS 10
 
+/* File info queries of a directory run as one job. Queries to a slow
+ * backend mostly wait, so more of them are kept in progress the longer
+ * they take: one per FILE_INFO_LATENCY_PER_QUERY_USECS of the average
+ * latency, up to MAX_FILE_INFO_QUERIES.
+ */
+#define MAX_FILE_INFO_QUERIES 16
+#define FILE_INFO_LATENCY_PER_QUERY_USECS 500
+
+/* How far into the high priority queue to look for files to query */
+#define FILE_INFO_LOOK_AHEAD 64
+
 struct TopLeftTextReadState {
 	NautilusDirectory *directory;
 	NautilusFile *file;
@@ -111,6 +143,8 @@ struct DirectoryLoadState {
 	GHashTable *load_mime_list_hash;
 	NautilusFile *load_directory_file;
 	int load_file_count;
+	int items_per_callback;
+	gint64 request_time;
 };
 
 struct MimeListState {
@@ -123,7 +157,9 @@ struct MimeListState {
 
 struct GetInfoState {
 	NautilusDirectory *directory;
+	NautilusFile *file;
 	GCancellable *cancellable;
+	gint64 start_time;
 };
 
 struct NewFilesState {
@@ -140,15 +176,29 @@ struct DirectoryCountState {
 	int file_count;
 };
 
+typedef struct {
+	GPtrArray *files; /* NautilusFile, count_file first */
+	GPtrArray *paths;
+	int *counts;      /* -1 where counting failed */
+} LocalCountBatch;
+
 struct DeepCountState {
 	NautilusDirectory *directory;
 	GCancellable *cancellable;
 	GFileEnumerator *enumerator;
 	GFile *deep_count_location;
 	GList *deep_count_subdirectories;
-	GArray *seen_deep_count_inodes;
+	GHashTable *seen_deep_count_inodes;
 };
 
+/* Key for the set of hard-link candidates seen during a deep count.
+ * An inode number is only unique within a device.
+ */
+typedef struct {
+	guint64 device;
+	guint64 inode;
+} DeepCountInode;
+
 
 
 typedef struct {
@@ -193,6 +243,11 @@ static GHashTable *async_jobs;
 /* Hide kde trashcan directory */
 static char *kde_trash_dir_name = NULL;
 
+/* Bumped when a preference that decides whether files lack some
+ * attribute changes, so that every directory counts them again.
+ */
+static unsigned int missing_counts_generation;
+
 /* Forward declarations for functions that need them. */
 static void     deep_count_load                               (DeepCountState         *state,
 							       GFile                  *location);
@@ -202,6 +257,7 @@ static _Bool request_is_satisfied                          (NautilusDirectory
 static void     cancel_loading_attributes                     (NautilusDirectory      *directory,
 							       NautilusFileAttributes  file_attributes);
 static void     add_all_files_to_work_queue                   (NautilusDirectory      *directory);
+static _Bool    lacks_info                                    (NautilusFile           *file);
 static void     link_info_done                                (NautilusDirectory      *directory,
 							       NautilusFile           *file,
 							       const char             *uri,
@@ -209,10 +265,9 @@ static void     link_info_done                                (NautilusDirectory
 							       GIcon                  *icon,
 							       _Bool                is_launcher,
 							       _Bool                is_foreign);
-static void     move_file_to_low_priority_queue               (NautilusDirectory      *directory,
-							       NautilusFile           *file);
-static void     move_file_to_extension_queue                  (NautilusDirectory      *directory,
-							       NautilusFile           *file);
+static void     move_file_to_next_work_queue                  (NautilusDirectory      *directory,
+							       NautilusFile           *file,
+							       WorkQueueType           type);
 static void     nautilus_directory_invalidate_file_attributes (NautilusDirectory      *directory,
 							       NautilusFileAttributes  file_attributes);
 
@@ -584,18 +639,27 @@ mount_cancel (NautilusDirectory *directory)
 }
 
 static void
-file_info_cancel (NautilusDirectory *directory)
+get_info_cancel (NautilusDirectory *directory, GetInfoState *state)
 {
-  if (directory->details->get_info_in_progress != NULL) {
-    g_cancellable_cancel (directory->details->get_info_in_progress->cancellable);
-    directory->details->get_info_in_progress->directory = NULL;
-    directory->details->get_info_in_progress = NULL;
-    directory->details->get_info_file = NULL;
+  g_cancellable_cancel (state->cancellable);
+  state->directory = NULL;
+
+  directory->details->get_info_in_progress =
+  g_list_remove (directory->details->get_info_in_progress, state);
 
+  if (directory->details->get_info_in_progress == NULL) {
     async_job_end (directory, "file info");
   }
 }
 
+static void
+file_info_cancel (NautilusDirectory *directory)
+{
+  while (directory->details->get_info_in_progress != NULL) {
+    get_info_cancel (directory, directory->details->get_info_in_progress->data);
+  }
+}
+
 static void
 new_files_cancel (NautilusDirectory *directory)
 {
@@ -869,18 +933,41 @@ should_skip_file (NautilusDirectory *directory, GFileInfo *info)
     return ret_val;
 }
 
+/* Remembers the listing for the next time the directory is opened */
+static void
+directory_save_snapshot (NautilusDirectory *directory)
+{
+  char *uri;
+
+  if (directory->details->snapshot_mtime == 0) {
+    return;
+  }
+
+  uri = nautilus_directory_get_uri (directory);
+  nautilus_directory_snapshot_save (uri,
+                                    directory->details->snapshot_mtime,
+                                    directory->details->snapshot_ctime,
+                                    directory->details->file_list);
+  g_free (uri);
+
+  directory->details->snapshot_mtime = 0;
+  directory->details->snapshot_ctime = 0;
+}
+
 /* Is really _Bool but glib errently defines gboolean as int */
 static int
 dequeue_pending_idle_callback (void * callback_data)
 {
   NautilusDirectory *directory;
-  GList *pending_file_info;
+  GPtrArray *pending_file_info;
   GList *node, *next;
   NautilusFile *file;
   GList *changed_files, *added_files;
   GFileInfo *file_info;
-  const char *mimetype, *name;
-  DirectoryLoadState *dir_load_state;
+  const char *name;
+  _Bool more_pending;
+  gint64 start_time;
+  unsigned int i;
 
   directory = NAUTILUS_DIRECTORY (callback_data);
 
@@ -888,45 +975,43 @@ dequeue_pending_idle_callback (void * callback_data)
 
   directory->details->dequeue_pending_idle_id = 0;
 
-  /* Handle the files in the order we saw them. */
-  pending_file_info = g_list_reverse (directory->details->pending_file_info);
-  directory->details->pending_file_info = NULL;
+  /* The files are already in the order we saw them. */
+  pending_file_info = directory->details->pending_file_info;
+  i = directory->details->pending_file_info_head;
 
   /* If we are no longer monitoring, then throw away these. */
   if (!nautilus_directory_is_file_list_monitored (directory)) {
+    if (pending_file_info != NULL) {
+      g_ptr_array_set_size (pending_file_info, 0);
+    }
+    directory->details->pending_file_info_head = 0;
     nautilus_directory_async_state_changed (directory);
     goto drain;
   }
 
+  /* Paint what the snapshot had before looking at the live listing */
+  if (directory->details->snapshot_added_files != NULL) {
+    added_files = directory->details->snapshot_added_files;
+    directory->details->snapshot_added_files = NULL;
+    nautilus_directory_emit_files_added (directory, added_files);
+    nautilus_file_list_free (added_files);
+  }
+
   added_files = NULL;
   changed_files = NULL;
 
-  dir_load_state = directory->details->directory_load_in_progress;
+  start_time = g_get_monotonic_time ();
 
-  /* Build a list of NautilusFile objects. */
-  for (node = pending_file_info; node != NULL; node = node->next) {
-    file_info = node->data;
+  /* Build a list of NautilusFile objects, until the time is up. */
+  while (pending_file_info != NULL && i < pending_file_info->len) {
+    if (i % 32 == 31 &&
+        g_get_monotonic_time () - start_time > DEQUEUE_PENDING_BUDGET_USECS) {
+      break;
+    }
 
-    name = g_file_info_get_name (file_info);
+    file_info = g_ptr_array_index (pending_file_info, i++);
 
-    /* Update the file count. */
-    /* FIXME bugzilla.gnome.org 45063: This could count a
-     * file twice if we get it from both load_directory
-     * and from new_files_callback. Not too hard to fix by
-     * moving this into the actual callback instead of
-     * waiting for the idle function.
-     */
-    if (dir_load_state &&
-      !should_skip_file (directory, file_info)) {
-      dir_load_state->load_file_count += 1;
-
-    /* Add the MIME type to the set. */
-    mimetype = g_file_info_get_content_type (file_info);
-    if (mimetype != NULL) {
-      istr_set_insert (dir_load_state->load_mime_list_hash,
-                       mimetype);
-    }
-      }
+    name = g_file_info_get_name (file_info);
 
       /* check if the file already exists */
       file = nautilus_directory_find_file_by_name (directory, name);
@@ -956,10 +1041,27 @@ dequeue_pending_idle_callback (void * callback_data)
       }
   }
 
+  more_pending = pending_file_info != NULL && i < pending_file_info->len;
+
+  /* Drop the handled infos, all at once when done and otherwise
+   * only when they are most of the array, so the copying stays
+   * proportional to the number of files.
+   */
+  if (!more_pending) {
+    if (pending_file_info != NULL) {
+      g_ptr_array_set_size (pending_file_info, 0);
+    }
+    i = 0;
+  } else if (i > pending_file_info->len / 2) {
+    g_ptr_array_remove_range (pending_file_info, 0, i);
+    i = 0;
+  }
+  directory->details->pending_file_info_head = i;
+
   /* If we are done loading, then we assume that any unconfirmed
    * files are gone.
    */
-  if (directory->details->directory_loaded) {
+  if (directory->details->directory_loaded && !more_pending) {
     for (node = directory->details->file_list;
          node != NULL; node = next) {
       file = NAUTILUS_FILE (node->data);
@@ -980,36 +1082,23 @@ dequeue_pending_idle_callback (void * callback_data)
   nautilus_directory_emit_files_added (directory, added_files);
   nautilus_file_list_free (added_files);
 
-  if (directory->details->directory_loaded &&
+  if (more_pending) {
+    /* Let the main loop breathe, then carry on */
+    nautilus_directory_schedule_dequeue_pending (directory);
+  } else if (directory->details->directory_loaded &&
      !directory->details->directory_loaded_sent_notification)
   {
+    directory_save_snapshot (directory);
+
     /* Send the done_loading signal. */
     nautilus_directory_emit_done_loading (directory);
 
-    if (dir_load_state) {
-      file = dir_load_state->load_directory_file;
-
-      file->details->directory_count = dir_load_state->load_file_count;
-      file->details->directory_count_is_up_to_date = TRUE;
-      file->details->got_directory_count = TRUE;
-
-      file->details->got_mime_list = TRUE;
-      file->details->mime_list_is_up_to_date = TRUE;
-      g_list_free_full (file->details->mime_list, g_free);
-      file->details->mime_list = istr_set_get_as_list
-      (dir_load_state->load_mime_list_hash);
-
-      nautilus_file_changed (file);
-    }
-
     nautilus_directory_async_state_changed (directory);
 
     directory->details->directory_loaded_sent_notification = TRUE;
   }
 
   drain:
-  g_list_free_full (pending_file_info, g_object_unref);
-
   /* Get the state machine running again. */
   nautilus_directory_async_state_changed (directory);
 
@@ -1026,6 +1115,7 @@ nautilus_directory_schedule_dequeue_pending (NautilusDirectory *directory)
   }
 }
 
+/* Takes over the caller's reference to info */
 static void
 directory_load_one (NautilusDirectory *directory,
                     GFileInfo *info)
@@ -1041,13 +1131,16 @@ directory_load_one (NautilusDirectory *directory,
     g_warning ("Got GFileInfo with NULL name in %s, ignoring. This shouldn't happen unless the gvfs backend is broken.\n", uri);
     g_free (uri);
 
+    g_object_unref (info);
     return;
   }
 
   /* Arrange for the "loading" part of the work. */
-  g_object_ref (info);
-  directory->details->pending_file_info
-  = g_list_prepend (directory->details->pending_file_info, info);
+  if (directory->details->pending_file_info == NULL) {
+    directory->details->pending_file_info =
+      g_ptr_array_new_with_free_func (g_object_unref);
+  }
+  g_ptr_array_add (directory->details->pending_file_info, info);
   nautilus_directory_schedule_dequeue_pending (directory);
 }
 
@@ -1081,30 +1174,85 @@ remove_callback (void *key, void *value, void *user_data)
 static void
 file_list_cancel (NautilusDirectory *directory)
 {
+	GList *node;
+
 	directory_load_cancel (directory);
 
 
 	EEL_SOURCE_REMOVE_IF_THEN_ZERO (directory->details->dequeue_pending_idle_id);
 
 	if (directory->details->pending_file_info != NULL) {
-		g_list_free_full (directory->details->pending_file_info, g_object_unref);
+		g_ptr_array_unref (directory->details->pending_file_info);
 		directory->details->pending_file_info = NULL;
 	}
+	directory->details->pending_file_info_head = 0;
+
+	/* Never announced, so the next load has to announce them */
+	for (node = directory->details->snapshot_added_files; node != NULL; node = node->next) {
+		NAUTILUS_FILE (node->data)->details->is_added = FALSE;
+	}
+
+	/* Files left waiting for the load to bring their info have to
+	 * get it on their own now.
+	 */
+	for (node = directory->details->file_list; node != NULL; node = node->next) {
+		if (lacks_info (NAUTILUS_FILE (node->data))) {
+			nautilus_directory_add_file_to_work_queue (directory, node->data);
+		}
+	}
+	nautilus_file_list_free (directory->details->snapshot_added_files);
+	directory->details->snapshot_added_files = NULL;
+	directory->details->snapshot_mtime = 0;
+	directory->details->snapshot_ctime = 0;
 
 	if (directory->details->hidden_file_hash) {
 		g_hash_table_foreach_remove (directory->details->hidden_file_hash,(GHRFunc) remove_callback, NULL);
 	}
 }
 
+/* The counts are complete once the enumeration is, even though the
+ * files may take a few more idles to be dequeued.
+ */
+static void
+directory_load_set_counts (DirectoryLoadState *state)
+{
+  NautilusFile *file;
+
+  file = state->load_directory_file;
+  if (file == NULL) {
+    return;
+  }
+
+  file->details->directory_count = state->load_file_count;
+  file->details->directory_count_is_up_to_date = TRUE;
+  file->details->got_directory_count = TRUE;
+
+  file->details->got_mime_list = TRUE;
+  file->details->mime_list_is_up_to_date = TRUE;
+  g_list_free_full (file->details->mime_list, g_free);
+  file->details->mime_list = istr_set_get_as_list
+  (state->load_mime_list_hash);
+
+  nautilus_file_changed (file);
+}
+
 static void
 directory_load_done (NautilusDirectory *directory, GError *error)
 {
   GList *node;
 
+  if (directory->details->directory_load_in_progress != NULL) {
+    directory_load_set_counts (directory->details->directory_load_in_progress);
+  }
+
   directory->details->directory_loaded = TRUE;
   directory->details->directory_loaded_sent_notification = FALSE;
 
   if (error != NULL) {
+    /* Keep the snapshot we have, this listing is not complete */
+    directory->details->snapshot_mtime = 0;
+    directory->details->snapshot_ctime = 0;
+
     /* The load did not complete successfully. This means
      * we don't know the status of the files in this directory.
      * We clear the unconfirmed bit on each file here so that
@@ -1367,6 +1515,10 @@ nautilus_directory_call_when_ready_internal (NautilusDirectory        *directory
        g_memdup (&callback, sizeof (callback)));
       request_counter_add_request (directory->details->call_when_ready_counters,
                                    callback.request);
+      if (file == NULL) {
+        request_counter_add_request (directory->details->call_when_ready_directory_counters,
+                                     callback.request);
+      }
 
       /* Put the callback file or all the files on the work queue. */
       if (file != NULL) {
@@ -1408,6 +1560,10 @@ remove_callback_link_keep_data (NautilusDirectory *directory,
 
 	request_counter_remove_request (directory->details->call_when_ready_counters,
 					callback->request);
+	if (callback->file == NULL && callback->active) {
+		request_counter_remove_request (directory->details->call_when_ready_directory_counters,
+						callback->request);
+	}
 	g_list_free_1 (link);
 }
 
@@ -1503,10 +1659,7 @@ new_files_callback (GObject *source_object, GAsyncResult *res, void *user_data)
 
       /* Queue up the new file. */
       info = g_file_query_info_finish (G_FILE (source_object), res, NULL);
-      if (info != NULL) {
-        directory_load_one (directory, info);
-        g_object_unref (info);
-      }
+      directory_load_one (directory, info);
 
       new_files_state_unref (state);
 
@@ -1557,6 +1710,7 @@ nautilus_async_destroying_file (NautilusFile *file)
 	GList *node, *next;
 	ReadyCallback *callback;
 	Monitor *monitor;
+	GetInfoState *get_info_state;
 
 	directory = file->details->directory;
 	changed = FALSE;
@@ -1606,9 +1760,12 @@ nautilus_async_destroying_file (NautilusFile *file)
 		directory->details->mime_list_in_progress->mime_list_file = NULL;
 		changed = TRUE;
 	}
-	if (directory->details->get_info_file == file) {
-		directory->details->get_info_file = NULL;
-		changed = TRUE;
+	for (node = directory->details->get_info_in_progress; node != NULL; node = node->next) {
+		get_info_state = node->data;
+		if (get_info_state->file == file) {
+			get_info_state->file = NULL;
+			changed = TRUE;
+		}
 	}
 	if (directory->details->top_left_read_state != NULL
 	    && directory->details->top_left_read_state->file == file) {
@@ -1760,15 +1917,128 @@ lacks_mount (NautilusFile *file)
   );
 }
 
-static _Bool
-has_problem (NautilusDirectory *directory, NautilusFile *file, FileCheck problem)
+/* The attributes that callbacks can wait for, and how to tell that
+ * a file lacks them.
+ */
+static const struct {
+	RequestType type;
+	FileCheck problem;
+} request_checks[] = {
+	{ REQUEST_DIRECTORY_COUNT, lacks_directory_count },
+	{ REQUEST_FILE_INFO, lacks_info },
+	{ REQUEST_FILESYSTEM_INFO, lacks_filesystem_info },
+	{ REQUEST_TOP_LEFT_TEXT, lacks_top_left },
+	{ REQUEST_LARGE_TOP_LEFT_TEXT, lacks_large_top_left },
+	{ REQUEST_DEEP_COUNT, lacks_deep_count },
+	{ REQUEST_THUMBNAIL, lacks_thumbnail },
+	{ REQUEST_MOUNT, lacks_mount },
+	{ REQUEST_MIME_LIST, lacks_mime_list },
+	{ REQUEST_LINK_INFO, lacks_link_info }
+};
+
+static Request
+get_missing_request (NautilusFile *file)
 {
-  GList *node;
+	Request request;
+	unsigned int i;
 
+	request = 0;
+	for (i = 0; i < G_N_ELEMENTS (request_checks); i++) {
+		if ((* request_checks[i].problem) (file)) {
+			REQUEST_SET_TYPE (request, request_checks[i].type);
+		}
+	}
+
+	return request;
+}
+
+void
+nautilus_directory_add_missing_counts (NautilusDirectory *directory,
+				       NautilusFile *file)
+{
+	file->details->in_file_list = TRUE;
+	nautilus_directory_update_missing_counts (directory, file);
+}
+
+void
+nautilus_directory_remove_missing_counts (NautilusDirectory *directory,
+					  NautilusFile *file)
+{
+	request_counter_remove_request (directory->details->missing_counters,
+					file->details->missing_request);
+	file->details->missing_request = 0;
+	file->details->in_file_list = FALSE;
+}
+
+void
+nautilus_directory_update_missing_counts (NautilusDirectory *directory,
+					  NautilusFile *file)
+{
+	Request missing;
+
+	if (!file->details->in_file_list) {
+		return;
+	}
+
+	/* Checking for link info can finish it and update this file
+	 * already, so only look at what was counted afterwards.
+	 */
+	missing = get_missing_request (file);
+
+	request_counter_remove_request (directory->details->missing_counters,
+					file->details->missing_request);
+	request_counter_add_request (directory->details->missing_counters,
+				     missing);
+	file->details->missing_request = missing;
+}
+
+void
+nautilus_directory_invalidate_missing_counts (void)
+{
+	missing_counts_generation++;
+}
+
+static void
+recount_missing (NautilusDirectory *directory)
+{
+	GList *node;
+	NautilusFile *file;
+	int i;
+
+	directory->details->missing_counts_generation = missing_counts_generation;
+
+	for (i = 0; i < REQUEST_TYPE_LAST; i++) {
+		directory->details->missing_counters[i] = 0;
+	}
+	for (node = directory->details->file_list; node != NULL; node = node->next) {
+		file = NAUTILUS_FILE (node->data);
+		file->details->missing_request = 0;
+	}
+	for (node = directory->details->file_list; node != NULL; node = node->next) {
+		nautilus_directory_update_missing_counts (directory, NAUTILUS_FILE (node->data));
+	}
+}
+
+static _Bool
+has_problem (NautilusDirectory *directory, NautilusFile *file,
+	     RequestType type, FileCheck problem)
+{
   if (file != NULL) {
     return (* problem) (file);
   }
 
+  if (directory->details->missing_counts_generation != missing_counts_generation) {
+    recount_missing (directory);
+  }
+
+  return directory->details->missing_counters[type] > 0;
+}
+
+static _Bool
+any_file_has_problem (NautilusDirectory *directory, FileCheck problem)
+{
+  GList *node;
+
   for (node = directory->details->file_list; node != NULL; node = node->next) {
     if ((* problem) (node->data)) {
       return TRUE;
@@ -1783,69 +2053,33 @@ request_is_satisfied (NautilusDirectory *directory,
 		      NautilusFile *file,
 		      Request request)
 {
+	unsigned int i;
+
 	if (REQUEST_WANTS_TYPE (request, REQUEST_FILE_LIST) &&
 	    !(directory->details->directory_loaded &&
 				    directory->details->directory_loaded_sent_notification)) {
 		return FALSE;
 	}
 
-	if (REQUEST_WANTS_TYPE (request, REQUEST_DIRECTORY_COUNT)) {
-		if (has_problem (directory, file, lacks_directory_count)) {
-			return FALSE;
-		}
-	}
-
-	if (REQUEST_WANTS_TYPE (request, REQUEST_FILE_INFO)) {
-		if (has_problem (directory, file, lacks_info)) {
-			return FALSE;
-		}
-	}
-
-	if (REQUEST_WANTS_TYPE (request, REQUEST_FILESYSTEM_INFO)) {
-		if (has_problem (directory, file, lacks_filesystem_info)) {
-			return FALSE;
-		}
-	}
-
-	if (REQUEST_WANTS_TYPE (request, REQUEST_TOP_LEFT_TEXT)) {
-		if (has_problem (directory, file, lacks_top_left)) {
-			return FALSE;
-		}
-	}
-
-	if (REQUEST_WANTS_TYPE (request, REQUEST_LARGE_TOP_LEFT_TEXT)) {
-		if (has_problem (directory, file, lacks_large_top_left)) {
-			return FALSE;
-		}
-	}
-
-	if (REQUEST_WANTS_TYPE (request, REQUEST_DEEP_COUNT)) {
-		if (has_problem (directory, file, lacks_deep_count)) {
-			return FALSE;
-		}
-	}
-
-	if (REQUEST_WANTS_TYPE (request, REQUEST_THUMBNAIL)) {
-		if (has_problem (directory, file, lacks_thumbnail)) {
+	for (i = 0; i < G_N_ELEMENTS (request_checks); i++) {
+		if (REQUEST_WANTS_TYPE (request, request_checks[i].type) &&
+		    has_problem (directory, file,
+				 request_checks[i].type, request_checks[i].problem)) {
 			return FALSE;
 		}
 	}
 
-	if (REQUEST_WANTS_TYPE (request, REQUEST_MOUNT)) {
-		if (has_problem (directory, file, lacks_mount)) {
-			return FALSE;
-		}
-	}
-
-	if (REQUEST_WANTS_TYPE (request, REQUEST_MIME_LIST)) {
-		if (has_problem (directory, file, lacks_mime_list)) {
-			return FALSE;
-		}
-	}
-
-	if (REQUEST_WANTS_TYPE (request, REQUEST_LINK_INFO)) {
-		if (has_problem (directory, file, lacks_link_info)) {
-			return FALSE;
+	if (file == NULL) {
+		/* The counts only see the changes they are told about.
+		 * Look at the files once before the callback runs, so
+		 * one that was missed cannot make it run early.
+		 */
+		for (i = 0; i < G_N_ELEMENTS (request_checks); i++) {
+			if (REQUEST_WANTS_TYPE (request, request_checks[i].type) &&
+			    any_file_has_problem (directory, request_checks[i].problem)) {
+				recount_missing (directory);
+				return FALSE;
+			}
 		}
 	}
 
@@ -1921,19 +2155,24 @@ call_ready_callbacks (NautilusDirectory *directory)
   for (node = directory->details->call_when_ready_list;
        node != NULL; node = next) {
     next = node->next;
-  callback = node->data;
-  if (callback->active &&
-    request_is_satisfied (directory, callback->file, callback->request)) {
-    callback->active = FALSE;
-  found_any = TRUE;
+    callback = node->data;
+    if (callback->active &&
+        request_is_satisfied (directory, callback->file, callback->request)) {
+      callback->active = FALSE;
+      if (callback->file == NULL) {
+        /* Only active callbacks make files needy */
+        request_counter_remove_request (directory->details->call_when_ready_directory_counters,
+                                        callback->request);
+      }
+      found_any = TRUE;
     }
-       }
+  }
 
-       if (found_any) {
-         schedule_call_ready_callbacks (directory);
-       }
+  if (found_any) {
+    schedule_call_ready_callbacks (directory);
+  }
 
-       return found_any;
+  return found_any;
 }
 
 _Bool
@@ -2091,6 +2330,131 @@ directory_load_state_free (DirectoryLoadState *state)
   g_free (state);
 }
 
+static void more_files_callback (GObject *source_object, GAsyncResult *res, void *user_data);
+
+typedef struct {
+  int n_requested;
+  GList *files;
+} DirectoryLoadBatch;
+
+static void
+directory_load_batch_free (DirectoryLoadBatch *batch)
+{
+  g_list_free_full (batch->files, g_object_unref);
+  g_free (batch);
+}
+
+/* Runs in a worker thread. Besides reading the next files it does
+ * what nautilus_file_prepare_info () can do without the main loop,
+ * so only creating and hashing the NautilusFiles is left for it.
+ */
+static void
+directory_load_next_files_thread (GSimpleAsyncResult *res,
+                                  GObject *object,
+                                  GCancellable *cancellable)
+{
+  DirectoryLoadBatch *batch;
+  GError *error;
+  GList *l;
+
+  batch = g_simple_async_result_get_op_res_gpointer (res);
+
+  error = NULL;
+  batch->files = g_file_enumerator_next_files (G_FILE_ENUMERATOR (object),
+                                               batch->n_requested,
+                                               cancellable, &error);
+  if (error != NULL) {
+    g_simple_async_result_take_error (res, error);
+    return;
+  }
+
+  for (l = batch->files; l != NULL; l = l->next) {
+    nautilus_file_prepare_info (l->data);
+  }
+}
+
+static void
+directory_load_next_files (DirectoryLoadState *state)
+{
+  GSimpleAsyncResult *res;
+  DirectoryLoadBatch *batch;
+
+  batch = g_new0 (DirectoryLoadBatch, 1);
+  batch->n_requested = state->items_per_callback;
+
+  res = g_simple_async_result_new (G_OBJECT (state->enumerator),
+                                   more_files_callback, state,
+                                   directory_load_next_files);
+  g_simple_async_result_set_op_res_gpointer (res, batch,
+                                             (GDestroyNotify) directory_load_batch_free);
+
+  state->request_time = g_get_monotonic_time ();
+  g_simple_async_result_run_in_thread (res, directory_load_next_files_thread,
+                                       G_PRIORITY_DEFAULT, state->cancellable);
+  g_object_unref (res);
+}
+
+/* Hands over the files read by the worker, NULL at the end or on error */
+static GList *
+directory_load_next_files_finish (GAsyncResult *res, GError **error)
+{
+  GSimpleAsyncResult *simple;
+  DirectoryLoadBatch *batch;
+  GList *files;
+
+  simple = G_SIMPLE_ASYNC_RESULT (res);
+  if (g_simple_async_result_propagate_error (simple, error)) {
+    return NULL;
+  }
+
+  batch = g_simple_async_result_get_op_res_gpointer (simple);
+  files = batch->files;
+  batch->files = NULL;
+
+  return files;
+}
+
+/* Counted as the enumerator hands the files over, so files that
+ * also come in through new_files_callback are not counted twice.
+ */
+static void
+directory_load_count_one (DirectoryLoadState *state,
+                          GFileInfo *info)
+{
+  const char *mimetype;
+
+  if (g_file_info_get_name (info) == NULL ||
+      should_skip_file (state->directory, info)) {
+    return;
+  }
+
+  state->load_file_count += 1;
+
+  /* Add the MIME type to the set. */
+  mimetype = g_file_info_get_content_type (info);
+  if (mimetype != NULL) {
+    istr_set_insert (state->load_mime_list_hash, mimetype);
+  }
+}
+
+/* Only full batches say anything about how fast the files come */
+static void
+directory_load_adapt_batch_size (DirectoryLoadState *state, int n_files)
+{
+  gint64 elapsed;
+
+  elapsed = g_get_monotonic_time () - state->request_time;
+
+  if (n_files >= state->items_per_callback &&
+      elapsed < DIRECTORY_LOAD_BATCH_USECS / 2) {
+    state->items_per_callback = MIN (state->items_per_callback * 2,
+                                     DIRECTORY_LOAD_MAX_ITEMS_PER_CALLBACK);
+  } else if (elapsed > DIRECTORY_LOAD_BATCH_USECS * 2) {
+    state->items_per_callback = MAX (state->items_per_callback / 2,
+                                     DIRECTORY_LOAD_MIN_ITEMS_PER_CALLBACK);
+  }
+}
+
 static void
 more_files_callback (GObject *source_object, GAsyncResult *res, void *user_data)
 {
@@ -2115,25 +2479,24 @@ more_files_callback (GObject *source_object, GAsyncResult *res, void *user_data)
       g_assert (directory->details->directory_load_in_progress == state);
 
       error = NULL;
-      files = g_file_enumerator_next_files_finish (state->enumerator,
-                                                   res, &error);
+      files = directory_load_next_files_finish (res, &error);
+
+      directory_load_adapt_batch_size (state, g_list_length (files));
 
+      /* The infos go straight to the pending array, which keeps
+       * the references the enumerator gave us.
+       */
       for (list = files; list != NULL; list = list->next) {
         info = list->data;
+        directory_load_count_one (state, info);
         directory_load_one (directory, info);
-        g_object_unref (info);
       }
 
       if (files == NULL) {
         directory_load_done (directory, error);
         directory_load_state_free (state);
       } else {
-        g_file_enumerator_next_files_async (state->enumerator,
-                                            DIRECTORY_LOAD_ITEMS_PER_CALLBACK,
-                                            G_PRIORITY_DEFAULT,
-                                            state->cancellable,
-                                            more_files_callback,
-                                            state);
+        directory_load_next_files (state);
       }
 
       nautilus_directory_unref (directory);
@@ -2176,16 +2539,154 @@ enumerate_children_callback (GObject *source_object,
     }
     else {
       state->enumerator = enumerator;
-      g_file_enumerator_next_files_async (state->enumerator,
-                                          DIRECTORY_LOAD_ITEMS_PER_CALLBACK,
-                                          G_PRIORITY_DEFAULT,
-                                          state->cancellable,
-                                          more_files_callback,
-                                          state);
+      directory_load_next_files (state);
     }
   }
 }
 
+typedef struct {
+  NautilusDirectory *directory;
+  GCancellable *cancellable;
+} SnapshotTimesState;
+
+/* Shows the files of the last listing, taken at these directory times,
+ * while the directory loads. They stay unconfirmed and without up to
+ * date info, so the load updates the ones it finds and marks the rest
+ * gone when it is done.
+ */
+static void
+directory_load_snapshot_at (NautilusDirectory *directory,
+                            gint64 mtime,
+                            gint64 ctime)
+{
+  NautilusDirectorySnapshot *snapshot;
+  NautilusFile *file;
+  GFileInfo *info;
+  unsigned int i, n_files;
+  char *uri;
+
+  directory->details->snapshot_mtime = mtime;
+  directory->details->snapshot_ctime = ctime;
+
+  /* Files we already have are better than the snapshot */
+  if (directory->details->file_list != NULL) {
+    return;
+  }
+
+  uri = nautilus_directory_get_uri (directory);
+  snapshot = nautilus_directory_snapshot_load (uri, mtime, ctime);
+  g_free (uri);
+
+  if (snapshot == NULL) {
+    return;
+  }
+
+  n_files = nautilus_directory_snapshot_get_n_files (snapshot);
+  for (i = 0; i < n_files; i++) {
+    info = nautilus_directory_snapshot_get_info (snapshot, i);
+    if (info == NULL) {
+      continue;
+    }
+
+    if (nautilus_directory_find_file_by_name (directory, g_file_info_get_name (info)) == NULL) {
+      file = nautilus_file_new_from_info (directory, info);
+      /* Only the enumeration can vouch for it */
+      file->details->file_info_is_up_to_date = FALSE;
+      nautilus_directory_add_file (directory, file);
+      set_file_unconfirmed (file, TRUE);
+      file->details->is_added = TRUE;
+      directory->details->snapshot_added_files =
+      g_list_prepend (directory->details->snapshot_added_files, file);
+    }
+
+    g_object_unref (info);
+  }
+
+  nautilus_directory_snapshot_free (snapshot);
+
+  if (directory->details->snapshot_added_files != NULL) {
+    nautilus_directory_schedule_dequeue_pending (directory);
+  }
+}
+
+static void
+snapshot_times_callback (GObject *source_object,
+                         GAsyncResult *res,
+                         void *user_data)
+{
+  SnapshotTimesState *state;
+  NautilusDirectory *directory;
+  GFileInfo *info;
+  gint64 mtime, ctime;
+
+  state = user_data;
+  directory = state->directory;
+
+  info = g_file_query_info_finish (G_FILE (source_object), res, NULL);
+
+  /* Not worth showing once the load is over or was cancelled */
+  if (info != NULL &&
+      !g_cancellable_is_cancelled (state->cancellable) &&
+      directory->details->directory_load_in_progress != NULL) {
+    mtime = g_file_info_get_attribute_uint64 (info, G_FILE_ATTRIBUTE_TIME_MODIFIED);
+    ctime = g_file_info_get_attribute_uint64 (info, G_FILE_ATTRIBUTE_TIME_CHANGED);
+    if (mtime != 0) {
+      directory_load_snapshot_at (directory, mtime, ctime);
+    }
+  }
+
+  if (info != NULL) {
+    g_object_unref (info);
+  }
+  g_object_unref (state->cancellable);
+  nautilus_directory_unref (directory);
+  g_free (state);
+}
+
+/* Loads the snapshot the times of the directory ask for, asking the
+ * file system for them in the background if we do not know them yet.
+ */
+static void
+directory_load_snapshot (NautilusDirectory *directory,
+                         NautilusFile *directory_file,
+                         GCancellable *cancellable)
+{
+  SnapshotTimesState *state;
+
+  directory->details->snapshot_mtime = 0;
+  directory->details->snapshot_ctime = 0;
+
+  /* These gather their files from elsewhere */
+  if (g_file_has_uri_scheme (directory->details->location, "trash") ||
+      g_file_has_uri_scheme (directory->details->location, "recent")) {
+    return;
+  }
+
+  if (directory_file->details->file_info_is_up_to_date &&
+      directory_file->details->mtime != 0) {
+    directory_load_snapshot_at (directory,
+                                directory_file->details->mtime,
+                                directory_file->details->ctime);
+    return;
+  }
+
+  if (!g_file_is_native (directory->details->location)) {
+    return;
+  }
+
+  state = g_new0 (SnapshotTimesState, 1);
+  state->directory = nautilus_directory_ref (directory);
+  state->cancellable = g_object_ref (cancellable);
+
+  g_file_query_info_async (directory->details->location,
+                           G_FILE_ATTRIBUTE_TIME_MODIFIED ","
+                           G_FILE_ATTRIBUTE_TIME_CHANGED,
+                           0,
+                           G_PRIORITY_DEFAULT,
+                           cancellable,
+                           snapshot_times_callback,
+                           state);
+}
 
 /* Start monitoring the file list if it isn't already. */
 static void
@@ -2218,6 +2719,7 @@ start_monitoring_file_list (NautilusDirectory *directory)
   state->cancellable = g_cancellable_new ();
   state->load_mime_list_hash = istr_set_new ();
   state->load_file_count = 0;
+  state->items_per_callback = DIRECTORY_LOAD_ITEMS_PER_CALLBACK;
 
   if (directory->details->location != NULL) {
 
@@ -2241,6 +2743,8 @@ start_monitoring_file_list (NautilusDirectory *directory)
                            fn, fn);
     }
 
+    directory_load_snapshot (directory, state->load_directory_file,
+                             state->cancellable);
 
 #ifdef DEBUG_LOAD_DIRECTORY
     g_message ("load_directory called to monitor file list of %p", directory->details->location);
@@ -2384,6 +2888,13 @@ is_needy (NautilusFile *file,
   }
 
   directory = file->details->directory;
+
+  /* A callback for all files wants it, no need to look for others */
+  if (directory->details->call_when_ready_directory_counters[request_type_wanted] > 0 &&
+      file != directory->details->as_file) {
+    return TRUE;
+  }
+
   if (directory->details->call_when_ready_counters[request_type_wanted] > 0) {
     for (node = directory->details->call_when_ready_list;
          node != NULL; node = node->next) {
@@ -2456,6 +2967,25 @@ count_non_skipped_files (GList *list)
   return count;
 }
 
+static void
+set_directory_count (NautilusFile *count_file,
+                     _Bool succeeded,
+                     int count)
+{
+  count_file->details->directory_count_is_up_to_date = TRUE;
+
+  /* Record either a failure or success. */
+  if (!succeeded) {
+    count_file->details->directory_count_failed = TRUE;
+    count_file->details->got_directory_count = FALSE;
+    count_file->details->directory_count = 0;
+  } else {
+    count_file->details->directory_count_failed = FALSE;
+    count_file->details->got_directory_count = TRUE;
+    count_file->details->directory_count = count;
+  }
+}
+
 static void
 count_children_done (NautilusDirectory *directory,
                      NautilusFile *count_file,
@@ -2464,18 +2994,7 @@ count_children_done (NautilusDirectory *directory,
 {
   if (NAUTILUS_IS_FILE (count_file)) {
 
-    count_file->details->directory_count_is_up_to_date = TRUE;
-
-    /* Record either a failure or success. */
-    if (!succeeded) {
-      count_file->details->directory_count_failed = TRUE;
-      count_file->details->got_directory_count = FALSE;
-      count_file->details->directory_count = 0;
-    } else {
-      count_file->details->directory_count_failed = FALSE;
-      count_file->details->got_directory_count = TRUE;
-      count_file->details->directory_count = count;
-    }
+    set_directory_count (count_file, succeeded, count);
     directory->details->count_in_progress = NULL;
 
     /* Send file-changed even if count failed, so interested parties can
@@ -2558,52 +3077,203 @@ count_more_files_callback (GObject *source_object,
   }
 }
 
-static void
-count_children_callback (GObject *source_object,
-                         GAsyncResult *res,
-                         void * user_data)
+static void
+count_children_callback (GObject *source_object,
+                         GAsyncResult *res,
+                         void * user_data)
+{
+  DirectoryCountState *state;
+  GFileEnumerator *enumerator;
+  NautilusDirectory *directory;
+  GError *error;
+
+  state = user_data;
+
+  if (g_cancellable_is_cancelled (state->cancellable)) {
+    /* Operation was cancelled. Bail out */
+    directory = state->directory;
+    directory->details->count_in_progress = NULL;
+
+    async_job_end (directory, "directory count");
+    nautilus_directory_async_state_changed (directory);
+
+    directory_count_state_free (state);
+
+    return;
+  }
+
+  error = NULL;
+  enumerator = g_file_enumerate_children_finish  (G_FILE (source_object),
+                                                  res, &error);
+
+  if (enumerator == NULL) {
+    count_children_done (state->directory,
+                         state->count_file,
+                         FALSE, 0);
+    g_error_free (error);
+    directory_count_state_free (state);
+    return;
+  }
+  else {
+    state->enumerator = enumerator;
+    g_file_enumerator_next_files_async (state->enumerator,
+                                        DIRECTORY_LOAD_ITEMS_PER_CALLBACK,
+                                        G_PRIORITY_DEFAULT,
+                                        state->cancellable,
+                                        count_more_files_callback,
+                                        state);
+  }
+}
+
+static void
+local_count_batch_free (LocalCountBatch *batch)
+{
+  g_ptr_array_free (batch->files, TRUE);
+  g_ptr_array_free (batch->paths, TRUE);
+  g_free (batch->counts);
+  g_free (batch);
+}
+
+/* Runs in a worker thread */
+static void
+local_count_thread (GSimpleAsyncResult *res,
+                    GObject *object,
+                    GCancellable *cancellable)
+{
+  LocalCountBatch *batch;
+  unsigned int i;
+
+  batch = g_simple_async_result_get_op_res_gpointer (res);
+
+  for (i = 0; i < batch->paths->len; i++) {
+    if (g_cancellable_is_cancelled (cancellable)) {
+      return;
+    }
+    if (!nautilus_item_count_local_directory (g_ptr_array_index (batch->paths, i),
+                                              &batch->counts[i])) {
+      batch->counts[i] = -1;
+    }
+  }
+}
+
+static void
+local_count_callback (GObject *source_object,
+                      GAsyncResult *res,
+                      void * user_data)
+{
+  DirectoryCountState *state;
+  NautilusDirectory *directory;
+  LocalCountBatch *batch;
+  NautilusFile *file;
+  unsigned int i;
+
+  state = user_data;
+  directory = state->directory;
+
+  if (g_cancellable_is_cancelled (state->cancellable)) {
+    /* Operation was cancelled. Bail out */
+    directory->details->count_in_progress = NULL;
+
+    async_job_end (directory, "directory count");
+    nautilus_directory_async_state_changed (directory);
+
+    directory_count_state_free (state);
+
+    return;
+  }
+
+  batch = g_simple_async_result_get_op_res_gpointer (G_SIMPLE_ASYNC_RESULT (res));
+
+  /* The others first, count_children_done starts the next job */
+  for (i = 1; i < batch->files->len; i++) {
+    file = g_ptr_array_index (batch->files, i);
+    if (file->details->is_gone || file->details->directory != directory) {
+      continue;
+    }
+
+    set_directory_count (file, batch->counts[i] >= 0, batch->counts[i]);
+    nautilus_file_changed (file);
+  }
+
+  count_children_done (directory, state->count_file,
+                       batch->counts[0] >= 0, batch->counts[0]);
+  directory_count_state_free (state);
+}
+
+static void
+local_count_add (LocalCountBatch *batch,
+                 NautilusFile *file,
+                 GFile *location)
+{
+  char *path;
+
+  path = g_file_get_path (location);
+  if (path != NULL) {
+    g_ptr_array_add (batch->files, nautilus_file_ref (file));
+    g_ptr_array_add (batch->paths, path);
+  }
+}
+
+/* Counts the local directory of state->count_file, and the ones queued
+ * after it that want a count too, without enumerating them. Returns
+ * FALSE, starting nothing, if the directory has no local path.
+ */
+static _Bool
+local_count_start (NautilusDirectory *directory,
+                   DirectoryCountState *state,
+                   GFile *location)
 {
-  DirectoryCountState *state;
-  GFileEnumerator *enumerator;
-  NautilusDirectory *directory;
-  GError *error;
+  GSimpleAsyncResult *res;
+  LocalCountBatch *batch;
+  NautilusFileQueue *queue;
+  NautilusFile *file;
+  GFile *file_location;
+  char *path;
+  int n_looked_at;
 
-  state = user_data;
+  /* The callback reads the count of state->count_file first */
+  path = g_file_get_path (location);
+  if (path == NULL) {
+    return FALSE;
+  }
 
-  if (g_cancellable_is_cancelled (state->cancellable)) {
-    /* Operation was cancelled. Bail out */
-    directory = state->directory;
-    directory->details->count_in_progress = NULL;
+  batch = g_new0 (LocalCountBatch, 1);
+  batch->files = g_ptr_array_new_with_free_func ((GDestroyNotify) nautilus_file_unref);
+  batch->paths = g_ptr_array_new_with_free_func (g_free);
 
-    async_job_end (directory, "directory count");
-    nautilus_directory_async_state_changed (directory);
+  g_ptr_array_add (batch->files, nautilus_file_ref (state->count_file));
+  g_ptr_array_add (batch->paths, path);
 
-    directory_count_state_free (state);
+  queue = directory->details->work_queues[WORK_QUEUE_DIRECTORY_COUNT];
+  n_looked_at = 0;
 
-    return;
-  }
+  for (file = nautilus_file_queue_next (queue, state->count_file);
+       file != NULL && batch->files->len < LOCAL_COUNT_BATCH_SIZE && n_looked_at < LOCAL_COUNT_LOOK_AHEAD;
+       file = nautilus_file_queue_next (queue, file), n_looked_at++) {
 
-  error = NULL;
-  enumerator = g_file_enumerate_children_finish  (G_FILE (source_object),
-                                                  res, &error);
+    if (!nautilus_file_is_directory (file) ||
+        !is_needy (file, should_get_directory_count_now, REQUEST_DIRECTORY_COUNT)) {
+      continue;
+    }
 
-  if (enumerator == NULL) {
-    count_children_done (state->directory,
-                         state->count_file,
-                         FALSE, 0);
-    g_error_free (error);
-    directory_count_state_free (state);
-    return;
-  }
-  else {
-    state->enumerator = enumerator;
-    g_file_enumerator_next_files_async (state->enumerator,
-                                        DIRECTORY_LOAD_ITEMS_PER_CALLBACK,
-                                        G_PRIORITY_DEFAULT,
-                                        state->cancellable,
-                                        count_more_files_callback,
-                                        state);
+    file_location = nautilus_file_get_location (file);
+    if (g_file_is_native (file_location)) {
+      local_count_add (batch, file, file_location);
+    }
+    g_object_unref (file_location);
   }
+
+  batch->counts = g_new0 (int, batch->files->len);
+
+  res = g_simple_async_result_new (NULL, local_count_callback, state,
+                                   local_count_start);
+  g_simple_async_result_set_op_res_gpointer (res, batch,
+                                             (GDestroyNotify) local_count_batch_free);
+  g_simple_async_result_run_in_thread (res, local_count_thread,
+                                       G_PRIORITY_DEFAULT, state->cancellable);
+  g_object_unref (res);
+
+  return TRUE;
 }
 
 static void
@@ -2631,6 +3301,7 @@ directory_count_start (NautilusDirectory *directory,
     file->details->directory_count_failed = FALSE;
     file->details->got_directory_count = FALSE;
 
+    nautilus_directory_update_missing_counts (directory, file);
     nautilus_directory_async_state_changed (directory);
     return;
   }
@@ -2657,6 +3328,12 @@ directory_count_start (NautilusDirectory *directory,
   }
 #endif
 
+  if (g_file_is_native (location) &&
+      local_count_start (directory, state, location)) {
+    g_object_unref (location);
+    return;
+  }
+
   g_file_enumerate_children_async (location,
                                    G_FILE_ATTRIBUTE_STANDARD_NAME ","
                                    G_FILE_ATTRIBUTE_STANDARD_IS_HIDDEN ","
@@ -2669,41 +3346,77 @@ directory_count_start (NautilusDirectory *directory,
   g_object_unref (location);
 }
 
+static unsigned int
+deep_count_inode_hash (const void *key)
+{
+  const DeepCountInode *id = key;
+  guint64 h;
+
+  h = id->inode ^ (id->device * G_GUINT64_CONSTANT (0x9E3779B97F4A7C15));
+
+  return (unsigned int) (h ^ (h >> 32));
+}
+
+static int
+deep_count_inode_equal (const void *a, const void *b)
+{
+  const DeepCountInode *id_a = a;
+  const DeepCountInode *id_b = b;
+
+  return id_a->inode == id_b->inode && id_a->device == id_b->device;
+}
+
+/* Only files that can have more than one name need to be remembered,
+ * directories cannot be hard linked and a file with a single link can
+ * not be encountered twice. When the backend does not report a link
+ * count every file with an inode number is treated as a candidate.
+ */
 static inline _Bool
-seen_inode (DeepCountState *state, GFileInfo *info)
+is_hard_link_candidate (GFileInfo *info, DeepCountInode *id)
 {
-  guint64 inode, inode2;
-  unsigned int i;
+  if (g_file_info_get_file_type (info) == G_FILE_TYPE_DIRECTORY) {
+    return FALSE;
+  }
 
-  inode = g_file_info_get_attribute_uint64 (info, G_FILE_ATTRIBUTE_UNIX_INODE);
+  if (g_file_info_has_attribute (info, G_FILE_ATTRIBUTE_UNIX_NLINK) &&
+      g_file_info_get_attribute_uint32 (info, G_FILE_ATTRIBUTE_UNIX_NLINK) <= 1) {
+    return FALSE;
+  }
 
-  if (inode != 0) {
-    for (i = 0; i < state->seen_deep_count_inodes->len; i++) {
-      inode2 = g_array_index (state->seen_deep_count_inodes, guint64, i);
-      if (inode == inode2) {
-        return TRUE;
-      }
-    }
+  id->inode = g_file_info_get_attribute_uint64 (info, G_FILE_ATTRIBUTE_UNIX_INODE);
+  if (id->inode == 0) {
+    return FALSE;
   }
 
-  return FALSE;
+  id->device = g_file_info_get_attribute_uint32 (info, G_FILE_ATTRIBUTE_UNIX_DEVICE);
+
+  return TRUE;
 }
 
-static inline void
-mark_inode_as_seen (DeepCountState *state, GFileInfo *info)
+/* Returns TRUE if the file was already counted, otherwise records it */
+static _Bool
+check_and_mark_inode (DeepCountState *state, GFileInfo *info)
 {
-  guint64 inode;
+  DeepCountInode id;
+
+  if (!is_hard_link_candidate (info, &id)) {
+    return FALSE;
+  }
 
-  inode = g_file_info_get_attribute_uint64 (info, G_FILE_ATTRIBUTE_UNIX_INODE);
-  if (inode != 0) {
-    g_array_append_val (state->seen_deep_count_inodes, inode);
+  if (g_hash_table_contains (state->seen_deep_count_inodes, &id)) {
+    return TRUE;
   }
+
+  g_hash_table_add (state->seen_deep_count_inodes, g_memdup (&id, sizeof (id)));
+
+  return FALSE;
 }
 
 static void
 deep_count_one (DeepCountState *state, GFileInfo *info)
 {
   NautilusFile *file;
+  NautilusFileRareDetails *rare;
   GFile *subdir;
   _Bool is_seen_inode;
 
@@ -2711,16 +3424,14 @@ deep_count_one (DeepCountState *state, GFileInfo *info)
     return;
   }
 
-  is_seen_inode = seen_inode (state, info);
-  if (!is_seen_inode) {
-    mark_inode_as_seen (state, info);
-  }
+  is_seen_inode = check_and_mark_inode (state, info);
 
   file = state->directory->details->deep_count_file;
+  rare = nautilus_file_get_rare_details (file);
 
   if (g_file_info_get_file_type (info) == G_FILE_TYPE_DIRECTORY) {
     /* Count the directory. */
-    file->details->deep_directory_count += 1;
+    rare->deep_directory_count += 1;
 
     /* Record the fact that we have to descend into this directory. */
 
@@ -2729,12 +3440,12 @@ deep_count_one (DeepCountState *state, GFileInfo *info)
     (state->deep_count_subdirectories, subdir);
   } else {
     /* Even non-regular files count as files. */
-    file->details->deep_file_count += 1;
+    rare->deep_file_count += 1;
   }
 
   /* Count the size. */
   if (!is_seen_inode && g_file_info_has_attribute (info, G_FILE_ATTRIBUTE_STANDARD_SIZE)) {
-    file->details->deep_size += g_file_info_get_size (info);
+    rare->deep_size += g_file_info_get_size (info);
   }
 }
 
@@ -2753,7 +3464,7 @@ deep_count_state_free (DeepCountState *state)
     g_object_unref (state->deep_count_location);
   }
   g_list_free_full (state->deep_count_subdirectories, g_object_unref);
-  g_array_free (state->seen_deep_count_inodes, TRUE);
+  g_hash_table_destroy (state->seen_deep_count_inodes);
   g_free (state);
 }
 
@@ -2871,7 +3582,7 @@ deep_count_callback (GObject *source_object,
   enumerator = g_file_enumerate_children_finish  (G_FILE (source_object),	res, NULL);
 
   if (enumerator == NULL) {
-    file->details->deep_unreadable_count += 1;
+    nautilus_file_get_rare_details (file)->deep_unreadable_count += 1;
 
     deep_count_next_dir (state);
   } else {
@@ -2900,7 +3611,9 @@ deep_count_load (DeepCountState *state, GFile *location)
                                    G_FILE_ATTRIBUTE_STANDARD_SIZE ","
                                    G_FILE_ATTRIBUTE_STANDARD_IS_HIDDEN ","
                                    G_FILE_ATTRIBUTE_STANDARD_IS_BACKUP ","
-                                   G_FILE_ATTRIBUTE_UNIX_INODE,
+                                   G_FILE_ATTRIBUTE_UNIX_DEVICE ","
+                                   G_FILE_ATTRIBUTE_UNIX_INODE ","
+                                   G_FILE_ATTRIBUTE_UNIX_NLINK,
                                    G_FILE_QUERY_INFO_NOFOLLOW_SYMLINKS, /* flags */
                                    G_PRIORITY_LOW, /* prio */
                                    state->cancellable,
@@ -2937,6 +3650,7 @@ deep_count_start (NautilusDirectory *directory,
 {
   GFile *location;
   DeepCountState *state;
+  NautilusFileRareDetails *rare;
 
   if (directory->details->deep_count_in_progress != NULL) {
     *doing_io = TRUE;
@@ -2953,6 +3667,7 @@ deep_count_start (NautilusDirectory *directory,
   if (!nautilus_file_is_directory (file)) {
     file->details->deep_counts_status = NAUTILUS_REQUEST_DONE;
 
+    nautilus_directory_update_missing_counts (directory, file);
     nautilus_directory_async_state_changed (directory);
     return;
   }
@@ -2963,16 +3678,19 @@ deep_count_start (NautilusDirectory *directory,
 
   /* Start counting. */
   file->details->deep_counts_status = NAUTILUS_REQUEST_IN_PROGRESS;
-  file->details->deep_directory_count = 0;
-  file->details->deep_file_count = 0;
-  file->details->deep_unreadable_count = 0;
-  file->details->deep_size = 0;
+  rare = nautilus_file_get_rare_details (file);
+  rare->deep_directory_count = 0;
+  rare->deep_file_count = 0;
+  rare->deep_unreadable_count = 0;
+  rare->deep_size = 0;
   directory->details->deep_count_file = file;
 
   state = g_new0 (DeepCountState, 1);
   state->directory = directory;
   state->cancellable = g_cancellable_new ();
-  state->seen_deep_count_inodes = g_array_new (FALSE, TRUE, sizeof (guint64));
+  state->seen_deep_count_inodes = g_hash_table_new_full (deep_count_inode_hash,
+                                                         deep_count_inode_equal,
+                                                         g_free, NULL);
 
   directory->details->deep_count_in_progress = state;
 
@@ -3204,6 +3922,7 @@ mime_list_start (NautilusDirectory *directory,
     file->details->got_mime_list = FALSE;
     file->details->mime_list_is_up_to_date = TRUE;
 
+    nautilus_directory_update_missing_counts (directory, file);
     nautilus_directory_async_state_changed (directory);
     return;
   }
@@ -3281,6 +4000,7 @@ top_left_read_callback (GObject *source_object,
   TopLeftTextReadState *state;
   NautilusDirectory *directory;
   NautilusFileDetails *file_details;
+  NautilusFileRareDetails *rare;
   size_t file_size;
   char *file_contents;
 
@@ -3296,19 +4016,21 @@ top_left_read_callback (GObject *source_object,
 
   file_details = state->file->details;
 
+  rare = nautilus_file_get_rare_details (state->file);
+
   file_details->top_left_text_is_up_to_date = TRUE;
-  g_free (file_details->top_left_text);
+  g_free (rare->top_left_text);
 
   if (g_file_load_partial_contents_finish (G_FILE (source_object),
     res,
     &file_contents, &file_size,
     NULL, NULL)) {
-    file_details->top_left_text = nautilus_extract_top_left_text (file_contents, state->large, file_size);
+    rare->top_left_text = nautilus_extract_top_left_text (file_contents, state->large, file_size);
   file_details->got_top_left_text = TRUE;
   file_details->got_large_top_left_text = state->large;
   g_free (file_contents);
     } else {
-      file_details->top_left_text = NULL;
+      rare->top_left_text = NULL;
       file_details->got_top_left_text = FALSE;
       file_details->got_large_top_left_text = FALSE;
     }
@@ -3388,12 +4110,15 @@ top_left_start (NautilusDirectory *directory,
                 *doing_io = TRUE;
 
                 if (!nautilus_file_contains_text (file)) {
-                  g_free (file->details->top_left_text);
-                  file->details->top_left_text = NULL;
+                  if (file->details->rare != NULL) {
+                    g_free (file->details->rare->top_left_text);
+                    file->details->rare->top_left_text = NULL;
+                  }
                   file->details->got_top_left_text = FALSE;
                   file->details->got_large_top_left_text = FALSE;
                   file->details->top_left_text_is_up_to_date = TRUE;
 
+                  nautilus_directory_update_missing_counts (directory, file);
                   nautilus_directory_async_state_changed (directory);
                   return;
                 }
@@ -3438,6 +4163,7 @@ query_info_callback (GObject *source_object,
   GFileInfo *info;
   GetInfoState *state;
   GError *error;
+  gint64 latency;
 
   state = user_data;
 
@@ -3449,11 +4175,20 @@ query_info_callback (GObject *source_object,
 
   directory = nautilus_directory_ref (state->directory);
 
-  get_info_file = directory->details->get_info_file;
+  get_info_file = state->file;
   g_assert (NAUTILUS_IS_FILE (get_info_file));
 
-  directory->details->get_info_file = NULL;
-  directory->details->get_info_in_progress = NULL;
+  directory->details->get_info_in_progress =
+  g_list_remove (directory->details->get_info_in_progress, state);
+
+  latency = g_get_monotonic_time () - state->start_time;
+  if (directory->details->get_info_latency == 0) {
+    directory->details->get_info_latency = latency;
+  }
+  else {
+    directory->details->get_info_latency +=
+    (latency - directory->details->get_info_latency) / 8;
+  }
 
   /* ref here because we might be removing the last ref when we
    * mark the file gone below, but we need to keep a ref at
@@ -3481,7 +4216,9 @@ query_info_callback (GObject *source_object,
   nautilus_file_changed (get_info_file);
   nautilus_file_unref (get_info_file);
 
-  async_job_end (directory, "file info");
+  if (directory->details->get_info_in_progress == NULL) {
+    async_job_end (directory, "file info");
+  }
   nautilus_directory_async_state_changed (directory);
 
   nautilus_directory_unref (directory);
@@ -3489,51 +4226,70 @@ query_info_callback (GObject *source_object,
   get_info_state_free (state);
 }
 
+/* How many queries may be in progress, going by the average latency */
+static unsigned int
+file_info_get_max_queries (NautilusDirectory *directory)
+{
+  gint64 queries;
+
+  queries = directory->details->get_info_latency / FILE_INFO_LATENCY_PER_QUERY_USECS + 1;
+
+  return (unsigned int) MIN (queries, MAX_FILE_INFO_QUERIES);
+}
+
+static _Bool
+file_info_is_in_progress (NautilusDirectory *directory,
+                          NautilusFile *file)
+{
+  GList *node;
+  GetInfoState *state;
+
+  for (node = directory->details->get_info_in_progress; node != NULL; node = node->next) {
+    state = node->data;
+    if (state->file == file) {
+      return TRUE;
+    }
+  }
+
+  return FALSE;
+}
+
 static void
 file_info_stop (NautilusDirectory *directory)
 {
-  NautilusFile *file;
+  GList *node, *next;
+  GetInfoState *state;
 
-  if (directory->details->get_info_in_progress != NULL) {
-    file = directory->details->get_info_file;
-    if (file != NULL) {
-      g_assert (NAUTILUS_IS_FILE (file));
-      g_assert (file->details->directory == directory);
-      if (is_needy (file, lacks_info, REQUEST_FILE_INFO)) {
-        return;
+  for (node = directory->details->get_info_in_progress; node != NULL; node = next) {
+    next = node->next;
+    state = node->data;
+
+    if (state->file != NULL) {
+      g_assert (NAUTILUS_IS_FILE (state->file));
+      g_assert (state->file->details->directory == directory);
+      if (is_needy (state->file, lacks_info, REQUEST_FILE_INFO)) {
+        continue;
       }
     }
 
     /* The info is not wanted, so stop it. */
-    file_info_cancel (directory);
+    get_info_cancel (directory, state);
   }
 }
 
-static void
-file_info_start (NautilusDirectory *directory,
-                 NautilusFile *file,
-                 _Bool *doing_io)
+/* Starts a query for @file, returns FALSE if no job is available */
+static _Bool
+file_info_query (NautilusDirectory *directory,
+                 NautilusFile *file)
 {
   GFile *location;
   GetInfoState *state;
 
-  file_info_stop (directory);
-
-  if (directory->details->get_info_in_progress != NULL) {
-    *doing_io = TRUE;
-    return;
-  }
-
-  if (!is_needy (file, lacks_info, REQUEST_FILE_INFO)) {
-    return;
-  }
-  *doing_io = TRUE;
-
-  if (!async_job_start (directory, "file info")) {
-    return;
+  if (directory->details->get_info_in_progress == NULL &&
+      !async_job_start (directory, "file info")) {
+    return FALSE;
   }
 
-  directory->details->get_info_file = file;
   file->details->get_info_failed = FALSE;
   if (file->details->get_info_error) {
     g_error_free (file->details->get_info_error);
@@ -3542,9 +4298,12 @@ file_info_start (NautilusDirectory *directory,
 
   state = g_new (GetInfoState, 1);
   state->directory = directory;
+  state->file = file;
   state->cancellable = g_cancellable_new ();
+  state->start_time = g_get_monotonic_time ();
 
-  directory->details->get_info_in_progress = state;
+  directory->details->get_info_in_progress =
+  g_list_prepend (directory->details->get_info_in_progress, state);
 
   location = nautilus_file_get_location (file);
   g_file_query_info_async (location,
@@ -3553,6 +4312,82 @@ file_info_start (NautilusDirectory *directory,
                            G_PRIORITY_DEFAULT,
                            state->cancellable, query_info_callback, state);
   g_object_unref (location);
+
+  return TRUE;
+}
+
+/* The directory load in progress brings the info of the files it has
+ * yet to confirm, such as those shown from a listing snapshot.
+ */
+static _Bool
+file_info_comes_with_load (NautilusDirectory *directory,
+                           NautilusFile *file)
+{
+  return file->details->unconfirmed &&
+    directory->details->directory_load_in_progress != NULL;
+}
+
+static void
+file_info_start (NautilusDirectory *directory,
+                 NautilusFile *file,
+                 _Bool *doing_io)
+{
+  file_info_stop (directory);
+
+  if (file_info_is_in_progress (directory, file)) {
+    *doing_io = TRUE;
+    return;
+  }
+
+  if (file_info_comes_with_load (directory, file) ||
+      !is_needy (file, lacks_info, REQUEST_FILE_INFO)) {
+    return;
+  }
+  *doing_io = TRUE;
+
+  if (g_list_length (directory->details->get_info_in_progress) >=
+      file_info_get_max_queries (directory)) {
+    return;
+  }
+
+  file_info_query (directory, file);
+}
+
+/* Fills the remaining query slots with the files that are next in the
+ * file info queue, so they are not fetched one at a time.
+ */
+static void
+file_info_start_ahead (NautilusDirectory *directory)
+{
+  NautilusFileQueue *queue;
+  NautilusFile *file;
+  unsigned int n_queries, max_queries;
+  int n_looked_at;
+
+  max_queries = file_info_get_max_queries (directory);
+  n_queries = g_list_length (directory->details->get_info_in_progress);
+  if (n_queries >= max_queries) {
+    return;
+  }
+
+  queue = directory->details->work_queues[WORK_QUEUE_FILE_INFO];
+  n_looked_at = 0;
+
+  for (file = nautilus_file_queue_head (queue);
+       file != NULL && n_queries < max_queries && n_looked_at < FILE_INFO_LOOK_AHEAD;
+       file = nautilus_file_queue_next (queue, file), n_looked_at++) {
+
+    if (file_info_is_in_progress (directory, file) ||
+        file_info_comes_with_load (directory, file) ||
+        !is_needy (file, lacks_info, REQUEST_FILE_INFO)) {
+      continue;
+    }
+
+    if (!file_info_query (directory, file)) {
+      return;
+    }
+    n_queries++;
+  }
 }
 
 static _Bool
@@ -3618,6 +4453,7 @@ link_info_done (NautilusDirectory *directory,
   file->details->is_foreign_link = is_foreign;
   file->details->is_trusted_link = is_trusted;
 
+  nautilus_directory_update_missing_counts (directory, file);
   nautilus_directory_async_state_changed (directory);
 }
 
@@ -3822,6 +4658,7 @@ thumbnail_done (NautilusDirectory *directory,
       }
   }
 
+  nautilus_directory_update_missing_counts (directory, file);
   nautilus_directory_async_state_changed (directory);
 }
 
@@ -4090,6 +4927,7 @@ got_mount (MountState *state, GMount *mount)
   file->details->mount_is_up_to_date = TRUE;
   nautilus_file_set_mount (file, mount);
 
+  nautilus_directory_update_missing_counts (directory, file);
   nautilus_directory_async_state_changed (directory);
   nautilus_file_changed (file);
 
@@ -4296,6 +5134,7 @@ got_filesystem_info (FilesystemInfoState *state, GFileInfo *info)
     g_file_info_get_attribute_boolean (info, G_FILE_ATTRIBUTE_FILESYSTEM_READONLY);
   }
 
+  nautilus_directory_update_missing_counts (directory, file);
   nautilus_directory_async_state_changed (directory);
   nautilus_file_changed (file);
 
@@ -4425,6 +5264,7 @@ finish_info_provider (NautilusDirectory *directory,
                   provider);
   g_object_unref (provider);
 
+  nautilus_directory_update_missing_counts (directory, file);
   nautilus_directory_async_state_changed (directory);
 
   if (file->details->pending_info_providers == NULL) {
@@ -4533,11 +5373,30 @@ extension_info_start (NautilusDirectory *directory,
     }
 }
 
+typedef void (* WorkStartFunc) (NautilusDirectory *directory,
+                                NautilusFile *file,
+                                _Bool *doing_io);
+
+static const WorkStartFunc work_start_funcs[WORK_QUEUE_LAST] = {
+  file_info_start,
+  link_info_start,
+  mount_start,
+  directory_count_start,
+  deep_count_start,
+  mime_list_start,
+  top_left_start,
+  thumbnail_start,
+  filesystem_info_start,
+  extension_info_start
+};
+
 static void
 start_or_stop_io (NautilusDirectory *directory)
 {
+  NautilusFileQueue *queue;
   NautilusFile *file;
   _Bool doing_io;
+  int type;
 
   /* Start or stop reading files. */
   file_list_start_or_stop (directory);
@@ -4554,53 +5413,27 @@ start_or_stop_io (NautilusDirectory *directory)
   thumbnail_stop (directory);
   filesystem_info_stop (directory);
 
-  doing_io = FALSE;
-  /* Take files that are all done off the queue. */
-  while (!nautilus_file_queue_is_empty (directory->details->high_priority_queue)) {
-    file = nautilus_file_queue_head (directory->details->high_priority_queue);
-
-    /* Start getting attributes if possible */
-    file_info_start (directory, file, &doing_io);
-    link_info_start (directory, file, &doing_io);
-
-    if (doing_io) {
-      return;
-    }
-
-    move_file_to_low_priority_queue (directory, file);
-  }
+  /* A busy attribute only holds up its own queue */
+  for (type = 0; type < WORK_QUEUE_LAST; type++) {
+    queue = directory->details->work_queues[type];
+    doing_io = FALSE;
 
-  /* High priority queue must be empty */
-  while (!nautilus_file_queue_is_empty (directory->details->low_priority_queue)) {
-    file = nautilus_file_queue_head (directory->details->low_priority_queue);
+    /* Take files that are all done off the queue. */
+    while (!nautilus_file_queue_is_empty (queue)) {
+      file = nautilus_file_queue_head (queue);
 
-    /* Start getting attributes if possible */
-    mount_start (directory, file, &doing_io);
-    directory_count_start (directory, file, &doing_io);
-    deep_count_start (directory, file, &doing_io);
-    mime_list_start (directory, file, &doing_io);
-    top_left_start (directory, file, &doing_io);
-    thumbnail_start (directory, file, &doing_io);
-    filesystem_info_start (directory, file, &doing_io);
+      /* Start getting the attribute if possible */
+      (* work_start_funcs[type]) (directory, file, &doing_io);
+      if (doing_io) {
+        break;
+      }
 
-    if (doing_io) {
-      return;
+      move_file_to_next_work_queue (directory, file, type);
     }
 
-    move_file_to_extension_queue (directory, file);
-  }
-
-  /* Low priority queue must be empty */
-  while (!nautilus_file_queue_is_empty (directory->details->extension_queue)) {
-    file = nautilus_file_queue_head (directory->details->extension_queue);
-
-    /* Start getting attributes if possible */
-    extension_info_start (directory, file, &doing_io);
-    if (doing_io) {
-      return;
+    if (type == WORK_QUEUE_FILE_INFO && doing_io) {
+      file_info_start_ahead (directory);
     }
-
-    nautilus_directory_remove_file_from_work_queue (directory, file);
   }
 }
 
@@ -4707,8 +5540,15 @@ static void
 cancel_file_info_for_file (NautilusDirectory *directory,
                            NautilusFile      *file)
 {
-  if (directory->details->get_info_file == file) {
-    file_info_cancel (directory);
+  GList *node;
+  GetInfoState *state;
+
+  for (node = directory->details->get_info_in_progress; node != NULL; node = node->next) {
+    state = node->data;
+    if (state->file == file) {
+      get_info_cancel (directory, state);
+      return;
+    }
   }
 }
 
@@ -4846,7 +5686,8 @@ nautilus_directory_add_file_to_work_queue (NautilusDirectory *directory,
 {
   g_return_if_fail (file->details->directory == directory);
 
-  nautilus_file_queue_enqueue (directory->details->high_priority_queue,
+  file->details->work_deferred = FALSE;
+  nautilus_file_queue_enqueue (directory->details->work_queues[WORK_QUEUE_FILE_INFO],
                                file);
 }
 
@@ -4868,33 +5709,130 @@ void
 nautilus_directory_remove_file_from_work_queue (NautilusDirectory *directory,
                                                 NautilusFile *file)
 {
-  nautilus_file_queue_remove (directory->details->high_priority_queue,
-                              file);
-  nautilus_file_queue_remove (directory->details->low_priority_queue,
-                              file);
-  nautilus_file_queue_remove (directory->details->extension_queue,
-                              file);
+  int type;
+
+  for (type = 0; type < WORK_QUEUE_LAST; type++) {
+    nautilus_file_queue_remove (directory->details->work_queues[type],
+                                file);
+  }
 }
 
+/* The queues of the work that is only wanted for the files on screen */
+static const WorkQueueType deferrable_work_queues[] = {
+  WORK_QUEUE_DIRECTORY_COUNT,
+  WORK_QUEUE_TOP_LEFT,
+  WORK_QUEUE_THUMBNAIL
+};
 
-static void
-move_file_to_low_priority_queue (NautilusDirectory *directory,
-                                 NautilusFile *file)
+/* Lets the work on a file that is on screen go before the files that
+ * are not, and brings back the work that was deferred while it was
+ * off screen.
+ */
+void
+nautilus_directory_prioritize_file_in_work_queue (NautilusDirectory *directory,
+                                                  NautilusFile *file)
 {
-  /* Must add before removing to avoid ref underflow */
-  nautilus_file_queue_enqueue (directory->details->low_priority_queue,
-                               file);
-  nautilus_file_queue_remove (directory->details->high_priority_queue,
-                              file);
+  int type;
+  unsigned int i;
+
+  if (file->details->work_deferred) {
+    file->details->work_deferred = FALSE;
+
+    /* Unless it is still on its way to them */
+    if (!nautilus_file_queue_contains (directory->details->work_queues[WORK_QUEUE_FILE_INFO], file) &&
+        !nautilus_file_queue_contains (directory->details->work_queues[WORK_QUEUE_LINK_INFO], file)) {
+      for (i = 0; i < G_N_ELEMENTS (deferrable_work_queues); i++) {
+        nautilus_file_queue_enqueue (directory->details->work_queues[deferrable_work_queues[i]],
+                                     file);
+      }
+
+      /* The idle also restarts the I/O */
+      schedule_call_ready_callbacks (directory);
+    }
+  }
+
+  for (type = 0; type < WORK_QUEUE_LAST; type++) {
+    nautilus_file_queue_move_to_head (directory->details->work_queues[type],
+                                      file);
+  }
+}
+
+/* Drops the work that only shows on screen for a file that went off
+ * screen, unless a call_when_ready callback waits for it.
+ */
+void
+nautilus_directory_defer_file_in_work_queue (NautilusDirectory *directory,
+                                             NautilusFile *file)
+{
+  signed long *counters;
+  WorkQueueType type;
+  unsigned int i;
+
+  counters = directory->details->call_when_ready_counters;
+
+  for (i = 0; i < G_N_ELEMENTS (deferrable_work_queues); i++) {
+    type = deferrable_work_queues[i];
+
+    if ((type == WORK_QUEUE_DIRECTORY_COUNT && counters[REQUEST_DIRECTORY_COUNT] > 0) ||
+        (type == WORK_QUEUE_TOP_LEFT && (counters[REQUEST_TOP_LEFT_TEXT] > 0 ||
+                                         counters[REQUEST_LARGE_TOP_LEFT_TEXT] > 0)) ||
+        (type == WORK_QUEUE_THUMBNAIL && counters[REQUEST_THUMBNAIL] > 0)) {
+      continue;
+    }
+
+    if (nautilus_file_queue_contains (directory->details->work_queues[type], file)) {
+      file->details->work_deferred = TRUE;
+      move_file_to_next_work_queue (directory, file, type);
+    }
+  }
+}
+
+static _Bool
+is_in_attribute_work_queue (NautilusDirectory *directory,
+                            NautilusFile *file,
+                            WorkQueueType skip_type)
+{
+  int type;
+
+  for (type = WORK_QUEUE_MOUNT; type <= WORK_QUEUE_FILESYSTEM_INFO; type++) {
+    if (type != skip_type &&
+        nautilus_file_queue_contains (directory->details->work_queues[type], file)) {
+      return TRUE;
+    }
+  }
+
+  return FALSE;
 }
 
 static void
-move_file_to_extension_queue (NautilusDirectory *directory,
-                              NautilusFile *file)
+move_file_to_next_work_queue (NautilusDirectory *directory,
+                              NautilusFile *file,
+                              WorkQueueType type)
 {
+  int next_type;
+
   /* Must add before removing to avoid ref underflow */
-  nautilus_file_queue_enqueue (directory->details->extension_queue,
-                               file);
-  nautilus_file_queue_remove (directory->details->low_priority_queue,
+  switch (type) {
+  case WORK_QUEUE_FILE_INFO:
+    nautilus_file_queue_enqueue (directory->details->work_queues[WORK_QUEUE_LINK_INFO],
+                                 file);
+    break;
+  case WORK_QUEUE_LINK_INFO:
+    for (next_type = WORK_QUEUE_MOUNT; next_type <= WORK_QUEUE_FILESYSTEM_INFO; next_type++) {
+      nautilus_file_queue_enqueue (directory->details->work_queues[next_type],
+                                   file);
+    }
+    break;
+  case WORK_QUEUE_EXTENSION_INFO:
+    break;
+  default:
+    if (!is_in_attribute_work_queue (directory, file, type)) {
+      nautilus_file_queue_enqueue (directory->details->work_queues[WORK_QUEUE_EXTENSION_INFO],
+                                   file);
+    }
+    break;
+  }
+
+  nautilus_file_queue_remove (directory->details->work_queues[type],
                               file);
 }
@@ -60,6 +60,26 @@ typedef enum {
 	REQUEST_TYPE_LAST
 } RequestType;
 
+/* The work queues, in the order a file goes through them. A file
+ * leaves the file info queue for the link info queue, which needs the
+ * info, then enters every queue from the mount queue to the
+ * filesystem info queue, and gets its extension info after it left
+ * the last of those.
+ */
+typedef enum {
+	WORK_QUEUE_FILE_INFO,
+	WORK_QUEUE_LINK_INFO,
+	WORK_QUEUE_MOUNT,
+	WORK_QUEUE_DIRECTORY_COUNT,
+	WORK_QUEUE_DEEP_COUNT,
+	WORK_QUEUE_MIME_LIST,
+	WORK_QUEUE_TOP_LEFT,
+	WORK_QUEUE_THUMBNAIL,
+	WORK_QUEUE_FILESYSTEM_INFO,
+	WORK_QUEUE_EXTENSION_INFO,
+	WORK_QUEUE_LAST
+} WorkQueueType;
+
 /* A request for information about one or more files. */
 typedef unsigned long Request;
 typedef signed long  RequestCounter[REQUEST_TYPE_LAST];
@@ -77,16 +97,15 @@ struct NautilusDirectoryDetails
 	GList        *file_list;
 	GHashTable   *file_hash;
 
-	/* Queues of files needing some I/O done. */
-	NautilusFileQueue *high_priority_queue;
-	NautilusFileQueue *low_priority_queue;
-	NautilusFileQueue *extension_queue;
+	/* Queues of files needing some I/O done, one per attribute. */
+	NautilusFileQueue *work_queues[WORK_QUEUE_LAST];
 
 	/* These lists are going to be pretty short.  If we think they
 	 * are going to get big, we can use hash tables instead.
 	 */
 	GList *call_when_ready_list;
 	RequestCounter call_when_ready_counters;
+	RequestCounter call_when_ready_directory_counters; /* active callbacks for all files */
 	GList *monitor_list;
 	RequestCounter monitor_counters;
 	unsigned int call_ready_idle_id;
@@ -97,12 +116,25 @@ struct NautilusDirectoryDetails
 	_Bool in_async_service_loop;
 	_Bool state_changed;
 
+	/* How many files in file_list lack each attribute, so callbacks
+	 * for all files need not look at every file to find out.
+	 */
+	RequestCounter missing_counters;
+	unsigned int missing_counts_generation;
+
 	_Bool file_list_monitored;
 	_Bool directory_loaded;
 	_Bool directory_loaded_sent_notification;
 	DirectoryLoadState *directory_load_in_progress;
 
-	GList *pending_file_info; /* list of GnomeVFSFileInfo's that are pending */
+	/* Files shown from the listing snapshot before the load confirms
+	 * them, and the directory times a new snapshot would be valid for.
+	 */
+	GList *snapshot_added_files; /* not announced yet */
+	gint64 snapshot_mtime, snapshot_ctime; /* 0 if unknown */
+
+	GPtrArray *pending_file_info; /* GFileInfo's that are pending, in arrival order */
+	unsigned int pending_file_info_head; /* first one not handled yet */
 	int confirmed_file_count;
     unsigned int dequeue_pending_idle_id;
 
@@ -115,8 +147,8 @@ struct NautilusDirectoryDetails
 
 	MimeListState *mime_list_in_progress;
 
-	NautilusFile *get_info_file;
-	GetInfoState *get_info_in_progress;
+	GList *get_info_in_progress; /* list of GetInfoState * */
+	gint64 get_info_latency; /* average, in microseconds */
 
 	NautilusFile            *extension_info_file;
 	NautilusInfoProvider    *extension_info_provider;
@@ -228,12 +260,28 @@ void               nautilus_directory_end_file_name_change            (NautilusD
                                                                        GList                     *node);
 void               nautilus_directory_moved                           (const char                *from_uri,
                                                                        const char                *to_uri);
+/* Interface to the counts of files that lack an attribute. Update
+ * them after changing anything that a lacks_ check looks at.
+ */
+void               nautilus_directory_add_missing_counts              (NautilusDirectory *directory,
+                                                                       NautilusFile *file);
+void               nautilus_directory_remove_missing_counts           (NautilusDirectory *directory,
+                                                                       NautilusFile *file);
+void               nautilus_directory_update_missing_counts           (NautilusDirectory *directory,
+                                                                       NautilusFile *file);
+/* After a preference that those checks depend on changed */
+void               nautilus_directory_invalidate_missing_counts       (void);
+
 /* Interface to the work queue. */
 
 void               nautilus_directory_add_file_to_work_queue          (NautilusDirectory *directory,
                                                                        NautilusFile *file);
 void               nautilus_directory_remove_file_from_work_queue     (NautilusDirectory *directory,
                                                                        NautilusFile *file);
+void               nautilus_directory_prioritize_file_in_work_queue   (NautilusDirectory *directory,
+                                                                       NautilusFile *file);
+void               nautilus_directory_defer_file_in_work_queue        (NautilusDirectory *directory,
+                                                                       NautilusFile *file);
 
 /* KDE compatibility hacks */
 
@@ -0,0 +1,465 @@
+/* -*- Mode: C; indent-tabs-mode: t; c-basic-offset: 8; tab-width: 8 -*-
+
+   nautilus-directory-snapshot.c: Cache of recent directory listings.
+
+   Copyright (C) 2026 Nautilus contributors
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 2 of the
+   License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public
+   License along with this program; if not, write to the
+   Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+   Boston, MA 02111-1307, USA.
+*/
+
+/* A snapshot file is a header followed by three packed arrays:
+ *
+ *   entries     one per file, with its size, modification time, type,
+ *               flags and the offsets of its names.
+ *   mime types  string offsets, entries refer to them by index so each
+ *               MIME type is stored once.
+ *   strings     the directory URI and the names, NUL terminated.
+ *
+ * The file is named after a checksum of the URI and holds the URI as
+ * well, so a collision reads as a miss.
+ */
+
+#include <config.h>
+#include "nautilus-directory-snapshot.h"
+
+#include <string.h>
+#include <sys/stat.h>
+
+#include <glib/gstdio.h>
+
+#include "nautilus-file-private.h"
+
+#define SNAPSHOT_MAGIC "NAUTLST"
+#define SNAPSHOT_VERSION 1
+
+#define SNAPSHOT_NO_MIME_TYPE G_MAXUINT32
+
+/* Directories larger than this are not worth the disk space */
+#define SNAPSHOT_MAX_ENTRIES 100000
+
+/* How many snapshots to keep, the least recently saved go first */
+#define SNAPSHOT_MAX_FILES 256
+
+/* Look for snapshots to drop after this many saves */
+#define SNAPSHOT_PRUNE_INTERVAL 32
+
+enum {
+	SNAPSHOT_ENTRY_HAS_SIZE = 1 << 0,
+	SNAPSHOT_ENTRY_SYMLINK = 1 << 1,
+	SNAPSHOT_ENTRY_HIDDEN = 1 << 2
+};
+
+typedef struct {
+	char magic[8];
+	guint32 version;
+	guint32 n_entries;
+	gint64 directory_mtime;
+	gint64 directory_ctime;
+	guint32 n_mime_types;
+	guint32 strings_size;
+	guint32 uri;
+	guint32 padding;
+} SnapshotHeader;
+
+typedef struct {
+	gint64 size;
+	gint64 mtime;
+	guint32 name;
+	guint32 display_name;
+	guint32 mime_type;
+	guint16 type;
+	guint16 flags;
+} SnapshotEntry;
+
+struct NautilusDirectorySnapshot {
+	GMappedFile *mapped;
+	const SnapshotHeader *header;
+	const SnapshotEntry *entries;
+	const guint32 *mime_types;
+	const char *strings;
+};
+
+typedef struct {
+	char *path;
+	GByteArray *contents;
+} SaveData;
+
+static GThreadPool *save_pool;
+
+static char *
+get_snapshot_directory (void)
+{
+	return g_build_filename (g_get_user_cache_dir (), "nautilus", "listings", NULL);
+}
+
+static char *
+get_snapshot_path (const char *uri)
+{
+	char *checksum, *directory, *path;
+
+	checksum = g_compute_checksum_for_string (G_CHECKSUM_MD5, uri, -1);
+	directory = get_snapshot_directory ();
+	path = g_build_filename (directory, checksum, NULL);
+	g_free (directory);
+	g_free (checksum);
+
+	return path;
+}
+
+NautilusDirectorySnapshot *
+nautilus_directory_snapshot_load (const char *uri,
+				  gint64      mtime,
+				  gint64      ctime)
+{
+	NautilusDirectorySnapshot *snapshot;
+	GMappedFile *mapped;
+	const SnapshotHeader *header;
+	const char *contents, *strings;
+	gsize length, expected;
+	char *path;
+
+	path = get_snapshot_path (uri);
+	mapped = g_mapped_file_new (path, FALSE, NULL);
+	g_free (path);
+
+	if (mapped == NULL) {
+		return NULL;
+	}
+
+	contents = g_mapped_file_get_contents (mapped);
+	length = g_mapped_file_get_length (mapped);
+	header = (const SnapshotHeader *) contents;
+
+	if (length < sizeof (SnapshotHeader) ||
+	    memcmp (header->magic, SNAPSHOT_MAGIC, sizeof (header->magic)) != 0 ||
+	    header->version != SNAPSHOT_VERSION ||
+	    header->directory_mtime != mtime ||
+	    header->directory_ctime != ctime ||
+	    header->strings_size == 0 ||
+	    header->uri >= header->strings_size) {
+		g_mapped_file_unref (mapped);
+		return NULL;
+	}
+
+	expected = sizeof (SnapshotHeader) +
+		(gsize) header->n_entries * sizeof (SnapshotEntry) +
+		(gsize) header->n_mime_types * sizeof (guint32) +
+		header->strings_size;
+	if (length != expected) {
+		g_mapped_file_unref (mapped);
+		return NULL;
+	}
+
+	/* Every offset below strings_size then ends in a NUL */
+	strings = contents + length - header->strings_size;
+	if (strings[header->strings_size - 1] != '\0' ||
+	    strcmp (strings + header->uri, uri) != 0) {
+		g_mapped_file_unref (mapped);
+		return NULL;
+	}
+
+	snapshot = g_new0 (NautilusDirectorySnapshot, 1);
+	snapshot->mapped = mapped;
+	snapshot->header = header;
+	snapshot->entries = (const SnapshotEntry *) (header + 1);
+	snapshot->mime_types = (const guint32 *) (snapshot->entries + header->n_entries);
+	snapshot->strings = strings;
+
+	return snapshot;
+}
+
+void
+nautilus_directory_snapshot_free (NautilusDirectorySnapshot *snapshot)
+{
+	if (snapshot == NULL) {
+		return;
+	}
+
+	g_mapped_file_unref (snapshot->mapped);
+	g_free (snapshot);
+}
+
+unsigned int
+nautilus_directory_snapshot_get_n_files (NautilusDirectorySnapshot *snapshot)
+{
+	return snapshot->header->n_entries;
+}
+
+static const char *
+snapshot_get_string (NautilusDirectorySnapshot *snapshot,
+		     guint32                    offset)
+{
+	if (offset >= snapshot->header->strings_size) {
+		return NULL;
+	}
+
+	return snapshot->strings + offset;
+}
+
+GFileInfo *
+nautilus_directory_snapshot_get_info (NautilusDirectorySnapshot *snapshot,
+				      unsigned int               index)
+{
+	const SnapshotEntry *entry;
+	const char *name, *display_name, *mime_type;
+	GFileInfo *info;
+
+	g_return_val_if_fail (index < snapshot->header->n_entries, NULL);
+
+	entry = &snapshot->entries[index];
+
+	name = snapshot_get_string (snapshot, entry->name);
+	if (name == NULL || name[0] == '\0') {
+		return NULL;
+	}
+	display_name = snapshot_get_string (snapshot, entry->display_name);
+
+	mime_type = NULL;
+	if (entry->mime_type < snapshot->header->n_mime_types) {
+		mime_type = snapshot_get_string (snapshot, snapshot->mime_types[entry->mime_type]);
+	}
+
+	info = g_file_info_new ();
+	g_file_info_set_name (info, name);
+	if (display_name != NULL) {
+		g_file_info_set_display_name (info, display_name);
+	}
+	g_file_info_set_file_type (info, entry->type);
+	g_file_info_set_is_symlink (info, (entry->flags & SNAPSHOT_ENTRY_SYMLINK) != 0);
+	g_file_info_set_is_hidden (info, (entry->flags & SNAPSHOT_ENTRY_HIDDEN) != 0);
+	if (entry->flags & SNAPSHOT_ENTRY_HAS_SIZE) {
+		g_file_info_set_size (info, entry->size);
+	}
+	g_file_info_set_attribute_uint64 (info, G_FILE_ATTRIBUTE_TIME_MODIFIED, entry->mtime);
+	if (mime_type != NULL) {
+		g_file_info_set_content_type (info, mime_type);
+	}
+
+	return info;
+}
+
+static guint32
+add_string (GString    *strings,
+	    const char *string)
+{
+	guint32 offset;
+
+	offset = strings->len;
+	g_string_append_len (strings, string, strlen (string) + 1);
+
+	return offset;
+}
+
+static void
+prune_snapshots (void)
+{
+	GDir *dir;
+	GPtrArray *paths;
+	GArray *times;
+	const char *name;
+	char *directory, *path, *oldest_path;
+	struct stat statbuf;
+	time_t oldest;
+	unsigned int i, oldest_index;
+
+	directory = get_snapshot_directory ();
+	dir = g_dir_open (directory, 0, NULL);
+	if (dir == NULL) {
+		g_free (directory);
+		return;
+	}
+
+	paths = g_ptr_array_new_with_free_func (g_free);
+	times = g_array_new (FALSE, FALSE, sizeof (time_t));
+	while ((name = g_dir_read_name (dir)) != NULL) {
+		path = g_build_filename (directory, name, NULL);
+		if (g_stat (path, &statbuf) == 0) {
+			g_ptr_array_add (paths, path);
+			g_array_append_val (times, statbuf.st_mtime);
+		} else {
+			g_free (path);
+		}
+	}
+	g_dir_close (dir);
+
+	while (paths->len > SNAPSHOT_MAX_FILES) {
+		oldest_index = 0;
+		oldest = g_array_index (times, time_t, 0);
+		for (i = 1; i < times->len; i++) {
+			if (g_array_index (times, time_t, i) < oldest) {
+				oldest = g_array_index (times, time_t, i);
+				oldest_index = i;
+			}
+		}
+
+		oldest_path = g_ptr_array_index (paths, oldest_index);
+		g_unlink (oldest_path);
+		g_ptr_array_remove_index_fast (paths, oldest_index);
+		g_array_remove_index_fast (times, oldest_index);
+	}
+
+	g_array_free (times, TRUE);
+	g_ptr_array_free (paths, TRUE);
+	g_free (directory);
+}
+
+static void
+save_func (void *data,
+	   void *user_data)
+{
+	static unsigned int n_saves = 0;
+	SaveData *save_data;
+	char *directory;
+
+	save_data = data;
+
+	directory = get_snapshot_directory ();
+	g_mkdir_with_parents (directory, 0700);
+	g_free (directory);
+
+	/* Written next to the old one and swapped in, so a reader never
+	 * maps half a snapshot.
+	 */
+	g_file_set_contents (save_data->path,
+			     (const char *) save_data->contents->data,
+			     save_data->contents->len,
+			     NULL);
+
+	if (++n_saves % SNAPSHOT_PRUNE_INTERVAL == 0) {
+		prune_snapshots ();
+	}
+
+	g_byte_array_free (save_data->contents, TRUE);
+	g_free (save_data->path);
+	g_free (save_data);
+}
+
+void
+nautilus_directory_snapshot_save (const char *uri,
+				  gint64      mtime,
+				  gint64      ctime,
+				  GList      *file_list)
+{
+	SnapshotHeader header;
+	SnapshotEntry entry;
+	NautilusFile *file;
+	GArray *entries, *mime_types;
+	GHashTable *mime_type_ids;
+	GString *strings;
+	GByteArray *contents;
+	SaveData *save_data;
+	const char *name, *display_name, *mime_type;
+	guint32 offset;
+	void *id;
+	GList *node;
+
+	if (g_list_length (file_list) > SNAPSHOT_MAX_ENTRIES) {
+		return;
+	}
+
+	entries = g_array_new (FALSE, FALSE, sizeof (SnapshotEntry));
+	mime_types = g_array_new (FALSE, FALSE, sizeof (guint32));
+	mime_type_ids = g_hash_table_new (g_str_hash, g_str_equal);
+	strings = g_string_new (NULL);
+
+	memset (&header, 0, sizeof (header));
+	memcpy (header.magic, SNAPSHOT_MAGIC, sizeof (header.magic));
+	header.version = SNAPSHOT_VERSION;
+	header.directory_mtime = mtime;
+	header.directory_ctime = ctime;
+	header.uri = add_string (strings, uri);
+
+	for (node = file_list; node != NULL; node = node->next) {
+		file = NAUTILUS_FILE (node->data);
+
+		if (file->details->is_gone ||
+		    !file->details->got_file_info ||
+		    file->details->name == NULL) {
+			continue;
+		}
+
+		memset (&entry, 0, sizeof (entry));
+
+		name = eel_ref_str_peek (file->details->name);
+		entry.name = add_string (strings, name);
+
+		display_name = eel_ref_str_peek (file->details->display_name);
+		if (display_name == NULL || strcmp (display_name, name) == 0) {
+			entry.display_name = entry.name;
+		} else {
+			entry.display_name = add_string (strings, display_name);
+		}
+
+		entry.mime_type = SNAPSHOT_NO_MIME_TYPE;
+		mime_type = eel_ref_str_peek (file->details->mime_type);
+		if (mime_type != NULL) {
+			if (g_hash_table_lookup_extended (mime_type_ids, mime_type, NULL, &id)) {
+				entry.mime_type = GPOINTER_TO_UINT (id);
+			} else {
+				entry.mime_type = mime_types->len;
+				offset = add_string (strings, mime_type);
+				g_array_append_val (mime_types, offset);
+				g_hash_table_insert (mime_type_ids, (char *) mime_type,
+						     GUINT_TO_POINTER (entry.mime_type));
+			}
+		}
+
+		entry.type = file->details->type;
+		entry.mtime = file->details->mtime;
+		if (file->details->size >= 0) {
+			entry.size = file->details->size;
+			entry.flags |= SNAPSHOT_ENTRY_HAS_SIZE;
+		}
+		if (file->details->is_symlink) {
+			entry.flags |= SNAPSHOT_ENTRY_SYMLINK;
+		}
+		if (file->details->is_hidden) {
+			entry.flags |= SNAPSHOT_ENTRY_HIDDEN;
+		}
+
+		g_array_append_val (entries, entry);
+	}
+
+	header.n_entries = entries->len;
+	header.n_mime_types = mime_types->len;
+	header.strings_size = strings->len;
+
+	contents = g_byte_array_sized_new (sizeof (header) +
+					   entries->len * sizeof (SnapshotEntry) +
+					   mime_types->len * sizeof (guint32) +
+					   strings->len);
+	g_byte_array_append (contents, (const guint8 *) &header, sizeof (header));
+	g_byte_array_append (contents, (const guint8 *) entries->data,
+			     entries->len * sizeof (SnapshotEntry));
+	g_byte_array_append (contents, (const guint8 *) mime_types->data,
+			     mime_types->len * sizeof (guint32));
+	g_byte_array_append (contents, (const guint8 *) strings->str, strings->len);
+
+	g_hash_table_destroy (mime_type_ids);
+	g_array_free (mime_types, TRUE);
+	g_array_free (entries, TRUE);
+	g_string_free (strings, TRUE);
+
+	save_data = g_new0 (SaveData, 1);
+	save_data->path = get_snapshot_path (uri);
+	save_data->contents = contents;
+
+	/* One writer, so saves of the same directory land in order */
+	if (save_pool == NULL) {
+		save_pool = g_thread_pool_new (save_func, NULL, 1, FALSE, NULL);
+	}
+	g_thread_pool_push (save_pool, save_data, NULL);
+}
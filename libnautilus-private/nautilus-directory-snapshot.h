@@ -0,0 +1,57 @@
+/* -*- Mode: C; indent-tabs-mode: t; c-basic-offset: 8; tab-width: 8 -*-
+
+   nautilus-directory-snapshot.h: Cache of recent directory listings.
+
+   Copyright (C) 2026 Nautilus contributors
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 2 of the
+   License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public
+   License along with this program; if not, write to the
+   Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+   Boston, MA 02111-1307, USA.
+*/
+
+#ifndef NAUTILUS_DIRECTORY_SNAPSHOT_H
+#define NAUTILUS_DIRECTORY_SNAPSHOT_H
+
+#include <gio/gio.h>
+
+/* A snapshot is the listing of a directory as it was last loaded:
+ * the names, types, sizes, modification times and MIME types of its
+ * files. Each one is a memory mapped file in the user cache directory,
+ * keyed by the directory's URI and valid for as long as the modification
+ * and change times of the directory itself are the ones it was taken at.
+ */
+
+typedef struct NautilusDirectorySnapshot NautilusDirectorySnapshot;
+
+/* NULL unless a snapshot of @uri taken at these times exists */
+NautilusDirectorySnapshot *nautilus_directory_snapshot_load        (const char                *uri,
+								     gint64                     mtime,
+								     gint64                     ctime);
+void                       nautilus_directory_snapshot_free        (NautilusDirectorySnapshot *snapshot);
+
+unsigned int               nautilus_directory_snapshot_get_n_files (NautilusDirectorySnapshot *snapshot);
+
+/* A new info holding what the snapshot knows about file @index */
+GFileInfo                 *nautilus_directory_snapshot_get_info    (NautilusDirectorySnapshot *snapshot,
+								     unsigned int               index);
+
+/* Writes a snapshot of the files in @file_list, a list of NautilusFile,
+ * in the background.
+ */
+void                       nautilus_directory_snapshot_save        (const char                *uri,
+								     gint64                     mtime,
+								     gint64                     ctime,
+								     GList                     *file_list);
+
+#endif /* NAUTILUS_DIRECTORY_SNAPSHOT_H */
@@ -134,11 +134,14 @@ nautilus_directory_class_init (NautilusDirectoryClass *klass)
 static void
 nautilus_directory_init (NautilusDirectory *directory)
 {
+  int i;
+
   directory->details                      = G_TYPE_INSTANCE_GET_PRIVATE ((directory), NAUTILUS_TYPE_DIRECTORY, NautilusDirectoryDetails);
   directory->details->file_hash           = g_hash_table_new (g_str_hash, g_str_equal);
-  directory->details->high_priority_queue = nautilus_file_queue_new ();
-  directory->details->low_priority_queue  = nautilus_file_queue_new ();
-  directory->details->extension_queue     = nautilus_file_queue_new ();
+
+  for (i = 0; i < WORK_QUEUE_LAST; i++) {
+    directory->details->work_queues[i] = nautilus_file_queue_new ();
+  }
 }
 
 NautilusDirectory *
@@ -169,6 +172,7 @@ static void
 nautilus_directory_finalize (GObject *object)
 {
   NautilusDirectory *directory;
+  int i;
 
   directory = NAUTILUS_DIRECTORY (object);
 
@@ -211,9 +215,9 @@ nautilus_directory_finalize (GObject *object)
     g_hash_table_destroy (directory->details->hidden_file_hash);
   }
 
-  nautilus_file_queue_destroy (directory->details->high_priority_queue);
-  nautilus_file_queue_destroy (directory->details->low_priority_queue);
-  nautilus_file_queue_destroy (directory->details->extension_queue);
+  for (i = 0; i < WORK_QUEUE_LAST; i++) {
+    nautilus_file_queue_destroy (directory->details->work_queues[i]);
+  }
 
 // if (directory->details->top_left_read_state != NULL) {
 //    BUG_MSG("top_left_read_state != NULL");
@@ -231,7 +235,9 @@ nautilus_directory_finalize (GObject *object)
     BUG_MSG("dequeue_pending_idle_id != 0");
   }
 
-  g_list_free_full (directory->details->pending_file_info, g_object_unref);
+  if (directory->details->pending_file_info != NULL) {
+    g_ptr_array_unref (directory->details->pending_file_info);
+  }
 
   G_OBJECT_CLASS (nautilus_directory_parent_class)->finalize (object);
 }
@@ -332,6 +338,7 @@ async_data_preference_changed_callback (void *callback_data)
 	 * we have to kick off refetching all async data, and tell
 	 * each file that it (might have) changed.
 	 */
+	nautilus_directory_invalidate_missing_counts ();
 	g_hash_table_foreach (directories, async_state_changed_one, NULL);
 }
 
@@ -705,6 +712,8 @@ nautilus_directory_add_file (NautilusDirectory *directory, NautilusFile *file)
         /* Add to hash table. */
         add_to_hash_table (directory, file, node);
 
+        nautilus_directory_add_missing_counts (directory, file);
+
         directory->details->confirmed_file_count++;
 
         add_to_work_queue = FALSE;
@@ -753,6 +762,8 @@ nautilus_directory_remove_file (NautilusDirectory *directory, NautilusFile *file
             (directory->details->file_list, node);
             g_list_free_1 (node);
 
+            nautilus_directory_remove_missing_counts (directory, file);
+
             nautilus_directory_remove_file_from_work_queue (directory, file);
 
             if (!file->details->unconfirmed) {
@@ -1195,6 +1206,7 @@ nautilus_directory_notify_files_changed (GList *files)
 			file->details->top_left_text_is_up_to_date = FALSE;
 			file->details->link_info_is_up_to_date = FALSE;
 			nautilus_file_invalidate_extension_info_internal (file);
+			nautilus_directory_update_missing_counts (file->details->directory, file);
 
 			hash_table_list_prepend (changed_lists,
 						 file->details->directory,
@@ -21,6 +21,7 @@
 */
 
 #include <config.h>
+#include <string.h>
 #include <glib.h>
 #include <gio/gio.h>
 #include <gdk-pixbuf/gdk-pixbuf.h>
@@ -35,9 +36,10 @@
 #include <nautilus-icon-info.h>
 #include "nautilus-file.h"
 #include "nautilus-directory-notify.h"
+#include "nautilus-search-index.h"
 
 typedef enum {
-	CHANGE_FILE_INITIAL,
+	CHANGE_FILE_INITIAL, /* also a change dropped by coalescing */
 	CHANGE_FILE_ADDED,
 	CHANGE_FILE_CHANGED,
 	CHANGE_FILE_REMOVED,
@@ -46,18 +48,54 @@ typedef enum {
 	CHANGE_POSITION_REMOVE
 } NautilusFileChangeKind;
 
-typedef struct {
+/* While changes keep coming, they are handed on at most this often,
+ * so more of them are coalesced before the directories see them.
+ */
+#define CONSUME_CHANGES_INTERVAL_MSECS 100
+
+/* Most records the main thread keeps around for reuse */
+#define FREE_CHANGES_MAX 256
+
+typedef struct NautilusFileChange NautilusFileChange;
+
+struct NautilusFileChange {
+	NautilusFileChange *next;
 	NautilusFileChangeKind kind;
 	GFile *from;
 	GFile *to;
 	GdkPoint point;
 	int screen;
-} NautilusFileChange;
+};
 
+/* Changes come from the main thread and from file operation threads.
+ * Those push them on the incoming stack with a compare and swap and
+ * never wait for each other or for the main thread. The main thread
+ * takes the whole stack at once and moves it, oldest first, into
+ * the list it coalesces and consumes from, which only it touches.
+ */
 typedef struct {
-	GList *head;
-	GList *tail;
-	GMutex mutex;
+	NautilusFileChange *incoming;	/* newest first */
+	int consume_scheduled;
+
+	/* Records freed by the main thread. A thread that runs out takes
+	 * the whole stack into its own cache, so records are never
+	 * popped one by one from under another thread.
+	 */
+	NautilusFileChange *free_changes;
+	int n_free_changes;
+
+	NautilusFileChange *first;
+	NautilusFileChange *last;
+
+	/* The last queued added, changed, removed or moved change of
+	 * each location, moves under their destination.
+	 */
+	GHashTable *last_changes;
+
+	gint64 last_consume_time;
+
+	unsigned int n_queued;
+	unsigned int n_suppressed;
 } NautilusFileChangesQueue;
 
 static NautilusFileChangesQueue *
@@ -66,7 +104,7 @@ nautilus_file_changes_queue_new (void)
 	NautilusFileChangesQueue *result;
 
 	result = g_new0 (NautilusFileChangesQueue, 1);
-	g_mutex_init (&result->mutex);
+	result->last_changes = g_hash_table_new (g_file_hash, (GEqualFunc) g_file_equal);
 
 	return result;
 }
@@ -76,25 +114,290 @@ nautilus_file_changes_queue_get (void)
 {
 	static NautilusFileChangesQueue *file_changes_queue;
 
-	if (file_changes_queue == NULL) {
-		file_changes_queue = nautilus_file_changes_queue_new ();
+	if (g_once_init_enter (&file_changes_queue)) {
+		g_once_init_leave (&file_changes_queue, nautilus_file_changes_queue_new ());
 	}
 
 	return file_changes_queue;
 }
 
+static _Bool
+change_is_coalesced (NautilusFileChange *change)
+{
+	return change->kind == CHANGE_FILE_ADDED
+		|| change->kind == CHANGE_FILE_CHANGED
+		|| change->kind == CHANGE_FILE_REMOVED
+		|| change->kind == CHANGE_FILE_MOVED;
+}
+
+static GFile *
+change_get_location (NautilusFileChange *change)
+{
+	return change->kind == CHANGE_FILE_MOVED ? change->to : change->from;
+}
+
+static void
+forget_last_change (NautilusFileChangesQueue *queue,
+		    NautilusFileChange *change)
+{
+	GFile *location;
+
+	location = change_get_location (change);
+	if (g_hash_table_lookup (queue->last_changes, location) == change) {
+		g_hash_table_remove (queue->last_changes, location);
+	}
+}
+
+/* Folds @change into the changes still queued for its location.
+ * Returns FALSE if nothing is left of it to queue. Builds that
+ * rewrite thousands of files send many redundant events, this
+ * keeps them from all reaching the directories.
+ */
+static _Bool
+coalesce_change (NautilusFileChangesQueue *queue,
+		 NautilusFileChange *change)
+{
+	NautilusFileChange *last;
+
+	if (!change_is_coalesced (change)) {
+		return TRUE;
+	}
+
+	last = g_hash_table_lookup (queue->last_changes, change->from);
+
+	switch (change->kind) {
+	case CHANGE_FILE_ADDED:
+	case CHANGE_FILE_CHANGED:
+		/* The file is read once the queued change is handled,
+		 * which covers this one as well.
+		 */
+		if (last != NULL &&
+		    (last->kind == CHANGE_FILE_ADDED ||
+		     (last->kind == CHANGE_FILE_CHANGED && change->kind == CHANGE_FILE_CHANGED))) {
+			queue->n_suppressed++;
+			return FALSE;
+		}
+		break;
+
+	case CHANGE_FILE_REMOVED:
+		/* Keep only the removal. The file may have been shown
+		 * before it was added again, so it still has to go.
+		 */
+		if (last != NULL &&
+		    (last->kind == CHANGE_FILE_ADDED || last->kind == CHANGE_FILE_CHANGED)) {
+			forget_last_change (queue, last);
+			last->kind = CHANGE_FILE_INITIAL;
+			queue->n_suppressed++;
+		}
+		break;
+
+	case CHANGE_FILE_MOVED:
+		/* Added or moved to a place and moved on from it, go
+		 * straight to the end. Only if nothing is queued for the
+		 * destination, that would have to see the file after.
+		 */
+		if (last != NULL &&
+		    (last->kind == CHANGE_FILE_ADDED ||
+		     (last->kind == CHANGE_FILE_MOVED && !g_file_equal (last->from, change->to))) &&
+		    g_hash_table_lookup (queue->last_changes, change->to) == NULL) {
+			forget_last_change (queue, last);
+			if (last->kind == CHANGE_FILE_ADDED) {
+				g_object_unref (last->from);
+				last->from = g_object_ref (change->to);
+			} else {
+				g_object_unref (last->to);
+				last->to = g_object_ref (change->to);
+			}
+			g_hash_table_replace (queue->last_changes, change_get_location (last), last);
+			queue->n_suppressed++;
+			return FALSE;
+		}
+		break;
+
+	default:
+		break;
+	}
+
+	g_hash_table_replace (queue->last_changes, change_get_location (change), change);
+
+	return TRUE;
+}
+
+static void
+free_change_cache (void *data)
+{
+	NautilusFileChange *change, *next;
+
+	for (change = data; change != NULL; change = next) {
+		next = change->next;
+		g_free (change);
+	}
+}
+
+/* The records this thread took from the free stack */
+static GPrivate change_cache = G_PRIVATE_INIT (free_change_cache);
+
+static NautilusFileChange *
+nautilus_file_change_new (NautilusFileChangesQueue *queue)
+{
+	NautilusFileChange *change, *node;
+	int n_taken;
+
+	change = g_private_get (&change_cache);
+	if (change == NULL) {
+		do {
+			change = g_atomic_pointer_get (&queue->free_changes);
+		} while (!g_atomic_pointer_compare_and_exchange (&queue->free_changes, change, NULL));
+
+		n_taken = 0;
+		for (node = change; node != NULL; node = node->next) {
+			n_taken++;
+		}
+		g_atomic_int_add (&queue->n_free_changes, -n_taken);
+	}
+
+	if (change == NULL) {
+		return g_new0 (NautilusFileChange, 1);
+	}
+
+	g_private_set (&change_cache, change->next);
+	memset (change, 0, sizeof (NautilusFileChange));
+
+	return change;
+}
+
+/* Main thread only, the references were released or handed on */
+static void
+nautilus_file_change_recycle (NautilusFileChangesQueue *queue,
+			      NautilusFileChange *change)
+{
+	NautilusFileChange *head;
+
+	if (g_atomic_int_get (&queue->n_free_changes) >= FREE_CHANGES_MAX) {
+		g_free (change);
+		return;
+	}
+
+	g_atomic_int_inc (&queue->n_free_changes);
+	do {
+		head = g_atomic_pointer_get (&queue->free_changes);
+		change->next = head;
+	} while (!g_atomic_pointer_compare_and_exchange (&queue->free_changes, head, change));
+}
+
+static void
+nautilus_file_change_free (NautilusFileChangesQueue *queue,
+			   NautilusFileChange *change)
+{
+	g_object_unref (change->from);
+	if (change->kind == CHANGE_FILE_MOVED) {
+		g_object_unref (change->to);
+	}
+	nautilus_file_change_recycle (queue, change);
+}
+
+/* Is really _Bool but glib errently defines gboolean as int */
+static int
+consume_changes_idle_cb (void *not_used)
+{
+	NautilusFileChangesQueue *queue;
+	gint64 elapsed_msecs;
+
+	queue = nautilus_file_changes_queue_get ();
+
+	elapsed_msecs = (g_get_monotonic_time () - queue->last_consume_time) / 1000;
+	if (elapsed_msecs < CONSUME_CHANGES_INTERVAL_MSECS) {
+		g_timeout_add (CONSUME_CHANGES_INTERVAL_MSECS - elapsed_msecs,
+			       consume_changes_idle_cb, NULL);
+		return FALSE;
+	}
+
+	/* Changes pushed from here on schedule the next round */
+	g_atomic_int_set (&queue->consume_scheduled, FALSE);
+
+	nautilus_file_changes_consume_changes (TRUE);
+
+	return FALSE;
+}
+
 static void
 nautilus_file_changes_queue_add_common (NautilusFileChangesQueue *queue,
 	NautilusFileChange *new_item)
 {
-	/* enqueue the new queue item while locking down the list */
-	g_mutex_lock (&queue->mutex);
+	NautilusFileChange *head;
+
+	do {
+		head = g_atomic_pointer_get (&queue->incoming);
+		new_item->next = head;
+	} while (!g_atomic_pointer_compare_and_exchange (&queue->incoming, head, new_item));
+
+	/* Only the first change since the last round wakes the main
+	 * loop, g_idle_add () may be called from any thread.
+	 */
+	if (g_atomic_int_compare_and_exchange (&queue->consume_scheduled, FALSE, TRUE)) {
+		g_idle_add (consume_changes_idle_cb, NULL);
+	}
+}
+
+/* Main thread only. Moves what the producers pushed so far into the
+ * list, coalescing on the way.
+ */
+static void
+nautilus_file_changes_queue_take_incoming (NautilusFileChangesQueue *queue)
+{
+	NautilusFileChange *change, *next, *oldest_first;
+
+	do {
+		change = g_atomic_pointer_get (&queue->incoming);
+	} while (!g_atomic_pointer_compare_and_exchange (&queue->incoming, change, NULL));
+
+	oldest_first = NULL;
+	for (; change != NULL; change = next) {
+		next = change->next;
+		change->next = oldest_first;
+		oldest_first = change;
+	}
 
-	queue->head = g_list_prepend (queue->head, new_item);
-	if (queue->tail == NULL)
-		queue->tail = queue->head;
+	for (change = oldest_first; change != NULL; change = next) {
+		next = change->next;
+		change->next = NULL;
 
-	g_mutex_unlock (&queue->mutex);
+		if (!coalesce_change (queue, change)) {
+			nautilus_file_change_free (queue, change);
+			continue;
+		}
+
+		if (queue->last == NULL) {
+			queue->first = change;
+		} else {
+			queue->last->next = change;
+		}
+		queue->last = change;
+		queue->n_queued++;
+	}
+}
+
+/**
+ * nautilus_file_changes_queue_get_counts:
+ * @n_queued: Return location for the number of changes queued
+ * @n_suppressed: Return location for the number of changes coalesced
+ * into others
+ *
+ * Both count from the start of the process, up to the changes pushed
+ * before the call. Call from the main thread.
+ **/
+void
+nautilus_file_changes_queue_get_counts (unsigned int *n_queued,
+					unsigned int *n_suppressed)
+{
+	NautilusFileChangesQueue *queue;
+
+	queue = nautilus_file_changes_queue_get ();
+
+	nautilus_file_changes_queue_take_incoming (queue);
+
+	*n_queued = queue->n_queued;
+	*n_suppressed = queue->n_suppressed;
 }
 
 void
@@ -105,7 +408,7 @@ nautilus_file_changes_queue_file_added (GFile *location)
 
 	queue = nautilus_file_changes_queue_get();
 
-	new_item = g_new0 (NautilusFileChange, 1);
+	new_item = nautilus_file_change_new (queue);
 	new_item->kind = CHANGE_FILE_ADDED;
 	new_item->from = g_object_ref (location);
 	nautilus_file_changes_queue_add_common (queue, new_item);
@@ -119,7 +422,7 @@ nautilus_file_changes_queue_file_changed (GFile *location)
 
 	queue = nautilus_file_changes_queue_get();
 
-	new_item = g_new0 (NautilusFileChange, 1);
+	new_item = nautilus_file_change_new (queue);
 	new_item->kind = CHANGE_FILE_CHANGED;
 	new_item->from = g_object_ref (location);
 	nautilus_file_changes_queue_add_common (queue, new_item);
@@ -133,7 +436,7 @@ nautilus_file_changes_queue_file_removed (GFile *location)
 
 	queue = nautilus_file_changes_queue_get();
 
-	new_item = g_new0 (NautilusFileChange, 1);
+	new_item = nautilus_file_change_new (queue);
 	new_item->kind = CHANGE_FILE_REMOVED;
 	new_item->from = g_object_ref (location);
 	nautilus_file_changes_queue_add_common (queue, new_item);
@@ -148,7 +451,7 @@ nautilus_file_changes_queue_file_moved (GFile *from,
 
 	queue = nautilus_file_changes_queue_get ();
 
-	new_item = g_new (NautilusFileChange, 1);
+	new_item = nautilus_file_change_new (queue);
 	new_item->kind = CHANGE_FILE_MOVED;
 	new_item->from = g_object_ref (from);
 	new_item->to = g_object_ref (to);
@@ -165,7 +468,7 @@ nautilus_file_changes_queue_schedule_position_set (GFile *location,
 
 	queue = nautilus_file_changes_queue_get ();
 
-	new_item = g_new (NautilusFileChange, 1);
+	new_item = nautilus_file_change_new (queue);
 	new_item->kind = CHANGE_POSITION_SET;
 	new_item->from = g_object_ref (location);
 	new_item->point = point;
@@ -181,7 +484,7 @@ nautilus_file_changes_queue_schedule_position_remove (GFile *location)
 
 	queue = nautilus_file_changes_queue_get ();
 
-	new_item = g_new (NautilusFileChange, 1);
+	new_item = nautilus_file_change_new (queue);
 	new_item->kind = CHANGE_POSITION_REMOVE;
 	new_item->from = g_object_ref (location);
 	nautilus_file_changes_queue_add_common (queue, new_item);
@@ -190,26 +493,26 @@ nautilus_file_changes_queue_schedule_position_remove (GFile *location)
 static NautilusFileChange *
 nautilus_file_changes_queue_get_change (NautilusFileChangesQueue *queue)
 {
-	GList *new_tail;
 	NautilusFileChange *result;
 
 	g_assert (queue != NULL);
 
-	/* dequeue the tail item while locking down the list */
-	g_mutex_lock (&queue->mutex);
-
-	if (queue->tail == NULL) {
-		result = NULL;
-	} else {
-		new_tail = queue->tail->prev;
-		result = queue->tail->data;
-		queue->head = g_list_remove_link (queue->head,
-						  queue->tail);
-		g_list_free_1 (queue->tail);
-		queue->tail = new_tail;
+	if (queue->first == NULL) {
+		nautilus_file_changes_queue_take_incoming (queue);
 	}
 
-	g_mutex_unlock (&queue->mutex);
+	result = queue->first;
+	if (result != NULL) {
+		queue->first = result->next;
+		if (queue->first == NULL) {
+			queue->last = NULL;
+		}
+		result->next = NULL;
+
+		if (change_is_coalesced (result)) {
+			forget_last_change (queue, result);
+		}
+	}
 
 	return result;
 }
@@ -274,6 +577,7 @@ nautilus_file_changes_consume_changes (_Bool consume_all)
 	position_set_requests = NULL;
 
 	queue = nautilus_file_changes_queue_get();
+	queue->last_consume_time = g_get_monotonic_time ();
 
 	/* Consume changes from the queue, stuffing them into one of three lists,
 	 * keep doing it while the changes are of the same kind, then send them off.
@@ -283,6 +587,12 @@ nautilus_file_changes_consume_changes (_Bool consume_all)
 	for (chunk_count = 0; ; chunk_count++) {
 		change = nautilus_file_changes_queue_get_change (queue);
 
+		if (change != NULL && change->kind == CHANGE_FILE_INITIAL) {
+			/* coalesced into a later change */
+			nautilus_file_change_free (queue, change);
+			continue;
+		}
+
 		/* figure out if we need to flush the pending changes that we collected sofar */
 
 		if (change == NULL) {
@@ -324,18 +634,21 @@ nautilus_file_changes_consume_changes (_Bool consume_all)
 			if (deletions != NULL) {
 				deletions = g_list_reverse (deletions);
 				nautilus_directory_notify_files_removed (deletions);
+				nautilus_search_index_files_removed (deletions);
 				g_list_free_full (deletions, g_object_unref);
 				deletions = NULL;
 			}
 			if (moves != NULL) {
 				moves = g_list_reverse (moves);
 				nautilus_directory_notify_files_moved (moves);
+				nautilus_search_index_files_moved (moves);
 				pairs_list_free (moves);
 				moves = NULL;
 			}
 			if (additions != NULL) {
 				additions = g_list_reverse (additions);
 				nautilus_directory_notify_files_added (additions);
+				nautilus_search_index_files_added (additions);
 				g_list_free_full (additions, g_object_unref);
 				additions = NULL;
 			}
@@ -402,6 +715,6 @@ nautilus_file_changes_consume_changes (_Bool consume_all)
 			break;
 		}
 
-		g_free (change);
+		nautilus_file_change_recycle (queue, change);
 	}
 }
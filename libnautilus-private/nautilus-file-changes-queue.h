@@ -34,6 +34,8 @@ void nautilus_file_changes_queue_schedule_position_set           (GFile      *lo
 void nautilus_file_changes_queue_schedule_position_remove        (GFile      *location);
 
 void nautilus_file_changes_consume_changes                       (_Bool    consume_all);
+void nautilus_file_changes_queue_get_counts                      (unsigned int *n_queued,
+                                                                  unsigned int *n_suppressed);
 
 
 #endif /* NAUTILUS_FILE_CHANGES_QUEUE_H */
@@ -26,16 +26,28 @@
             Pavel Cisler <pavel@eazel.com>
  */
 
+/* For copy_file_range () */
+#define _GNU_SOURCE
+
 #include <config.h>
 #include <string.h>
 #include <stdio.h>
 
 #include <unistd.h>
+#include <fcntl.h>
+#include <sys/ioctl.h>
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <stdlib.h>
 #include <errno.h>
 
+#ifdef HAVE_LINUX_FS_H
+#include <linux/fs.h>
+#endif
+#ifdef HAVE_SYS_SENDFILE_H
+#include <sys/sendfile.h>
+#endif
+
 #include <glib.h>
 #include <glib/gi18n.h>
 
@@ -84,6 +96,24 @@ typedef struct {
 	_Bool delete_all;
 } CommonJob;
 
+typedef enum {
+    OP_KIND_COPY,
+    OP_KIND_MOVE,
+    OP_KIND_DELETE,
+    OP_KIND_TRASH,
+    OP_KIND_EMPTY_TRASH,
+    OP_KIND_DUPE,
+    OP_KIND_PERMISSIONS,
+    OP_KIND_LINK
+} OpKind;
+
+typedef struct {
+	int num_files;
+	goffset num_bytes;
+	int num_files_since_progress;
+	OpKind op;
+} SourceInfo;
+
 typedef struct {
 	CommonJob common;
 	_Bool is_move;
@@ -97,6 +127,17 @@ typedef struct {
 	char *target_name;
 	NautilusCopyCallback  done_callback;
 	gpointer done_callback_data;
+	GThreadPool *copy_pool;
+	GAsyncQueue *copied_files;
+	int n_copies_in_flight;
+	/* Streaming mode, the sources are counted while copying */
+	GThread *scan_thread;
+	GCancellable *scan_cancellable; /* also cancelled with the job */
+	gulong scan_cancelled_id;
+	GMutex scan_lock;
+	SourceInfo scanned;
+	_Bool scan_done;
+	_Bool scan_checked;
 } CopyMoveJob;
 
 typedef struct {
@@ -151,23 +192,6 @@ typedef struct {
 	guint32 dir_mask;
 } SetPermissionsJob;
 
-typedef enum {
-    OP_KIND_COPY,
-    OP_KIND_MOVE,
-    OP_KIND_DELETE,
-    OP_KIND_TRASH,
-    OP_KIND_EMPTY_TRASH,
-    OP_KIND_DUPE,
-    OP_KIND_PERMISSIONS,
-    OP_KIND_LINK
-} OpKind;
-
-typedef struct {
-	int num_files;
-	goffset num_bytes;
-	int num_files_since_progress;
-	OpKind op;
-} SourceInfo;
 
 typedef struct {
 	int num_files;
@@ -224,6 +248,10 @@ static void scan_sources (GList *files,
 
 static int empty_trash_job (GIOSchedulerJob *io_job, GCancellable *cancellable, void *user_data);
 
+static _Bool update_streamed_source_info (CopyMoveJob *job,
+					  SourceInfo *source_info,
+					  TransferInfo *transfer_info);
+
 static char * query_fs_type (GFile *file,
 			     GCancellable *cancellable);
 
@@ -2925,6 +2953,163 @@ scan_sources (GList *files, SourceInfo *source_info, CommonJob *job, OpKind kind
     report_count_progress (job, source_info);
 }
 
+static void
+publish_streamed_count (CopyMoveJob *job, SourceInfo *counted, _Bool done)
+{
+	g_mutex_lock (&job->scan_lock);
+	job->scanned = *counted;
+	job->scan_done = done;
+	g_mutex_unlock (&job->scan_lock);
+}
+
+static void
+stream_count_file (CopyMoveJob *job, GFileInfo *info, SourceInfo *counted)
+{
+	counted->num_files += 1;
+	counted->num_bytes += g_file_info_get_size (info);
+
+	if (counted->num_files_since_progress++ > 100) {
+		publish_streamed_count (job, counted, FALSE);
+		counted->num_files_since_progress = 0;
+	}
+}
+
+/* Counts the sources in streaming mode. Runs next to the copy and never
+ * asks anything: whatever it cannot read the copy will report itself.
+ */
+static void *
+stream_scan_thread_func (void *user_data)
+{
+	CopyMoveJob *job;
+	GCancellable *cancellable;
+	SourceInfo counted;
+	GFileEnumerator *enumerator;
+	GFileInfo *info;
+	GQueue *dirs;
+	GFile *dir;
+	GList *l;
+
+	job = user_data;
+	cancellable = job->scan_cancellable;
+
+	memset (&counted, 0, sizeof (SourceInfo));
+	counted.op = OP_KIND_COPY;
+	dirs = g_queue_new ();
+
+	for (l = job->files; l != NULL && !g_cancellable_is_cancelled (cancellable); l = l->next) {
+		info = g_file_query_info (l->data,
+					  G_FILE_ATTRIBUTE_STANDARD_TYPE","
+					  G_FILE_ATTRIBUTE_STANDARD_SIZE,
+					  G_FILE_QUERY_INFO_NOFOLLOW_SYMLINKS,
+					  cancellable,
+					  NULL);
+		if (info != NULL) {
+			stream_count_file (job, info, &counted);
+			if (g_file_info_get_file_type (info) == G_FILE_TYPE_DIRECTORY) {
+				g_queue_push_tail (dirs, g_object_ref (l->data));
+			}
+			g_object_unref (info);
+		}
+	}
+
+	while (!g_cancellable_is_cancelled (cancellable) &&
+	       (dir = g_queue_pop_head (dirs)) != NULL) {
+		enumerator = g_file_enumerate_children (dir,
+							G_FILE_ATTRIBUTE_STANDARD_NAME","
+							G_FILE_ATTRIBUTE_STANDARD_TYPE","
+							G_FILE_ATTRIBUTE_STANDARD_SIZE,
+							G_FILE_QUERY_INFO_NOFOLLOW_SYMLINKS,
+							cancellable,
+							NULL);
+		if (enumerator != NULL) {
+			while ((info = g_file_enumerator_next_file (enumerator, cancellable, NULL)) != NULL) {
+				stream_count_file (job, info, &counted);
+				if (g_file_info_get_file_type (info) == G_FILE_TYPE_DIRECTORY) {
+					/* Depth-first, the same order the copy walks */
+					g_queue_push_head (dirs, g_file_get_child (dir, g_file_info_get_name (info)));
+				}
+				g_object_unref (info);
+			}
+			g_file_enumerator_close (enumerator, cancellable, NULL);
+			g_object_unref (enumerator);
+		}
+		g_object_unref (dir);
+	}
+
+	g_queue_foreach (dirs, (GFunc)g_object_unref, NULL);
+	g_queue_free (dirs);
+
+	publish_streamed_count (job, &counted, TRUE);
+
+	return NULL;
+}
+
+static void
+cancel_streamed_scan (GCancellable *job_cancellable, void *user_data)
+{
+	g_cancellable_cancel (G_CANCELLABLE (user_data));
+}
+
+static void
+start_streamed_scan (CopyMoveJob *job, SourceInfo *source_info)
+{
+	memset (source_info, 0, sizeof (SourceInfo));
+	source_info->op = OP_KIND_COPY;
+
+	/* Until the scan has counted something, at least the toplevel
+	 * items are known */
+	source_info->num_files = g_list_length (job->files);
+
+	g_mutex_init (&job->scan_lock);
+	job->scan_cancellable = g_cancellable_new ();
+	job->scan_cancelled_id = g_cancellable_connect (job->common.cancellable,
+							G_CALLBACK (cancel_streamed_scan),
+							job->scan_cancellable, NULL);
+	job->scan_thread = g_thread_new ("nautilus-copy-scan", stream_scan_thread_func, job);
+}
+
+static void
+finish_streamed_scan (CopyMoveJob *job)
+{
+	if (job->scan_thread == NULL) {
+		return;
+	}
+
+	/* The copy is over, its estimate is not needed any more */
+	g_cancellable_cancel (job->scan_cancellable);
+	g_thread_join (job->scan_thread);
+	job->scan_thread = NULL;
+	g_mutex_clear (&job->scan_lock);
+
+	g_cancellable_disconnect (job->common.cancellable, job->scan_cancelled_id);
+	g_object_unref (job->scan_cancellable);
+	job->scan_cancellable = NULL;
+}
+
+/* Folds what the scan has counted so far into @source_info. Never lets
+ * the estimate drop below what was already transferred.
+ */
+static _Bool
+update_streamed_source_info (CopyMoveJob *job,
+			     SourceInfo *source_info,
+			     TransferInfo *transfer_info)
+{
+	_Bool done;
+
+	g_mutex_lock (&job->scan_lock);
+	source_info->num_files = MAX (source_info->num_files, job->scanned.num_files);
+	source_info->num_bytes = MAX (source_info->num_bytes, job->scanned.num_bytes);
+	done = job->scan_done;
+	g_mutex_unlock (&job->scan_lock);
+
+	if (!done) {
+		source_info->num_files = MAX (source_info->num_files, transfer_info->num_files + 1);
+		source_info->num_bytes = MAX (source_info->num_bytes, transfer_info->num_bytes);
+	}
+
+	return done;
+}
+
 static void
 verify_destination (CommonJob *job,
                     GFile     *dest,
@@ -3097,6 +3282,38 @@ retry:
     g_object_unref (fsinfo);
 }
 
+/* In streaming mode the free space can only be checked once the scan
+ * is done, so that happens before the next file after it.
+ */
+static void
+check_streamed_free_space (CopyMoveJob *job,
+			   SourceInfo *source_info,
+			   TransferInfo *transfer_info)
+{
+	GFile *dest;
+
+	if (job->scan_thread == NULL || job->scan_checked ||
+	    !update_streamed_source_info (job, source_info, transfer_info)) {
+		return;
+	}
+
+	job->scan_checked = TRUE;
+
+	if (job->destination) {
+		dest = g_object_ref (job->destination);
+	} else {
+		dest = g_file_get_parent (job->files->data);
+	}
+
+	if (dest) {
+		verify_destination (&job->common,
+				    dest,
+				    NULL,
+				    source_info->num_bytes - transfer_info->num_bytes);
+		g_object_unref (dest);
+	}
+}
+
 static void
 report_copy_progress (CopyMoveJob *copy_job,
                       SourceInfo *source_info,
@@ -3122,6 +3339,10 @@ report_copy_progress (CopyMoveJob *copy_job,
 	}
 	transfer_info->last_report_time = now;
 
+	if (copy_job->scan_thread != NULL) {
+		update_streamed_source_info (copy_job, source_info, transfer_info);
+	}
+
 	files_left = source_info->num_files - transfer_info->num_files;
 
 	/* Races and whatnot could cause this to be negative... */
@@ -3547,6 +3768,14 @@ static void copy_move_file (CopyMoveJob *job,
 			    _Bool overwrite,
 			    _Bool *skipped_file,
 			    _Bool readonly_source_fs);
+static void copy_move_file_done (CopyMoveJob *copy_job,
+				 GFile *src,
+				 GFile *dest,
+				 GFile *dest_dir,
+				 SourceInfo *source_info,
+				 TransferInfo *transfer_info,
+				 GHashTable *debuting_files,
+				 GdkPoint *position);
 
 typedef enum {
 	CREATE_DEST_DIR_RETRY,
@@ -3653,6 +3882,407 @@ retry:
 	return CREATE_DEST_DIR_SUCCESS;
 }
 
+/* Largest chunk handed to the kernel at once, so progress is still
+ * reported and cancellation noticed on big files.
+ */
+#define LOCAL_COPY_CHUNK_SIZE (8 * 1024 * 1024)
+
+typedef enum {
+	LOCAL_COPY_DONE,
+	LOCAL_COPY_FAILED,
+	LOCAL_COPY_UNSUPPORTED
+} LocalCopyResult;
+
+static LocalCopyResult
+local_copy_clone (int src_fd, int dest_fd)
+{
+#ifdef FICLONE
+	if (ioctl (dest_fd, FICLONE, src_fd) == 0) {
+		return LOCAL_COPY_DONE;
+	}
+#endif
+	return LOCAL_COPY_UNSUPPORTED;
+}
+
+/* Copies with copy_file_range () and, where the kernel or file system
+ * refuses that, sendfile (). Only gives up with LOCAL_COPY_UNSUPPORTED
+ * before the first byte was written. Copies until the end of the file,
+ * @size only serves the progress: pseudo files report 0 and a file
+ * may grow while it is copied.
+ */
+static LocalCopyResult
+local_copy_data (int src_fd,
+		 int dest_fd,
+		 goffset size,
+		 GCancellable *cancellable,
+		 GFileProgressCallback progress_callback,
+		 void *progress_callback_data,
+		 GError **error)
+{
+	goffset copied;
+	ssize_t n;
+	_Bool use_copy_range;
+	int errsv;
+
+	copied = 0;
+#ifdef HAVE_COPY_FILE_RANGE
+	use_copy_range = TRUE;
+#else
+	use_copy_range = FALSE;
+#endif
+
+	while (TRUE) {
+		if (g_cancellable_set_error_if_cancelled (cancellable, error)) {
+			return LOCAL_COPY_FAILED;
+		}
+
+		n = -1;
+		errsv = ENOSYS;
+#ifdef HAVE_COPY_FILE_RANGE
+		if (use_copy_range) {
+			n = copy_file_range (src_fd, NULL, dest_fd, NULL, LOCAL_COPY_CHUNK_SIZE, 0);
+			errsv = errno;
+			/* Some kernels report an empty file for pseudo files,
+			 * let sendfile () tell */
+			if ((n < 0 && copied == 0 &&
+			     (errsv == ENOSYS || errsv == EXDEV ||
+			      errsv == EOPNOTSUPP || errsv == EINVAL)) ||
+			    (n == 0 && copied == 0)) {
+				use_copy_range = FALSE;
+				continue;
+			}
+		}
+#endif
+#ifdef HAVE_SYS_SENDFILE_H
+		if (!use_copy_range) {
+			n = sendfile (dest_fd, src_fd, NULL, LOCAL_COPY_CHUNK_SIZE);
+			errsv = errno;
+			if (n < 0 && copied == 0 &&
+			    (errsv == ENOSYS || errsv == EINVAL)) {
+				return LOCAL_COPY_UNSUPPORTED;
+			}
+		}
+#endif
+		if (n < 0 && errsv == EINTR) {
+			continue;
+		}
+		if (n < 0) {
+			if (copied == 0 && errsv == ENOSYS) {
+				return LOCAL_COPY_UNSUPPORTED;
+			}
+			g_set_error_literal (error, G_IO_ERROR,
+					     g_io_error_from_errno (errsv),
+					     g_strerror (errsv));
+			return LOCAL_COPY_FAILED;
+		}
+		if (n == 0) {
+			break;
+		}
+
+		copied += n;
+		if (progress_callback) {
+			progress_callback (copied, MAX (size, copied), progress_callback_data);
+		}
+	}
+
+	return LOCAL_COPY_DONE;
+}
+
+/* Fast path for plain local files: a reflink where the file system
+ * can share extents, otherwise an in-kernel copy. Returns FALSE when
+ * the copy should go through g_file_copy () instead, which is also
+ * left to produce the exact errors for existing targets.
+ */
+static _Bool
+try_local_copy (GFile *src,
+		GFile *dest,
+		GFileCopyFlags flags,
+		GCancellable *cancellable,
+		GFileProgressCallback progress_callback,
+		void *progress_callback_data,
+		_Bool *res,
+		GError **error)
+{
+	char *src_path, *dest_path;
+	struct stat statbuf;
+	LocalCopyResult result;
+	int src_fd, dest_fd;
+	int errsv;
+
+	if ((flags & (G_FILE_COPY_OVERWRITE | G_FILE_COPY_BACKUP)) != 0 ||
+	    !g_file_is_native (src) || !g_file_is_native (dest)) {
+		return FALSE;
+	}
+
+	src_path = g_file_get_path (src);
+	dest_path = g_file_get_path (dest);
+	src_fd = -1;
+	dest_fd = -1;
+	result = LOCAL_COPY_UNSUPPORTED;
+
+	if (src_path == NULL || dest_path == NULL) {
+		goto out;
+	}
+
+	src_fd = open (src_path, O_RDONLY | O_NOFOLLOW | O_CLOEXEC);
+	if (src_fd < 0 ||
+	    fstat (src_fd, &statbuf) != 0 ||
+	    !S_ISREG (statbuf.st_mode)) {
+		goto out;
+	}
+
+	dest_fd = open (dest_path, O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0666);
+	if (dest_fd < 0) {
+		goto out;
+	}
+
+	result = local_copy_clone (src_fd, dest_fd);
+	if (result == LOCAL_COPY_DONE) {
+		if (progress_callback) {
+			progress_callback (statbuf.st_size, statbuf.st_size,
+					   progress_callback_data);
+		}
+	} else {
+		result = local_copy_data (src_fd, dest_fd, statbuf.st_size,
+					  cancellable,
+					  progress_callback, progress_callback_data,
+					  error);
+	}
+
+	if (close (dest_fd) != 0 && result == LOCAL_COPY_DONE) {
+		errsv = errno;
+		g_set_error_literal (error, G_IO_ERROR,
+				     g_io_error_from_errno (errsv),
+				     g_strerror (errsv));
+		result = LOCAL_COPY_FAILED;
+	}
+	dest_fd = -1;
+
+	if (result == LOCAL_COPY_DONE) {
+		/* Same attributes g_file_copy () would have copied */
+		g_file_copy_attributes (src, dest, flags, cancellable, NULL);
+	} else {
+		/* Remove the partial copy, for UNSUPPORTED g_file_copy ()
+		 * starts over */
+		unlink (dest_path);
+	}
+
+ out:
+	if (src_fd >= 0) {
+		close (src_fd);
+	}
+	g_free (src_path);
+	g_free (dest_path);
+
+	if (result == LOCAL_COPY_UNSUPPORTED) {
+		return FALSE;
+	}
+
+	*res = result == LOCAL_COPY_DONE;
+	return TRUE;
+}
+
+/* Regular files up to this size are copied by the job's copy pool
+ * while the job thread keeps enumerating; larger ones are streamed by
+ * the job thread alone.
+ */
+#define SMALL_FILE_COPY_SIZE (1024 * 1024)
+#define MAX_COPY_WORKERS 4
+#define MAX_COPIES_IN_FLIGHT 64
+
+typedef struct {
+	int in_flight;
+	_Bool skipped_file;
+} DirectoryCopyState;
+
+typedef struct {
+	GFile *src;
+	GFile *dest;
+	GFile *dest_dir;
+	char **dest_fs_type;
+	goffset size;
+	_Bool same_fs;
+	_Bool readonly_source_fs;
+	DirectoryCopyState *state;
+	_Bool res;
+	GError *error;
+} SmallFileCopy;
+
+static int
+get_n_copy_workers (void)
+{
+	long n_cpus;
+
+	n_cpus = sysconf (_SC_NPROCESSORS_ONLN);
+
+	/* Small file copies mostly wait on the disk, so use at least two */
+	return CLAMP (n_cpus, 2, MAX_COPY_WORKERS);
+}
+
+/* Runs in the copy pool. Never asks anything, failures are handed
+ * back to the job thread which retries them with copy_move_file ().
+ */
+static void
+small_file_copy_func (void *data, void *user_data)
+{
+	SmallFileCopy *copy;
+	CopyMoveJob *copy_job;
+	GFileCopyFlags flags;
+
+	copy = data;
+	copy_job = user_data;
+
+	flags = G_FILE_COPY_NOFOLLOW_SYMLINKS;
+	if (copy->readonly_source_fs) {
+		flags |= G_FILE_COPY_TARGET_DEFAULT_PERMS;
+	}
+
+	if (!try_local_copy (copy->src, copy->dest, flags,
+			     copy_job->common.cancellable,
+			     NULL, NULL,
+			     &copy->res, &copy->error)) {
+		copy->res = g_file_copy (copy->src, copy->dest,
+					 flags,
+					 copy_job->common.cancellable,
+					 NULL, NULL,
+					 &copy->error);
+	}
+
+	g_async_queue_push (copy_job->copied_files, copy);
+}
+
+static void
+small_file_copy_free (SmallFileCopy *copy)
+{
+	g_object_unref (copy->src);
+	g_object_unref (copy->dest);
+	g_object_unref (copy->dest_dir);
+	if (copy->error != NULL) {
+		g_error_free (copy->error);
+	}
+	g_slice_free (SmallFileCopy, copy);
+}
+
+static void
+finish_small_file_copy (CopyMoveJob *copy_job,
+			SmallFileCopy *copy,
+			SourceInfo *source_info,
+			TransferInfo *transfer_info)
+{
+	CommonJob *job;
+
+	job = (CommonJob *)copy_job;
+
+	copy_job->n_copies_in_flight--;
+	copy->state->in_flight--;
+
+	if (copy->res) {
+		transfer_info->num_bytes += copy->size;
+		copy_move_file_done (copy_job, copy->src, copy->dest, copy->dest_dir,
+				     source_info, transfer_info, NULL, NULL);
+		small_file_copy_free (copy);
+		return;
+	}
+
+	/* The target is created exclusively, so unless it already existed
+	 * whatever is there now is a partial copy. Remove it before the
+	 * error is reported or the copy retried, as try_local_copy ()
+	 * does for its own.
+	 */
+	if (!IS_IO_ERROR (copy->error, EXISTS)) {
+		g_file_delete (copy->dest, NULL, NULL);
+	}
+
+	if (job_aborted (job) || IS_IO_ERROR (copy->error, CANCELLED)) {
+		copy->state->skipped_file = TRUE;
+	}
+	else {
+		/* Conflicts, invalid names and errors take the normal
+		 * path, so dialogs and the "all" answers still apply */
+		copy_move_file (copy_job, copy->src, copy->dest_dir,
+				copy->same_fs, FALSE, copy->dest_fs_type,
+				source_info, transfer_info, NULL, NULL, FALSE,
+				&copy->state->skipped_file,
+				copy->readonly_source_fs);
+	}
+
+	small_file_copy_free (copy);
+}
+
+/* Handles finished copies until at most @limit are left in @counter,
+ * pass a negative @limit to only take what is already done.
+ */
+static void
+process_copied_files (CopyMoveJob *copy_job,
+		      int *counter,
+		      int limit,
+		      SourceInfo *source_info,
+		      TransferInfo *transfer_info)
+{
+	SmallFileCopy *copy;
+
+	if (limit < 0) {
+		while ((copy = g_async_queue_try_pop (copy_job->copied_files)) != NULL) {
+			finish_small_file_copy (copy_job, copy, source_info, transfer_info);
+		}
+		return;
+	}
+
+	while (*counter > limit) {
+		copy = g_async_queue_pop (copy_job->copied_files);
+		finish_small_file_copy (copy_job, copy, source_info, transfer_info);
+	}
+}
+
+/* Returns FALSE if @src has to be copied by the job thread */
+static _Bool
+queue_small_file_copy (CopyMoveJob *copy_job,
+		       GFile *src,
+		       GFile *dest_dir,
+		       _Bool same_fs,
+		       char **dest_fs_type,
+		       goffset size,
+		       _Bool readonly_source_fs,
+		       DirectoryCopyState *state,
+		       SourceInfo *source_info,
+		       TransferInfo *transfer_info)
+{
+	SmallFileCopy *copy;
+	GFile *dest;
+
+	if (should_skip_file ((CommonJob *)copy_job, src)) {
+		state->skipped_file = TRUE;
+		return TRUE;
+	}
+
+	dest = get_target_file (src, dest_dir, *dest_fs_type, same_fs);
+	if (g_file_equal (src, dest)) {
+		g_object_unref (dest);
+		return FALSE;
+	}
+
+	process_copied_files (copy_job, &copy_job->n_copies_in_flight,
+			      MAX_COPIES_IN_FLIGHT - 1,
+			      source_info, transfer_info);
+
+	copy = g_slice_new0 (SmallFileCopy);
+	copy->src = g_object_ref (src);
+	copy->dest = dest;
+	copy->dest_dir = g_object_ref (dest_dir);
+	copy->dest_fs_type = dest_fs_type;
+	copy->size = size;
+	copy->same_fs = same_fs;
+	copy->readonly_source_fs = readonly_source_fs;
+	copy->state = state;
+
+	copy_job->n_copies_in_flight++;
+	state->in_flight++;
+
+	g_thread_pool_push (copy_job->copy_pool, copy, NULL);
+
+	return TRUE;
+}
+
 /* a return value of FALSE means retry, i.e.
  * the destination has changed and the source
  * is expected to re-try the preceeding
@@ -3683,6 +4313,8 @@ copy_move_directory (CopyMoveJob *copy_job,
 	_Bool local_skipped_file;
 	CommonJob *job;
 	GFileCopyFlags flags;
+	DirectoryCopyState state;
+	_Bool queued;
 
 	job = (CommonJob *)copy_job;
 
@@ -3712,12 +4344,16 @@ copy_move_directory (CopyMoveJob *copy_job,
 
 	local_skipped_file = FALSE;
 	dest_fs_type = NULL;
+	state.in_flight = 0;
+	state.skipped_file = FALSE;
 
 	skip_error = should_skip_readdir_error (job, src);
  retry:
 	error = NULL;
 	enumerator = g_file_enumerate_children (src,
-						G_FILE_ATTRIBUTE_STANDARD_NAME,
+						G_FILE_ATTRIBUTE_STANDARD_NAME ","
+						G_FILE_ATTRIBUTE_STANDARD_TYPE ","
+						G_FILE_ATTRIBUTE_STANDARD_SIZE,
 						G_FILE_QUERY_INFO_NOFOLLOW_SYMLINKS,
 						job->cancellable,
 						&error);
@@ -3728,15 +4364,52 @@ copy_move_directory (CopyMoveJob *copy_job,
 		       (info = g_file_enumerator_next_file (enumerator, job->cancellable, skip_error?NULL:&error)) != NULL) {
 			src_file = g_file_get_child (src,
 						     g_file_info_get_name (info));
-			copy_move_file (copy_job, src_file, *dest, same_fs, FALSE, &dest_fs_type,
-					source_info, transfer_info, NULL, NULL, FALSE, &local_skipped_file,
-					readonly_source_fs);
+
+			check_streamed_free_space (copy_job, source_info, transfer_info);
+
+			queued = FALSE;
+			if (!job_aborted (job) &&
+			    copy_job->copy_pool != NULL &&
+			    g_file_info_get_file_type (info) == G_FILE_TYPE_REGULAR) {
+				if (g_file_info_get_size (info) <= SMALL_FILE_COPY_SIZE) {
+					queued = queue_small_file_copy (copy_job, src_file, *dest, same_fs,
+									&dest_fs_type,
+									g_file_info_get_size (info),
+									readonly_source_fs, &state,
+									source_info, transfer_info);
+				} else {
+					/* Let the pool go quiet so large files stream alone */
+					process_copied_files (copy_job, &copy_job->n_copies_in_flight, 0,
+							      source_info, transfer_info);
+				}
+			}
+
+			if (!queued) {
+				copy_move_file (copy_job, src_file, *dest, same_fs, FALSE, &dest_fs_type,
+						source_info, transfer_info, NULL, NULL, FALSE, &local_skipped_file,
+						readonly_source_fs);
+			}
+
+			if (copy_job->copy_pool != NULL) {
+				process_copied_files (copy_job, NULL, -1,
+						      source_info, transfer_info);
+			}
 			g_object_unref (src_file);
 			g_object_unref (info);
 		}
 		g_file_enumerator_close (enumerator, job->cancellable, NULL);
 		g_object_unref (enumerator);
 
+		/* Everything in this folder has to be in place before its
+		 * attributes are copied and a moved source is removed */
+		if (copy_job->copy_pool != NULL) {
+			process_copied_files (copy_job, &state.in_flight, 0,
+					      source_info, transfer_info);
+		}
+		if (state.skipped_file) {
+			local_skipped_file = TRUE;
+		}
+
 		if (IS_IO_ERROR (error, CANCELLED)) {
 			g_error_free (error);
 		}
@@ -4260,6 +4933,56 @@ get_target_file_for_display_name (GFile *dir,
 	return dest;
 }
 
+/* Bookkeeping for a file that was copied or moved successfully */
+static void
+copy_move_file_done (CopyMoveJob *copy_job,
+		     GFile *src,
+		     GFile *dest,
+		     GFile *dest_dir,
+		     SourceInfo *source_info,
+		     TransferInfo *transfer_info,
+		     GHashTable *debuting_files,
+		     GdkPoint *position)
+{
+	CommonJob *job;
+
+	job = (CommonJob *)copy_job;
+
+	transfer_info->num_files ++;
+	report_copy_progress (copy_job, source_info, transfer_info);
+
+	if (debuting_files) {
+		if (position) {
+			nautilus_file_changes_queue_schedule_position_set (dest, *position, job->screen_num);
+		} else {
+			nautilus_file_changes_queue_schedule_position_remove (dest);
+		}
+
+		g_hash_table_replace (debuting_files, g_object_ref (dest), GINT_TO_POINTER (TRUE));
+	}
+	if (copy_job->is_move) {
+		nautilus_file_changes_queue_file_moved (src, dest);
+	} else {
+		nautilus_file_changes_queue_file_added (dest);
+	}
+
+	/* If copying a trusted desktop file to the desktop,
+	   mark it as trusted. */
+	if (copy_job->desktop_location != NULL &&
+	    g_file_equal (copy_job->desktop_location, dest_dir) &&
+	    is_trusted_desktop_file (src, job->cancellable)) {
+		mark_desktop_file_trusted (job,
+					   job->cancellable,
+					   dest,
+					   FALSE);
+	}
+
+	if (job->undo_info != NULL) {
+		nautilus_file_undo_info_ext_add_origin_target_pair (NAUTILUS_FILE_UNDO_INFO_EXT (job->undo_info),
+								    src, dest);
+	}
+}
+
 /* Debuting files is non-NULL only for toplevel items */
 static void
 copy_move_file (CopyMoveJob *copy_job,
@@ -4295,6 +5018,12 @@ copy_move_file (CopyMoveJob *copy_job,
 		return;
 	}
 
+	check_streamed_free_space (copy_job, source_info, transfer_info);
+	if (job_aborted (job)) {
+		*skipped_file = TRUE;
+		return;
+	}
+
 	unique_name_nr = 1;
 
 	/* another file in the same directory might have handled the invalid
@@ -4408,7 +5137,12 @@ copy_move_file (CopyMoveJob *copy_job,
 				   copy_file_progress_callback,
 				   &pdata,
 				   &error);
-	} else {
+	} else if (!try_local_copy (src, dest,
+				    flags,
+				    job->cancellable,
+				    copy_file_progress_callback,
+				    &pdata,
+				    &res, &error)) {
 		res = g_file_copy (src, dest,
 				   flags,
 				   job->cancellable,
@@ -4418,40 +5152,9 @@ copy_move_file (CopyMoveJob *copy_job,
 	}
 
 	if (res) {
-		transfer_info->num_files ++;
-		report_copy_progress (copy_job, source_info, transfer_info);
-
-		if (debuting_files) {
-			if (position) {
-				nautilus_file_changes_queue_schedule_position_set (dest, *position, job->screen_num);
-			} else {
-				nautilus_file_changes_queue_schedule_position_remove (dest);
-			}
-
-			g_hash_table_replace (debuting_files, g_object_ref (dest), GINT_TO_POINTER (TRUE));
-		}
-		if (copy_job->is_move) {
-			nautilus_file_changes_queue_file_moved (src, dest);
-		} else {
-			nautilus_file_changes_queue_file_added (dest);
-		}
-
-		/* If copying a trusted desktop file to the desktop,
-		   mark it as trusted. */
-		if (copy_job->desktop_location != NULL &&
-		    g_file_equal (copy_job->desktop_location, dest_dir) &&
-		    is_trusted_desktop_file (src, job->cancellable)) {
-			mark_desktop_file_trusted (job,
-						   job->cancellable,
-						   dest,
-						   FALSE);
-		}
-
-		if (job->undo_info != NULL) {
-			nautilus_file_undo_info_ext_add_origin_target_pair (NAUTILUS_FILE_UNDO_INFO_EXT (job->undo_info),
-									    src, dest);
-		}
-
+		copy_move_file_done (copy_job, src, dest, dest_dir,
+				     source_info, transfer_info,
+				     debuting_files, position);
 		g_object_unref (dest);
 		return;
 	}
@@ -4815,7 +5518,9 @@ copy_job (GIOSchedulerJob *io_job, GCancellable *cancellable, void *user_data)
 
     nautilus_progress_info_start (job->common.progress);
 
-    scan_sources (job->files, &source_info, common, OP_KIND_COPY);
+    /* Start copying right away and count the sources meanwhile, the
+     * free space is checked once the count is complete */
+    start_streamed_scan (job, &source_info);
 
     if (!job_aborted (common)) {
 
@@ -4839,12 +5544,30 @@ copy_job (GIOSchedulerJob *io_job, GCancellable *cancellable, void *user_data)
             g_timer_start (job->common.time);
 
             memset (&transfer_info, 0, sizeof (transfer_info));
+
+            /* A custom target name only applies to the toplevel file */
+            if (job->target_name == NULL) {
+                job->copied_files = g_async_queue_new ();
+                job->copy_pool = g_thread_pool_new (small_file_copy_func, job,
+                                                    get_n_copy_workers (),
+                                                    FALSE, NULL);
+            }
+
             copy_files (job,
                         dest_fs_id,
                         &source_info, &transfer_info);
+
+            if (job->copy_pool != NULL) {
+                g_thread_pool_free (job->copy_pool, FALSE, TRUE);
+                g_async_queue_unref (job->copied_files);
+                job->copy_pool = NULL;
+                job->copied_files = NULL;
+            }
         }
     }
 
+    finish_streamed_scan (job);
+
     g_free (dest_fs_id);
 
     g_io_scheduler_job_send_to_mainloop_async (io_job,
@@ -4854,6 +5577,35 @@ copy_job (GIOSchedulerJob *io_job, GCancellable *cancellable, void *user_data)
     return FALSE;
 }
 
+/* Jobs only wait in the queue for jobs on the same file systems */
+static void
+queue_copy_move_job (CopyMoveJob *job, GIOSchedulerJobFunc job_func)
+{
+	NautilusJobQueue *job_queue;
+	GList *locations, *l;
+	GFile *parent;
+
+	/* The sources are placed by the folders holding them, which most
+	 * selections share; the destination is a folder already.
+	 */
+	locations = g_list_prepend (NULL, g_object_ref (job->destination));
+	for (l = job->files; l != NULL; l = l->next) {
+		parent = g_file_get_parent (l->data);
+		if (parent == NULL) {
+			parent = g_object_ref (l->data);
+		}
+		locations = g_list_prepend (locations, parent);
+	}
+
+	job_queue = nautilus_job_queue_get ();
+	nautilus_job_queue_add_new_job_for_files (job_queue, job_func, job,
+						  job->common.cancellable,
+						  job->common.progress,
+						  locations, FALSE);
+
+	g_list_free_full (locations, g_object_unref);
+}
+
 void
 nautilus_file_operations_copy_file (GFile *source_file,
 				    GFile *target_dir,
@@ -4929,11 +5681,7 @@ nautilus_file_operations_copy (GList *files,
 		g_object_unref (src_dir);
 	}
 
-	g_io_scheduler_push_job (copy_job,
-			   job,
-			   NULL, /* destroy notify */
-			   0,
-			   job->common.cancellable);
+	queue_copy_move_job (job, copy_job);
 }
 
 static void
@@ -5477,11 +6225,7 @@ nautilus_file_operations_move (GList *files,
 		g_object_unref (src_dir);
 	}
 
-	g_io_scheduler_push_job (move_job,
-				 job,
-				 NULL, /* destroy notify */
-				 0,
-				 job->common.cancellable);
+	queue_copy_move_job (job, move_job);
 }
 
 static void
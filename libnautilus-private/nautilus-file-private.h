@@ -52,6 +52,36 @@ typedef enum {
 	UNKNOWN
 } Knowledge;
 
+/* The fields of a file that only a few files ever use. Keeping them
+ * out of NautilusFileDetails saves their space in every other file,
+ * which adds up in directories with many files.
+ */
+typedef struct {
+	char *top_left_text;
+
+	char *trash_orig_path;
+
+	/* File operations in progress */
+	GList *operations_in_progress;
+
+	/* Emblems provided by extensions */
+	GList *extension_emblems;
+	GList *pending_extension_emblems;
+
+	/* Attributes provided by extensions */
+	GHashTable *extension_attributes;
+	GHashTable *pending_extension_attributes;
+
+	unsigned int deep_directory_count;
+	unsigned int deep_file_count;
+	unsigned int deep_unreadable_count;
+	unsigned int deep_hidden_count;
+	goffset deep_size;
+
+	guint64 free_space; /* (guint)-1 for unknown */
+	time_t free_space_read; /* The time free_space was updated, or 0 for never */
+} NautilusFileRareDetails;
+
 struct NautilusFileDetails
 {
 	NautilusDirectory *directory;
@@ -92,12 +122,6 @@ struct NautilusFileDetails
 
         unsigned int directory_count;
 
-        unsigned int deep_directory_count;
-        unsigned int deep_file_count;
-        unsigned int deep_unreadable_count;
-        unsigned int deep_hidden_count;
-        goffset deep_size;
-
 	GIcon          *icon;
 
 	char           *thumbnail_path;
@@ -107,7 +131,6 @@ struct NautilusFileDetails
         unsigned int    thumbnail_try_count;
 
 	GList *mime_list; /* If this is a directory, the list of MIME types in it. */
-	char  *top_left_text;
 
 	/* Info you might get from a link (.desktop, .directory or nautilus link) */
 	GIcon *custom_icon;
@@ -118,36 +141,28 @@ struct NautilusFileDetails
 	 */
 	eel_ref_str filesystem_id;
 
-	char *trash_orig_path;
-
-	/* The following is for file operations in progress. Since
-	 * there are normally only a few of these, we can move them to
-	 * a separate hash table or something if required to keep the
-	 * file objects small.
-	 */
-	GList *operations_in_progress;
-
 	/* NautilusInfoProviders that need to be run for this file */
 	GList *pending_info_providers;
 
-	/* Emblems provided by extensions */
-	GList *extension_emblems;
-	GList *pending_extension_emblems;
-
-	/* Attributes provided by extensions */
-	GHashTable *extension_attributes;
-	GHashTable *pending_extension_attributes;
+	/* Fields most files never set, NULL until one of them is */
+	NautilusFileRareDetails *rare;
 
 	GHashTable *metadata;
 
 	/* Mount for mountpoint or the references GMount for a "mountable" */
 	GMount *mount;
 
+	/* The attributes it lacks, as a Request, counted in its directory
+	 * while it is in the file list.
+	 */
+	unsigned short missing_request;
+
 	/* boolean fields: bitfield to save space, since there can be
            many NautilusFile objects. */
 
 	eel_boolean_bit unconfirmed                   : 1;
 	eel_boolean_bit is_gone                       : 1;
+	eel_boolean_bit in_file_list                  : 1;
 	/* Set when emitting files_added on the directory to make sure we
 	   add a file, and only once */
 	eel_boolean_bit is_added                      : 1;
@@ -190,6 +205,10 @@ struct NautilusFileDetails
 
 	eel_boolean_bit is_thumbnailing               : 1;
 
+	/* TRUE if work that only shows on screen was dropped from the
+	 * work queues when the file went off screen */
+	eel_boolean_bit work_deferred                 : 1;
+
 	/* TRUE if the file is open in a spatial window */
 	eel_boolean_bit has_open_window               : 1;
 
@@ -223,9 +242,6 @@ struct NautilusFileDetails
 	eel_boolean_bit filesystem_info_is_up_to_date : 1;
 
 	time_t trash_time; /* 0 is unknown */
-
-	guint64 free_space; /* (guint)-1 for unknown */
-	time_t free_space_read; /* The time free_space was updated, or 0 for never */
 };
 
 typedef struct {
@@ -276,6 +292,13 @@ _Bool         nautilus_file_set_display_name               (NautilusFile
                                                             _Bool                   custom);
 void          nautilus_file_set_mount                      (NautilusFile           *file,
                                                             GMount                 *mount);
+void          nautilus_file_prepare_info                   (GFileInfo              *info);
+
+/* Reading the rare details never allocates them, files without
+ * any share a set of defaults. Get them for writing.
+ */
+const NautilusFileRareDetails *nautilus_file_peek_rare_details (NautilusFile *file);
+NautilusFileRareDetails       *nautilus_file_get_rare_details  (NautilusFile *file);
 
 /* Return true if the top lefts of files in this directory should be
  * fetched, according to the preference settings.
@@ -33,19 +33,29 @@
 
 #include "nautilus-file-queue.h"
 
+/* The files are kept in order in a ring buffer. Removing a file from
+ * the middle leaves a hole, which the ends skip and the next growth
+ * squeezes out, so no operation allocates per file.
+ */
 struct NautilusFileQueue {
-	GList *head;
-	GList *tail;
-	GHashTable *item_to_link_map;
+	NautilusFile **files;   /* NULL where a file was removed */
+	unsigned int size;      /* a power of two, or 0 */
+	unsigned int head;      /* slot of the first file */
+	unsigned int length;    /* slots from the head to the tail, holes included */
+	GHashTable *item_to_slot_map; /* file -> slot + 1 */
 };
 
+#define INITIAL_SIZE 16
+
+#define SLOT(queue, position) (((queue)->head + (position)) & ((queue)->size - 1))
+
 NautilusFileQueue *
 nautilus_file_queue_new (void)
 {
 	NautilusFileQueue *queue;
 
 	queue = g_new0 (NautilusFileQueue, 1);
-	queue->item_to_link_map = g_hash_table_new (g_direct_hash, g_direct_equal);
+	queue->item_to_slot_map = g_hash_table_new (g_direct_hash, g_direct_equal);
 
 	return queue;
 }
@@ -53,30 +63,114 @@ nautilus_file_queue_new (void)
 void
 nautilus_file_queue_destroy (NautilusFileQueue *queue)
 {
-	g_hash_table_destroy (queue->item_to_link_map);
-	nautilus_file_list_free (queue->head);
+	unsigned int i;
+	NautilusFile *file;
+
+	for (i = 0; i < queue->length; i++) {
+		file = queue->files[SLOT (queue, i)];
+		if (file != NULL) {
+			nautilus_file_unref (file);
+		}
+	}
+
+	g_hash_table_destroy (queue->item_to_slot_map);
+	g_free (queue->files);
 	g_free (queue);
 }
 
+static _Bool
+lookup_slot (NautilusFileQueue *queue,
+	     NautilusFile      *file,
+	     unsigned int      *slot)
+{
+	void *value;
+
+	value = g_hash_table_lookup (queue->item_to_slot_map, file);
+	if (value == NULL) {
+		return FALSE;
+	}
+
+	*slot = GPOINTER_TO_UINT (value) - 1;
+	return TRUE;
+}
+
+static void
+set_slot (NautilusFileQueue *queue,
+	  unsigned int       slot,
+	  NautilusFile      *file)
+{
+	queue->files[slot] = file;
+	g_hash_table_insert (queue->item_to_slot_map, file, GUINT_TO_POINTER (slot + 1));
+}
+
+/* Makes room for one more file, dropping the holes on the way */
+static void
+reserve_slot (NautilusFileQueue *queue)
+{
+	NautilusFile **old_files;
+	NautilusFile *file;
+	unsigned int old_size, old_head, old_length;
+	unsigned int n_files, i;
+
+	if (queue->length < queue->size) {
+		return;
+	}
+
+	old_files = queue->files;
+	old_size = queue->size;
+	old_head = queue->head;
+	old_length = queue->length;
+
+	n_files = g_hash_table_size (queue->item_to_slot_map);
+	if (old_size == 0) {
+		queue->size = INITIAL_SIZE;
+	} else if (n_files >= old_size / 2) {
+		queue->size = old_size * 2;
+	}
+
+	queue->files = g_new (NautilusFile *, queue->size);
+	queue->head = 0;
+	queue->length = 0;
+
+	for (i = 0; i < old_length; i++) {
+		file = old_files[(old_head + i) & (old_size - 1)];
+		if (file != NULL) {
+			set_slot (queue, queue->length++, file);
+		}
+	}
+
+	g_free (old_files);
+}
+
+/* Keeps a file in the head and tail slots */
+static void
+trim (NautilusFileQueue *queue)
+{
+	while (queue->length > 0 && queue->files[queue->head] == NULL) {
+		queue->head = SLOT (queue, 1);
+		queue->length--;
+	}
+	while (queue->length > 0 && queue->files[SLOT (queue, queue->length - 1)] == NULL) {
+		queue->length--;
+	}
+}
+
 void
 nautilus_file_queue_enqueue (NautilusFileQueue *queue,
 			     NautilusFile      *file)
 {
-	if (g_hash_table_lookup (queue->item_to_link_map, file) != NULL) {
+	unsigned int slot;
+
+	if (lookup_slot (queue, file, &slot)) {
 		/* It's already on the queue. */
 		return;
 	}
 
-	if (queue->tail == NULL) {
-		queue->head = g_list_append (NULL, file);
-		queue->tail = queue->head;
-	} else {
-		queue->tail = g_list_append (queue->tail, file);
-		queue->tail = queue->tail->next;
-	}
+	reserve_slot (queue);
+	set_slot (queue, SLOT (queue, queue->length), file);
+	queue->length++;
 
 	nautilus_file_ref (file);
-	g_hash_table_insert (queue->item_to_link_map, file, queue->tail);
 }
 
 NautilusFile *
@@ -95,39 +189,83 @@ void
 nautilus_file_queue_remove (NautilusFileQueue *queue,
 			    NautilusFile *file)
 {
-	GList *link;
-
-	link = g_hash_table_lookup (queue->item_to_link_map, file);
+	unsigned int slot;
 
-	if (link == NULL) {
+	if (!lookup_slot (queue, file, &slot)) {
 		/* It's not on the queue */
 		return;
 	}
 
-	if (link == queue->tail) {
-		/* Need to special-case removing the tail. */
-		queue->tail = queue->tail->prev;
+	queue->files[slot] = NULL;
+	g_hash_table_remove (queue->item_to_slot_map, file);
+	trim (queue);
+
+	nautilus_file_unref (file);
+}
+
+_Bool
+nautilus_file_queue_move_to_head (NautilusFileQueue *queue,
+				  NautilusFile      *file)
+{
+	unsigned int slot;
+
+	if (!lookup_slot (queue, file, &slot)) {
+		return FALSE;
 	}
 
-	queue->head =  g_list_remove_link (queue->head, link);
-	g_list_free (link);
-	g_hash_table_remove (queue->item_to_link_map, file);
+	if (slot != queue->head) {
+		queue->files[slot] = NULL;
+		trim (queue);
 
-	nautilus_file_unref (file);
+		reserve_slot (queue);
+		queue->head = SLOT (queue, queue->size - 1);
+		queue->length++;
+		set_slot (queue, queue->head, file);
+	}
+
+	return TRUE;
 }
 
 NautilusFile *
 nautilus_file_queue_head (NautilusFileQueue *queue)
 {
-	if (queue->head == NULL) {
+	if (queue->length == 0) {
 		return NULL;
 	}
 
-	return NAUTILUS_FILE (queue->head->data);
+	return queue->files[queue->head];
+}
+
+NautilusFile *
+nautilus_file_queue_next (NautilusFileQueue *queue,
+			  NautilusFile      *file)
+{
+	NautilusFile *next;
+	unsigned int slot, i;
+
+	if (!lookup_slot (queue, file, &slot)) {
+		return NULL;
+	}
+
+	for (i = ((slot - queue->head) & (queue->size - 1)) + 1; i < queue->length; i++) {
+		next = queue->files[SLOT (queue, i)];
+		if (next != NULL) {
+			return next;
+		}
+	}
+
+	return NULL;
+}
+
+_Bool
+nautilus_file_queue_contains (NautilusFileQueue *queue,
+			      NautilusFile      *file)
+{
+	return g_hash_table_contains (queue->item_to_slot_map, file);
 }
 
 _Bool
 nautilus_file_queue_is_empty (NautilusFileQueue *queue)
 {
-	return (queue->head == NULL);
+	return (queue->length == 0);
 }
@@ -42,9 +42,23 @@ NautilusFile *     nautilus_file_queue_dequeue  (NautilusFileQueue *queue);
 void               nautilus_file_queue_remove   (NautilusFileQueue *queue,
 						 NautilusFile      *file);
 
+/* Move a file that is in the queue to its head. Returns FALSE if the
+ * file is not in the queue.
+ */
+_Bool              nautilus_file_queue_move_to_head (NautilusFileQueue *queue,
+						     NautilusFile      *file);
+
 /* Get the file at the head of the queue without removing or unrefing it. */
 NautilusFile *     nautilus_file_queue_head     (NautilusFileQueue *queue);
 
-_Bool           nautilus_file_queue_is_empty (NautilusFileQueue *queue);
+/* Get the file after @file in the queue, or NULL if @file is the tail
+ * or not in the queue.
+ */
+NautilusFile *     nautilus_file_queue_next     (NautilusFileQueue *queue,
+						 NautilusFile      *file);
+
+_Bool              nautilus_file_queue_contains (NautilusFileQueue *queue,
+						 NautilusFile      *file);
+_Bool              nautilus_file_queue_is_empty (NautilusFileQueue *queue);
 
 #endif /* NAUTILUS_FILE_CHANGES_QUEUE_H */
@@ -211,11 +211,37 @@ nautilus_file_constructor (unsigned int type,
   return object;
 }
 
-_Bool
-nautilus_file_set_display_name (NautilusFile *file,
-                                const char   *display_name,
-                                const char   *edit_name,
-                                _Bool         custom)
+/* Set by nautilus_file_prepare_info (), GIO keeps "nautilus::"
+ * attributes on the info without knowing them.
+ */
+#define COLLATION_KEY_ATTRIBUTE "nautilus::display-name-collation-key"
+
+/* Does the work on @info that needs no NautilusFile, so directory
+ * loading can do it in the enumerating thread. May be called from
+ * any thread, as long as nothing else uses @info at the same time.
+ */
+void
+nautilus_file_prepare_info (GFileInfo *info)
+{
+	const char *display_name;
+	char *collation_key;
+
+	display_name = g_file_info_get_display_name (info);
+	if (display_name == NULL || *display_name == 0) {
+		return;
+	}
+
+	collation_key = g_utf8_collate_key_for_filename (display_name, -1);
+	g_file_info_set_attribute_string (info, COLLATION_KEY_ATTRIBUTE, collation_key);
+	g_free (collation_key);
+}
+
+static _Bool
+set_display_name_internal (NautilusFile *file,
+			   const char   *display_name,
+			   const char   *edit_name,
+			   _Bool         custom,
+			   const char   *collation_key)
 {
 	_Bool changed;
 
@@ -256,7 +282,11 @@ nautilus_file_set_display_name (NautilusFile *file,
 		}
 
 		g_free (file->details->display_name_collation_key);
-		file->details->display_name_collation_key = g_utf8_collate_key_for_filename (display_name, -1);
+		if (collation_key != NULL) {
+			file->details->display_name_collation_key = g_strdup (collation_key);
+		} else {
+			file->details->display_name_collation_key = g_utf8_collate_key_for_filename (display_name, -1);
+		}
 	}
 
 	if (g_strcmp0 (eel_ref_str_peek (file->details->edit_name), edit_name) != 0) {
@@ -274,6 +304,15 @@ nautilus_file_set_display_name (NautilusFile *file,
 	return changed;
 }
 
+_Bool
+nautilus_file_set_display_name (NautilusFile *file,
+                                const char   *display_name,
+                                const char   *edit_name,
+                                _Bool         custom)
+{
+	return set_display_name_internal (file, display_name, edit_name, custom, NULL);
+}
+
 static void
 nautilus_file_clear_display_name (NautilusFile *file)
 {
@@ -508,6 +547,8 @@ nautilus_file_clear_info (NautilusFile *file)
 	file->details->filesystem_id = NULL;
 
 	clear_metadata (file);
+
+	nautilus_directory_update_missing_counts (file->details->directory, file);
 }
 
 static NautilusFile *
@@ -805,6 +846,53 @@ nautilus_file_is_self_owned (NautilusFile *file)
 	return file->details->directory->details->as_file == file;
 }
 
+static const NautilusFileRareDetails default_rare_details = {
+  .free_space = (guint64) -1,
+};
+
+const NautilusFileRareDetails *
+nautilus_file_peek_rare_details (NautilusFile *file)
+{
+  if (file->details->rare == NULL) {
+    return &default_rare_details;
+  }
+  return file->details->rare;
+}
+
+NautilusFileRareDetails *
+nautilus_file_get_rare_details (NautilusFile *file)
+{
+  if (file->details->rare == NULL) {
+    file->details->rare = g_slice_new0 (NautilusFileRareDetails);
+    file->details->rare->free_space = (guint64) -1;
+  }
+  return file->details->rare;
+}
+
+static void
+rare_details_free (NautilusFileRareDetails *rare)
+{
+  if (rare == NULL) {
+    return;
+  }
+
+  g_free (rare->top_left_text);
+  g_free (rare->trash_orig_path);
+
+  g_list_free_full (rare->pending_extension_emblems, g_free);
+  g_list_free_full (rare->extension_emblems, g_free);
+
+  if (rare->pending_extension_attributes) {
+    g_hash_table_destroy (rare->pending_extension_attributes);
+  }
+
+  if (rare->extension_attributes) {
+    g_hash_table_destroy (rare->extension_attributes);
+  }
+
+  g_slice_free (NautilusFileRareDetails, rare);
+}
+
 static void
 finalize (GObject *object)
 {
@@ -814,7 +902,7 @@ finalize (GObject *object)
 
   file = NAUTILUS_FILE (object);
 
-  g_assert (file->details->operations_in_progress == NULL);
+  g_assert (nautilus_file_peek_rare_details (file)->operations_in_progress == NULL);
 
   if (file->details->is_thumbnailing) {
     uri = nautilus_file_get_uri (file);
@@ -858,7 +946,6 @@ finalize (GObject *object)
   eel_ref_str_unref (file->details->group);
   g_free (file->details->selinux_context);
   g_free (file->details->description);
-  g_free (file->details->top_left_text);
   g_free (file->details->activation_uri);
   g_clear_object (&file->details->custom_icon);
 
@@ -871,20 +958,11 @@ finalize (GObject *object)
   }
 
   eel_ref_str_unref (file->details->filesystem_id);
-  g_free (file->details->trash_orig_path);
 
   g_list_free_full (file->details->mime_list, g_free);
-  g_list_free_full (file->details->pending_extension_emblems, g_free);
-  g_list_free_full (file->details->extension_emblems, g_free);
   g_list_free_full (file->details->pending_info_providers, g_object_unref);
 
-  if (file->details->pending_extension_attributes) {
-    g_hash_table_destroy (file->details->pending_extension_attributes);
-  }
-
-  if (file->details->extension_attributes) {
-    g_hash_table_destroy (file->details->extension_attributes);
-  }
+  rare_details_free (file->details->rare);
 
   if (file->details->metadata) {
     metadata_hash_free (file->details->metadata);
@@ -1806,6 +1884,7 @@ nautilus_file_operation_new (NautilusFile *file,
 			     void * callback_data)
 {
 	NautilusFileOperation *op;
+	NautilusFileRareDetails *rare;
 
 	op = g_new0 (NautilusFileOperation, 1);
 	op->file = nautilus_file_ref (file);
@@ -1813,8 +1892,9 @@ nautilus_file_operation_new (NautilusFile *file,
 	op->callback_data = callback_data;
 	op->cancellable = g_cancellable_new ();
 
-	op->file->details->operations_in_progress = g_list_prepend
-		(op->file->details->operations_in_progress, op);
+	rare = nautilus_file_get_rare_details (op->file);
+	rare->operations_in_progress = g_list_prepend
+		(rare->operations_in_progress, op);
 
 	return op;
 }
@@ -1822,8 +1902,11 @@ nautilus_file_operation_new (NautilusFile *file,
 static void
 nautilus_file_operation_remove (NautilusFileOperation *op)
 {
-	op->file->details->operations_in_progress = g_list_remove
-		(op->file->details->operations_in_progress, op);
+	NautilusFileRareDetails *rare;
+
+	rare = nautilus_file_get_rare_details (op->file);
+	rare->operations_in_progress = g_list_remove
+		(rare->operations_in_progress, op);
 }
 
 void
@@ -2145,7 +2228,7 @@ nautilus_file_rename_in_progress (NautilusFile *file)
 	GList *node;
 	NautilusFileOperation *op;
 
-	for (node = file->details->operations_in_progress; node != NULL; node = node->next) {
+	for (node = nautilus_file_peek_rare_details (file)->operations_in_progress; node != NULL; node = node->next) {
 		op = node->data;
 		if (op->is_rename) {
 			return TRUE;
@@ -2162,7 +2245,7 @@ nautilus_file_cancel (NautilusFile *file,
 	GList *node, *next;
 	NautilusFileOperation *op;
 
-	for (node = file->details->operations_in_progress; node != NULL; node = next) {
+	for (node = nautilus_file_peek_rare_details (file)->operations_in_progress; node != NULL; node = next) {
 		next = node->next;
 		op = node->data;
 
@@ -2289,6 +2372,7 @@ update_info_internal (NautilusFile *file,
 	const char *description;
 	const char *filesystem_id;
 	const char *trash_orig_path;
+	NautilusFileRareDetails *rare;
 	const char *group, *owner, *owner_real;
 	_Bool free_owner, free_group;
 
@@ -2316,10 +2400,11 @@ update_info_internal (NautilusFile *file,
 	}
 	file->details->got_file_info = TRUE;
 
-	changed |= nautilus_file_set_display_name (file,
-						  g_file_info_get_display_name (info),
-						  g_file_info_get_edit_name (info),
-						  FALSE);
+	changed |= set_display_name_internal (file,
+					      g_file_info_get_display_name (info),
+					      g_file_info_get_edit_name (info),
+					      FALSE,
+					      g_file_info_get_attribute_string (info, COLLATION_KEY_ATTRIBUTE));
 
 	file_type = g_file_info_get_file_type (info);
 	if (file->details->type != file_type) {
@@ -2650,10 +2735,11 @@ update_info_internal (NautilusFile *file,
 	}
 
 	trash_orig_path = g_file_info_get_attribute_byte_string (info, "trash::orig-path");
-	if (g_strcmp0 (file->details->trash_orig_path, trash_orig_path) != 0) {
+	if (g_strcmp0 (nautilus_file_peek_rare_details (file)->trash_orig_path, trash_orig_path) != 0) {
 		changed = TRUE;
-		g_free (file->details->trash_orig_path);
-		file->details->trash_orig_path = g_strdup (trash_orig_path);
+		rare = nautilus_file_get_rare_details (file);
+		g_free (rare->trash_orig_path);
+		rare->trash_orig_path = g_strdup (trash_orig_path);
 	}
 
 	changed |=
@@ -2696,6 +2782,8 @@ update_info_internal (NautilusFile *file,
 		update_links_if_target (file);
 	}
 
+	nautilus_directory_update_missing_counts (file->details->directory, file);
+
 	return changed;
 }
 
@@ -3374,6 +3462,31 @@ nautilus_file_compare_for_sort (NautilusFile *file_1,
 	return result;
 }
 
+/* Certain attributes sort like a NautilusFileSortType */
+static _Bool
+get_sort_type_for_attribute (unsigned int attribute, NautilusFileSortType *sort_type)
+{
+	if (attribute == 0 || attribute == attribute_name_q) {
+		*sort_type = NAUTILUS_FILE_SORT_BY_DISPLAY_NAME;
+	} else if (attribute == attribute_size_q) {
+		*sort_type = NAUTILUS_FILE_SORT_BY_SIZE;
+	} else if (attribute == attribute_type_q) {
+		*sort_type = NAUTILUS_FILE_SORT_BY_TYPE;
+	} else if (attribute == attribute_detailed_type_q) {
+		*sort_type = NAUTILUS_FILE_SORT_BY_DETAILED_TYPE;
+	} else if (attribute == attribute_modification_date_q || attribute == attribute_date_modified_q) {
+		*sort_type = NAUTILUS_FILE_SORT_BY_MTIME;
+	} else if (attribute == attribute_accessed_date_q || attribute == attribute_date_accessed_q) {
+		*sort_type = NAUTILUS_FILE_SORT_BY_ATIME;
+	} else if (attribute == attribute_trashed_on_q) {
+		*sort_type = NAUTILUS_FILE_SORT_BY_TRASHED_TIME;
+	} else {
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
 int
 nautilus_file_compare_for_sort_by_attribute_q   (NautilusFile                   *file_1,
 						 NautilusFile                   *file_2,
@@ -3381,6 +3494,7 @@ nautilus_file_compare_for_sort_by_attribute_q   (NautilusFile
 						 _Bool                        directories_first,
 						 _Bool                        reversed)
 {
+	NautilusFileSortType sort_type;
 	int result;
 
 	if (file_1 == file_2) {
@@ -3390,39 +3504,9 @@ nautilus_file_compare_for_sort_by_attribute_q   (NautilusFile
 	/* Convert certain attributes into NautilusFileSortTypes and use
 	 * nautilus_file_compare_for_sort()
 	 */
-	if (attribute == 0 || attribute == attribute_name_q) {
-		return nautilus_file_compare_for_sort (file_1, file_2,
-						       NAUTILUS_FILE_SORT_BY_DISPLAY_NAME,
-						       directories_first,
-						       reversed);
-	} else if (attribute == attribute_size_q) {
-		return nautilus_file_compare_for_sort (file_1, file_2,
-						       NAUTILUS_FILE_SORT_BY_SIZE,
-						       directories_first,
-						       reversed);
-	} else if (attribute == attribute_type_q) {
+	if (get_sort_type_for_attribute (attribute, &sort_type)) {
 		return nautilus_file_compare_for_sort (file_1, file_2,
-						       NAUTILUS_FILE_SORT_BY_TYPE,
-						       directories_first,
-						       reversed);
-        } else if (attribute == attribute_detailed_type_q) {
-                return nautilus_file_compare_for_sort (file_1, file_2,
-                                                         NAUTILUS_FILE_SORT_BY_DETAILED_TYPE,
-                                                         directories_first,
-                                                         reversed);
-	} else if (attribute == attribute_modification_date_q || attribute == attribute_date_modified_q) {
-		return nautilus_file_compare_for_sort (file_1, file_2,
-						       NAUTILUS_FILE_SORT_BY_MTIME,
-						       directories_first,
-						       reversed);
-        } else if (attribute == attribute_accessed_date_q || attribute == attribute_date_accessed_q) {
-		return nautilus_file_compare_for_sort (file_1, file_2,
-						       NAUTILUS_FILE_SORT_BY_ATIME,
-						       directories_first,
-						       reversed);
-        } else if (attribute == attribute_trashed_on_q) {
-		return nautilus_file_compare_for_sort (file_1, file_2,
-						       NAUTILUS_FILE_SORT_BY_TRASHED_TIME,
+						       sort_type,
 						       directories_first,
 						       reversed);
 	}
@@ -3469,6 +3553,411 @@ nautilus_file_compare_for_sort_by_attribute     (NautilusFile
 }
 
 
+/* A file being sorted, with everything the comparison looks at
+ * fetched up front, so comparing allocates nothing. Strings the
+ * file does not own live in the sort's string chunk.
+ */
+typedef struct {
+	void *item;
+	NautilusFile *file;
+	_Bool is_directory;
+	_Bool sort_last;
+	int sort_order;
+	const char *name_key;
+	const char *directory_key;
+	const char *string_key;	/* type or attribute */
+	Knowledge known;	/* of the count, size or time in number */
+	gint64 number;
+} SortKey;
+
+typedef struct {
+	_Bool by_attribute;
+	unsigned int attribute;
+	NautilusFileSortType sort_type;
+	_Bool directories_first;
+	_Bool reversed;
+
+	GStringChunk *strings;
+	GHashTable *directory_keys;
+} SortSpec;
+
+/* Files of one directory share the key of its location */
+static const char *
+get_directory_sort_key (SortSpec *spec, NautilusFile *file)
+{
+	const char *key;
+	char *directory, *collation_key;
+
+	key = g_hash_table_lookup (spec->directory_keys, file->details->directory);
+	if (key == NULL) {
+		directory = nautilus_file_get_parent_uri_for_display (file);
+		collation_key = g_utf8_collate_key (directory != NULL ? directory : "", -1);
+		key = g_string_chunk_insert_const (spec->strings, collation_key);
+		g_hash_table_insert (spec->directory_keys, file->details->directory, (char *) key);
+		g_free (collation_key);
+		g_free (directory);
+	}
+
+	return key;
+}
+
+static const char *
+get_type_sort_key (SortSpec *spec, NautilusFile *file)
+{
+	const char *key;
+	char *type_string, *collation_key;
+
+	if (spec->sort_type == NAUTILUS_FILE_SORT_BY_DETAILED_TYPE) {
+		type_string = nautilus_file_get_detailed_type_as_string (file);
+	} else {
+		type_string = nautilus_file_get_type_as_string (file);
+	}
+
+	if (type_string == NULL) {
+		return NULL;
+	}
+
+	collation_key = g_utf8_collate_key (type_string, -1);
+	key = g_string_chunk_insert_const (spec->strings, collation_key);
+	g_free (collation_key);
+	g_free (type_string);
+
+	return key;
+}
+
+static void
+sort_key_init (SortKey *key, void *item, NautilusFile *file, SortSpec *spec)
+{
+	const char *name;
+	char *value;
+	unsigned int count;
+	goffset size;
+	time_t time;
+
+	key->item = item;
+	key->file = file;
+	key->is_directory = nautilus_file_is_directory (file);
+	key->sort_last = FALSE;
+	key->sort_order = file->details->sort_order;
+	key->name_key = NULL;
+	key->directory_key = NULL;
+	key->string_key = NULL;
+	key->known = UNKNOWN;
+	key->number = 0;
+
+	if (spec->by_attribute) {
+		value = nautilus_file_get_string_attribute_q (file, spec->attribute);
+		if (value != NULL) {
+			key->string_key = g_string_chunk_insert_const (spec->strings, value);
+			g_free (value);
+		}
+		return;
+	}
+
+	name = nautilus_file_peek_display_name (file);
+	key->sort_last = name[0] == SORT_LAST_CHAR1 || name[0] == SORT_LAST_CHAR2;
+	key->name_key = nautilus_file_peek_display_name_collation_key (file);
+	key->directory_key = get_directory_sort_key (spec, file);
+
+	switch (spec->sort_type) {
+	case NAUTILUS_FILE_SORT_BY_SIZE:
+		if (key->is_directory) {
+			count = 0;
+			key->known = get_item_count (file, &count);
+			key->number = count;
+		} else {
+			size = 0;
+			key->known = get_size (file, &size);
+			key->number = size;
+		}
+		break;
+	case NAUTILUS_FILE_SORT_BY_TYPE:
+	case NAUTILUS_FILE_SORT_BY_DETAILED_TYPE:
+		if (!key->is_directory) {
+			key->string_key = get_type_sort_key (spec, file);
+		}
+		break;
+	case NAUTILUS_FILE_SORT_BY_MTIME:
+		time = 0;
+		key->known = get_time (file, &time, NAUTILUS_DATE_TYPE_MODIFIED);
+		key->number = time;
+		break;
+	case NAUTILUS_FILE_SORT_BY_ATIME:
+		time = 0;
+		key->known = get_time (file, &time, NAUTILUS_DATE_TYPE_ACCESSED);
+		key->number = time;
+		break;
+	case NAUTILUS_FILE_SORT_BY_TRASHED_TIME:
+		time = 0;
+		key->known = get_time (file, &time, NAUTILUS_DATE_TYPE_TRASHED);
+		key->number = time;
+		break;
+	default:
+		break;
+	}
+}
+
+/* The comparisons below give the same order as their
+ * compare_by_* counterparts on the files.
+ */
+static int
+compare_sort_keys_by_display_name (const SortKey *key_1, const SortKey *key_2)
+{
+	if (key_1->sort_last && !key_2->sort_last) {
+		return +1;
+	}
+	if (!key_1->sort_last && key_2->sort_last) {
+		return -1;
+	}
+
+	return strcmp (key_1->name_key, key_2->name_key);
+}
+
+static int
+compare_sort_keys_by_directory_name (const SortKey *key_1, const SortKey *key_2)
+{
+	if (key_1->directory_key == key_2->directory_key) {
+		return 0;
+	}
+
+	return strcmp (key_1->directory_key, key_2->directory_key);
+}
+
+static int
+compare_sort_keys_by_full_path (const SortKey *key_1, const SortKey *key_2)
+{
+	int compare;
+
+	compare = compare_sort_keys_by_directory_name (key_1, key_2);
+	if (compare != 0) {
+		return compare;
+	}
+	return compare_sort_keys_by_display_name (key_1, key_2);
+}
+
+/* Counts, sizes and times all sort the same way */
+static int
+compare_sort_keys_by_number (const SortKey *key_1, const SortKey *key_2)
+{
+	if (key_1->known > key_2->known) {
+		return -1;
+	}
+	if (key_1->known < key_2->known) {
+		return +1;
+	}
+
+	if (key_1->known == UNKNOWABLE || key_1->known == UNKNOWN) {
+		return 0;
+	}
+
+	if (key_1->number < key_2->number) {
+		return -1;
+	}
+	if (key_1->number > key_2->number) {
+		return +1;
+	}
+
+	return 0;
+}
+
+static int
+compare_sort_keys_by_size (const SortKey *key_1, const SortKey *key_2)
+{
+	if (key_1->is_directory && !key_2->is_directory) {
+		return -1;
+	}
+	if (key_2->is_directory && !key_1->is_directory) {
+		return +1;
+	}
+
+	return compare_sort_keys_by_number (key_1, key_2);
+}
+
+static int
+compare_sort_keys_by_type (const SortKey *key_1, const SortKey *key_2)
+{
+	if (key_1->is_directory && key_2->is_directory) {
+		return 0;
+	}
+	if (key_1->is_directory) {
+		return -1;
+	}
+	if (key_2->is_directory) {
+		return +1;
+	}
+
+	if (key_1->string_key == NULL || key_2->string_key == NULL) {
+		if (key_1->string_key != NULL) {
+			return -1;
+		}
+		if (key_2->string_key != NULL) {
+			return +1;
+		}
+		return 0;
+	}
+
+	return strcmp (key_1->string_key, key_2->string_key);
+}
+
+static int
+compare_sort_keys (const void *a, const void *b, void *user_data)
+{
+	const SortKey *key_1, *key_2;
+	SortSpec *spec;
+	int result;
+
+	key_1 = a;
+	key_2 = b;
+	spec = user_data;
+
+	if (key_1->file == key_2->file) {
+		return 0;
+	}
+
+	if (spec->directories_first) {
+		if (key_1->is_directory && !key_2->is_directory) {
+			return -1;
+		}
+		if (key_2->is_directory && !key_1->is_directory) {
+			return +1;
+		}
+	}
+
+	if (key_1->sort_order < key_2->sort_order) {
+		return spec->reversed ? 1 : -1;
+	} else if (key_1->sort_order > key_2->sort_order) {
+		return spec->reversed ? -1 : 1;
+	}
+
+	if (spec->by_attribute) {
+		result = 0;
+		if (key_1->string_key != NULL && key_2->string_key != NULL) {
+			result = strcmp (key_1->string_key, key_2->string_key);
+		}
+	} else {
+		switch (spec->sort_type) {
+		case NAUTILUS_FILE_SORT_BY_DISPLAY_NAME:
+			result = compare_sort_keys_by_display_name (key_1, key_2);
+			if (result == 0) {
+				result = compare_sort_keys_by_directory_name (key_1, key_2);
+			}
+			break;
+		case NAUTILUS_FILE_SORT_BY_SIZE:
+			result = compare_sort_keys_by_size (key_1, key_2);
+			if (result == 0) {
+				result = compare_sort_keys_by_full_path (key_1, key_2);
+			}
+			break;
+		case NAUTILUS_FILE_SORT_BY_TYPE:
+		case NAUTILUS_FILE_SORT_BY_DETAILED_TYPE:
+			result = compare_sort_keys_by_type (key_1, key_2);
+			if (result == 0) {
+				result = compare_sort_keys_by_full_path (key_1, key_2);
+			}
+			break;
+		default:
+			result = compare_sort_keys_by_number (key_1, key_2);
+			if (result == 0) {
+				result = compare_sort_keys_by_full_path (key_1, key_2);
+			}
+			break;
+		}
+	}
+
+	return spec->reversed ? -result : result;
+}
+
+static void
+sort_items (void                   **items,
+	    unsigned int             n_items,
+	    NautilusFileSortGetFunc  get_file,
+	    SortSpec                *spec)
+{
+	SortKey *keys;
+	unsigned int i;
+
+	if (n_items < 2) {
+		return;
+	}
+
+	spec->strings = g_string_chunk_new (4096);
+	spec->directory_keys = g_hash_table_new (NULL, NULL);
+
+	keys = g_new (SortKey, n_items);
+	for (i = 0; i < n_items; i++) {
+		sort_key_init (&keys[i], items[i],
+			       get_file != NULL ? get_file (items[i]) : items[i],
+			       spec);
+	}
+
+	g_qsort_with_data (keys, n_items, sizeof (SortKey), compare_sort_keys, spec);
+
+	for (i = 0; i < n_items; i++) {
+		items[i] = keys[i].item;
+	}
+
+	g_free (keys);
+	g_hash_table_destroy (spec->directory_keys);
+	g_string_chunk_free (spec->strings);
+}
+
+/**
+ * nautilus_file_sort_items:
+ * @items: Array of the things to sort
+ * @n_items: Length of @items
+ * @get_file: Returns the file of an item, or NULL if the items are files
+ * @sort_type: Sort criterion
+ * @directories_first: Put all directories before any non-directories
+ * @reversed: Reverse the order of the items, except that
+ * the directories_first flag is still respected.
+ *
+ * Sorts @items in place into the order nautilus_file_compare_for_sort()
+ * gives their files. The keys it compares are computed once per item
+ * rather than once per comparison, which makes it the way to sort
+ * more than a handful of files.
+ **/
+void
+nautilus_file_sort_items (void                   **items,
+			  unsigned int             n_items,
+			  NautilusFileSortGetFunc  get_file,
+			  NautilusFileSortType     sort_type,
+			  _Bool                    directories_first,
+			  _Bool                    reversed)
+{
+	SortSpec spec = { 0 };
+
+	spec.by_attribute = FALSE;
+	spec.sort_type = sort_type;
+	spec.directories_first = directories_first;
+	spec.reversed = reversed;
+
+	sort_items (items, n_items, get_file, &spec);
+}
+
+/**
+ * nautilus_file_sort_items_by_attribute_q:
+ *
+ * Like nautilus_file_sort_items(), in the order of
+ * nautilus_file_compare_for_sort_by_attribute_q().
+ **/
+void
+nautilus_file_sort_items_by_attribute_q (void                   **items,
+					 unsigned int             n_items,
+					 NautilusFileSortGetFunc  get_file,
+					 unsigned int             attribute,
+					 _Bool                    directories_first,
+					 _Bool                    reversed)
+{
+	SortSpec spec = { 0 };
+
+	spec.by_attribute = !get_sort_type_for_attribute (attribute, &spec.sort_type);
+	spec.attribute = attribute;
+	spec.directories_first = directories_first;
+	spec.reversed = reversed;
+
+	sort_items (items, n_items, get_file, &spec);
+}
+
 /**
  * nautilus_file_compare_name:
  * @file: A file object
@@ -4769,7 +5258,7 @@ nautilus_file_get_trash_original_file_parent_as_string (NautilusFile *file)
 	GFile *location;
 	char *filename;
 
-	if (file->details->trash_orig_path != NULL) {
+	if (nautilus_file_peek_rare_details (file)->trash_orig_path != NULL) {
 		orig_file = nautilus_file_get_trash_original_file (file);
 		parent = nautilus_file_get_parent (orig_file);
 		location = nautilus_file_get_location (parent);
@@ -4810,12 +5299,14 @@ static void
 show_text_in_icons_changed_callback (void * callback_data)
 {
 	show_text_in_icons = eel_settings_get_enum (nautilus_preferences, NAUTILUS_PREFERENCES_SHOW_TEXT_IN_ICONS);
+	nautilus_directory_invalidate_missing_counts ();
 }
 
 static void
 show_directory_item_count_changed_callback (void * callback_data)
 {
 	show_directory_item_count = eel_settings_get_enum (nautilus_preferences, NAUTILUS_PREFERENCES_SHOW_DIRECTORY_ITEM_COUNTS);
+	nautilus_directory_invalidate_missing_counts ();
 }
 
 static _Bool
@@ -5015,6 +5506,7 @@ nautilus_file_get_deep_counts (NautilusFile     *file,
                  * when preference changes later.
                  */
                 file->details->deep_counts_status = NAUTILUS_REQUEST_NOT_STARTED;
+                nautilus_directory_update_missing_counts (file->details->directory, file);
                 return file->details->deep_counts_status;
         }
 
@@ -5028,6 +5520,7 @@ nautilus_file_recompute_deep_counts (NautilusFile *file)
 	if (file->details->deep_counts_status != NAUTILUS_REQUEST_IN_PROGRESS) {
 		file->details->deep_counts_status = NAUTILUS_REQUEST_NOT_STARTED;
 		if (file->details->directory != NULL) {
+			nautilus_directory_update_missing_counts (file->details->directory, file);
 			nautilus_directory_add_file_to_work_queue (file->details->directory, file);
 			nautilus_directory_async_state_changed (file->details->directory);
 		}
@@ -6265,6 +6758,7 @@ nautilus_file_get_deep_directory_count_as_string (NautilusFile *file)
 char *
 nautilus_file_get_string_attribute_q (NautilusFile *file, unsigned int attribute_q)
 {
+        const NautilusFileRareDetails *rare;
         char *extension_attribute;
 
         if (attribute_q == attribute_name_q) {
@@ -6353,13 +6847,15 @@ nautilus_file_get_string_attribute_q (NautilusFile *file, unsigned int attribute
 
         extension_attribute = NULL;
 
-        if (file->details->pending_extension_attributes) {
-                extension_attribute = g_hash_table_lookup (file->details->pending_extension_attributes,
+        rare = nautilus_file_peek_rare_details (file);
+
+        if (rare->pending_extension_attributes) {
+                extension_attribute = g_hash_table_lookup (rare->pending_extension_attributes,
                                                            GINT_TO_POINTER (attribute_q));
         }
 
-        if (extension_attribute == NULL && file->details->extension_attributes) {
-                extension_attribute = g_hash_table_lookup (file->details->extension_attributes,
+        if (extension_attribute == NULL && rare->extension_attributes) {
+                extension_attribute = g_hash_table_lookup (rare->extension_attributes,
                                                            GINT_TO_POINTER (attribute_q));
         }
 
@@ -6861,8 +7357,8 @@ nautilus_file_get_keywords (NautilusFile *file)
 
 	g_return_val_if_fail (NAUTILUS_IS_FILE (file), NULL);
 
-	keywords = eel_g_str_list_copy (file->details->extension_emblems);
-	keywords = g_list_concat (keywords, eel_g_str_list_copy (file->details->pending_extension_emblems));
+	keywords = eel_g_str_list_copy (nautilus_file_peek_rare_details (file)->extension_emblems);
+	keywords = g_list_concat (keywords, eel_g_str_list_copy (nautilus_file_peek_rare_details (file)->pending_extension_emblems));
 	keywords = g_list_concat (keywords, nautilus_file_get_metadata_list (file, NAUTILUS_METADATA_KEY_EMBLEMS));
 
 	return sort_keyword_list_and_remove_duplicates (keywords);
@@ -6969,8 +7465,8 @@ get_fs_free_cb (GObject *source_object,
 		g_object_unref (info);
 	}
 
-	if (file->details->free_space != free_space) {
-		file->details->free_space = free_space;
+	if (nautilus_file_peek_rare_details (file)->free_space != free_space) {
+		nautilus_file_get_rare_details (file)->free_space = free_space;
 		nautilus_file_emit_changed (file);
 	}
 
@@ -6987,16 +7483,20 @@ get_fs_free_cb (GObject *source_object,
 char*
 nautilus_file_get_volume_free_space (NautilusFile *file)
 {
+    NautilusFileRareDetails *rare;
     GFile  *location;
     char   *size_string;
     time_t  now;
 
+    /* Only the few files whose free space is shown get here */
+    rare = nautilus_file_get_rare_details (file);
+
     now = time (NULL);
     /* Update first time and then every 2 seconds */
-    if (file->details->free_space_read == 0 ||
-       (now - file->details->free_space_read) > 2)
+    if (rare->free_space_read == 0 ||
+       (now - rare->free_space_read) > 2)
     {
-        file->details->free_space_read = now;
+        rare->free_space_read = now;
         location = nautilus_file_get_location (file);
         g_file_query_filesystem_info_async (location,
                                             G_FILE_ATTRIBUTE_FILESYSTEM_FREE,
@@ -7007,8 +7507,8 @@ nautilus_file_get_volume_free_space (NautilusFile *file)
     }
 
     size_string = NULL;
-    if (file->details->free_space != (guint64)-1) {
-        size_string = g_format_size_full (file->details->free_space, SizePrefix);
+    if (rare->free_space != (guint64)-1) {
+        size_string = g_format_size_full (rare->free_space, SizePrefix);
     }
 
     return size_string;
@@ -7338,7 +7838,7 @@ nautilus_file_peek_top_left_text (NautilusFile *file,
 	}
 
 	/* Show what we read in. */
-	return file->details->top_left_text;
+	return nautilus_file_peek_rare_details (file)->top_left_text;
 }
 
 /**
@@ -7371,9 +7871,9 @@ nautilus_file_get_trash_original_file (NautilusFile *file)
 
 	original_file = NULL;
 
-	if (file->details->trash_orig_path != NULL) {
+	if (nautilus_file_peek_rare_details (file)->trash_orig_path != NULL) {
 		/* file name is stored in URL encoding */
-		filename = g_uri_unescape_string (file->details->trash_orig_path, "");
+		filename = g_uri_unescape_string (nautilus_file_peek_rare_details (file)->trash_orig_path, "");
 		location = g_file_new_for_path (filename);
 		original_file = nautilus_file_get (location);
 		g_object_unref (G_OBJECT (location));
@@ -7428,6 +7928,8 @@ nautilus_file_changed (NautilusFile *file)
 
 	g_return_if_fail (NAUTILUS_IS_FILE (file));
 
+	nautilus_directory_update_missing_counts (file->details->directory, file);
+
 	if (nautilus_file_is_self_owned (file)) {
 		nautilus_file_emit_changed (file);
 	} else {
@@ -7605,6 +8107,26 @@ nautilus_file_cancel_call_when_ready (NautilusFile *file,
 		(file, callback, callback_data);
 }
 
+void
+nautilus_file_prioritize (NautilusFile *file)
+{
+	g_return_if_fail (NAUTILUS_IS_FILE (file));
+
+	if (file->details->directory != NULL) {
+		nautilus_directory_prioritize_file_in_work_queue (file->details->directory, file);
+	}
+}
+
+void
+nautilus_file_deprioritize (NautilusFile *file)
+{
+	g_return_if_fail (NAUTILUS_IS_FILE (file));
+
+	if (file->details->directory != NULL) {
+		nautilus_directory_defer_file_in_work_queue (file->details->directory, file);
+	}
+}
+
 
 static GString *
 add_line (GString *string, const char *add, _Bool prefix_newline)
@@ -7920,6 +8442,8 @@ nautilus_file_invalidate_attributes_internal (NautilusFile *file,
 	}
 
 	/* FIXME bugzilla.gnome.org 45075: implement invalidating metadata */
+
+	nautilus_directory_update_missing_counts (file->details->directory, file);
 }
 
 _Bool
@@ -8028,7 +8552,7 @@ nautilus_file_invalidate_all_attributes (NautilusFile *file)
 void
 nautilus_file_dump (NautilusFile *file)
 {
-	long size = file->details->deep_size;
+	long size = nautilus_file_peek_rare_details (file)->deep_size;
 	char *uri;
 	const char *file_kind;
 
@@ -8483,6 +9007,7 @@ thumbnail_limit_prefs_changed_callback (void *nothing)
     g_settings_get (nautilus_preferences,
                     NAUTILUS_PREFERENCES_IMAGE_FILE_THUMBNAIL_LIMIT,
                     "t", &ThumbnailLimit);
+    nautilus_directory_invalidate_missing_counts ();
 
     /* Tell the world that icons might have changed. We could invent a narrower-scope
      * signal to mean only "thumbnails might have changed" if this ends up being slow
@@ -8510,6 +9035,7 @@ show_thumbnails_prefs_changed_callback (void *nothing)
 {
 	ShowThumbs = eel_settings_get_enum (nautilus_preferences,
                                                    NAUTILUS_PREFERENCES_SHOW_IMAGE_FILE_THUMBNAILS);
+	nautilus_directory_invalidate_missing_counts ();
 
 	/* Tell the world that icons might have changed. We could invent a narrower-scope
 	 * signal to mean only "thumbnails might have changed" if this ends up being slow
@@ -8680,19 +9206,21 @@ nautilus_file_init (NautilusFile *file)
 
         nautilus_file_clear_info (file);
         nautilus_file_invalidate_extension_info_internal (file);
-
-        file->details->free_space = -1;
 }
 static void
 nautilus_file_add_emblem (NautilusFile *file,
 			  const char *emblem_name)
 {
+	NautilusFileRareDetails *rare;
+
+	rare = nautilus_file_get_rare_details (file);
+
 	if (file->details->pending_info_providers) {
-		file->details->pending_extension_emblems = g_list_prepend (file->details->pending_extension_emblems,
-									   g_strdup (emblem_name));
+		rare->pending_extension_emblems = g_list_prepend (rare->pending_extension_emblems,
+								  g_strdup (emblem_name));
 	} else {
-		file->details->extension_emblems = g_list_prepend (file->details->extension_emblems,
-								   g_strdup (emblem_name));
+		rare->extension_emblems = g_list_prepend (rare->extension_emblems,
+							  g_strdup (emblem_name));
 	}
 
 	nautilus_file_changed (file);
@@ -8703,25 +9231,29 @@ nautilus_file_add_string_attribute (NautilusFile *file,
 				    const char *attribute_name,
 				    const char *value)
 {
+	NautilusFileRareDetails *rare;
+
+	rare = nautilus_file_get_rare_details (file);
+
 	if (file->details->pending_info_providers) {
 		/* Lazily create hashtable */
-		if (!file->details->pending_extension_attributes) {
-			file->details->pending_extension_attributes =
+		if (!rare->pending_extension_attributes) {
+			rare->pending_extension_attributes =
 				g_hash_table_new_full (g_direct_hash, g_direct_equal,
 						       NULL,
 						       (GDestroyNotify)g_free);
 		}
-		g_hash_table_insert (file->details->pending_extension_attributes,
+		g_hash_table_insert (rare->pending_extension_attributes,
 				     GINT_TO_POINTER (g_quark_from_string (attribute_name)),
 				     g_strdup (value));
 	} else {
-		if (!file->details->extension_attributes) {
-			file->details->extension_attributes =
+		if (!rare->extension_attributes) {
+			rare->extension_attributes =
 				g_hash_table_new_full (g_direct_hash, g_direct_equal,
 						       NULL,
 						       (GDestroyNotify)g_free);
 		}
-		g_hash_table_insert (file->details->extension_attributes,
+		g_hash_table_insert (rare->extension_attributes,
 				     GINT_TO_POINTER (g_quark_from_string (attribute_name)),
 				     g_strdup (value));
 	}
@@ -8738,16 +9270,22 @@ nautilus_file_invalidate_extension_info (NautilusFile *file)
 void
 nautilus_file_info_providers_done (NautilusFile *file)
 {
-	g_list_free_full (file->details->extension_emblems, g_free);
-	file->details->extension_emblems = file->details->pending_extension_emblems;
-	file->details->pending_extension_emblems = NULL;
+	NautilusFileRareDetails *rare;
 
-	if (file->details->extension_attributes) {
-		g_hash_table_destroy (file->details->extension_attributes);
-	}
+	/* Nothing to swap in if no provider added anything */
+	rare = file->details->rare;
+	if (rare != NULL) {
+		g_list_free_full (rare->extension_emblems, g_free);
+		rare->extension_emblems = rare->pending_extension_emblems;
+		rare->pending_extension_emblems = NULL;
+
+		if (rare->extension_attributes) {
+			g_hash_table_destroy (rare->extension_attributes);
+		}
 
-	file->details->extension_attributes = file->details->pending_extension_attributes;
-	file->details->pending_extension_attributes = NULL;
+		rare->extension_attributes = rare->pending_extension_attributes;
+		rare->pending_extension_attributes = NULL;
+	}
 
 	nautilus_file_changed (file);
 }
@@ -117,6 +117,7 @@ typedef int (*NautilusWidthMeasureCallback)   (const char    *string,
 typedef char * (*NautilusTruncateCallback)    (const char    *string,
                                                int	      width,
                                                void	     *context);
+typedef NautilusFile * (*NautilusFileSortGetFunc) (void         *item);
 
 
 #define NAUTILUS_FILE_ATTRIBUTES_FOR_ICON (NAUTILUS_FILE_ATTRIBUTE_INFO | NAUTILUS_FILE_ATTRIBUTE_LINK_INFO | NAUTILUS_FILE_ATTRIBUTE_THUMBNAIL)
@@ -161,6 +162,15 @@ void                    nautilus_file_cancel_call_when_ready            (Nautilu
                                                                          void                            *callback_data);
 _Bool                   nautilus_file_check_if_ready                    (NautilusFile                   *file,
                                                                          NautilusFileAttributes          attributes);
+/* Fetch the attributes of a file that is on screen before those of the
+ * other files in its directory.
+ */
+void                    nautilus_file_prioritize                        (NautilusFile                   *file);
+/* Drop the thumbnail, top left text and item count work of a file that
+ * went off screen, unless someone waits for it. Prioritizing the file
+ * brings the work back.
+ */
+void                    nautilus_file_deprioritize                      (NautilusFile                   *file);
 void                    nautilus_file_invalidate_attributes             (NautilusFile                   *file,
                                                                          NautilusFileAttributes          attributes);
 void                    nautilus_file_invalidate_all_attributes         (NautilusFile                   *file);
@@ -426,6 +436,20 @@ int                     nautilus_file_compare_for_sort_by_attribute_q   (Nautilu
                                                                          _Bool                           reversed);
 _Bool                   nautilus_file_is_date_sort_attribute_q          (unsigned int                    attribute);
 
+/* Sorting many files at once, in the order of the comparisons above */
+void                    nautilus_file_sort_items                        (void                          **items,
+                                                                         unsigned int                    n_items,
+                                                                         NautilusFileSortGetFunc         get_file,
+                                                                         NautilusFileSortType            sort_type,
+                                                                         _Bool                           directories_first,
+                                                                         _Bool                           reversed);
+void                    nautilus_file_sort_items_by_attribute_q         (void                          **items,
+                                                                         unsigned int                    n_items,
+                                                                         NautilusFileSortGetFunc         get_file,
+                                                                         unsigned int                    attribute,
+                                                                         _Bool                           directories_first,
+                                                                         _Bool                           reversed);
+
 int                     nautilus_file_compare_display_name              (NautilusFile                   *file_1,
                                                                          const char                     *pattern);
 int                     nautilus_file_compare_location                  (NautilusFile                    *file_1,
@@ -127,6 +127,12 @@ typedef enum
 #define NAUTILUS_PREFERENCES_SHOW_BOOKMARKS_IN_TO_MENUS         "show-bookmarks-in-to-menus"
 #define NAUTILUS_PREFERENCES_SHOW_PLACES_IN_TO_MENUS            "show-places-in-to-menus"
 
+/* File operations */
+#define NAUTILUS_PREFERENCES_MAX_JOBS_PER_FILESYSTEM            "max-jobs-per-filesystem"
+
+/* Search */
+#define NAUTILUS_PREFERENCES_SEARCH_INDEX_ROOTS                 "search-index-roots"
+
 enum
 {
   NAUTILUS_DEFAULT_FOLDER_VIEWER_ICON_VIEW,
@@ -67,6 +67,9 @@
 /* Initial unpositioned icon value */
 #define ICON_UNPOSITIONED_VALUE -1
 
+/* Side of the icon grid cells, a few icons wide at the standard zoom level */
+#define ICON_GRID_CELL_SIZE 256
+
 /* Timeout for making the icon currently selected for keyboard operation visible.
  * If this is 0, you can get into trouble with extra scrolling after holding
  * down the arrow key for awhile when there are many items.
@@ -295,15 +298,73 @@ icon_free (NautilusIcon *icon)
 {
 	/* Destroy this canvas item; the parent will unref it. */
 	eel_canvas_item_destroy (EEL_CANVAS_ITEM (icon->item));
+	g_free (icon->uri);
 	g_free (icon);
 }
 
+/* Indexes the icon under the current URI of its data, which changes
+ * when the file is renamed or moved.
+ */
+static void
+icon_update_uri (NautilusIconContainer *container,
+		 NautilusIcon *icon)
+{
+	GHashTable *icon_uris;
+	char *uri;
+
+	icon_uris = container->details->icon_uris;
+
+	uri = nautilus_icon_container_get_icon_uri (container, icon);
+	if (g_strcmp0 (uri, icon->uri) == 0) {
+		g_free (uri);
+		return;
+	}
+
+	if (icon->uri != NULL &&
+	    g_hash_table_lookup (icon_uris, icon->uri) == icon) {
+		g_hash_table_remove (icon_uris, icon->uri);
+	}
+
+	g_free (icon->uri);
+	icon->uri = uri;
+
+	if (uri != NULL) {
+		/* Replace, so the key is always the owning icon's string */
+		g_hash_table_replace (icon_uris, uri, icon);
+	}
+}
+
 static _Bool
 icon_is_positioned (const NautilusIcon *icon)
 {
 	return icon->x != ICON_UNPOSITIONED_VALUE && icon->y != ICON_UNPOSITIONED_VALUE;
 }
 
+/* Keeps the icon grid in step with the icon's position and bounds */
+static void
+icon_update_grid (NautilusIconContainer *container,
+		  NautilusIcon *icon)
+{
+	NautilusIconGrid *grid;
+	int x1, y1, x2, y2;
+
+	grid = container->details->icon_grid;
+
+	if (!icon_is_positioned (icon)) {
+		nautilus_icon_grid_remove (grid, icon);
+		return;
+	}
+
+	nautilus_icon_grid_set_position (grid, icon, icon->x, icon->y);
+
+	icon_get_bounding_box (icon, &x1, &y1, &x2, &y2,
+			       BOUNDS_USAGE_FOR_ENTIRE_ITEM);
+	nautilus_icon_grid_include_bounds (grid, icon->x, icon->y, x1, y1, x2, y2);
+	icon_get_bounding_box (icon, &x1, &y1, &x2, &y2,
+			       BOUNDS_USAGE_FOR_DISPLAY);
+	nautilus_icon_grid_include_bounds (grid, icon->x, icon->y, x1, y1, x2, y2);
+}
+
 
 /* x, y are the top-left coordinates of the icon. */
 static void
@@ -320,12 +381,13 @@ icon_set_position (NautilusIcon *icon,
 	int height_above, width_left;
 	int min_x, max_x, min_y, max_y;
 
+	container = NAUTILUS_ICON_CONTAINER (EEL_CANVAS_ITEM (icon->item)->canvas);
+
 	if (icon->x == x && icon->y == y) {
+		icon_update_grid (container, icon);
 		return;
 	}
 
-	container = NAUTILUS_ICON_CONTAINER (EEL_CANVAS_ITEM (icon->item)->canvas);
-
 	if (icon == get_icon_being_renamed (container)) {
 		end_renaming_mode (container, TRUE);
 	}
@@ -392,6 +454,8 @@ icon_set_position (NautilusIcon *icon,
 
 	icon->x = x;
 	icon->y = y;
+
+	icon_update_grid (container, icon);
 }
 
 static void
@@ -1180,10 +1244,32 @@ sort_icons (NautilusIconContainer *container,
 {
 	NautilusIconContainerClass *klass;
 
+	NautilusIconData **data;
+	unsigned int n_icons, i;
+	GList *l;
+
 	klass = NAUTILUS_ICON_CONTAINER_GET_CLASS (container);
 	g_assert (klass->compare_icons != NULL);
 
-	*icons = g_list_sort_with_data (*icons, compare_icons, container);
+	if (klass->sort_icon_data == NULL) {
+		*icons = g_list_sort_with_data (*icons, compare_icons, container);
+		return;
+	}
+
+	n_icons = g_list_length (*icons);
+	data = g_new (NautilusIconData *, n_icons);
+	for (l = *icons, i = 0; l != NULL; l = l->next) {
+		data[i++] = ((NautilusIcon *) l->data)->data;
+	}
+
+	klass->sort_icon_data (container, data, n_icons);
+
+	/* Reuse the links, only their icons move */
+	for (l = *icons, i = 0; l != NULL; l = l->next) {
+		l->data = g_hash_table_lookup (container->details->icon_set, data[i++]);
+	}
+
+	g_free (data);
 }
 
 static void
@@ -2015,6 +2101,7 @@ lay_down_icons_vertical_desktop (NautilusIconContainer *container, GList *icons)
 			} else {
 				icon->x = 0;
 				icon->y = 0;
+				nautilus_icon_grid_remove (container->details->icon_grid, icon);
 				unplaced_icons = g_list_prepend (unplaced_icons, icon);
 			}
 		}
@@ -2494,35 +2581,40 @@ rubberband_select (NautilusIconContainer *container,
 		   const EelDRect *previous_rect,
 		   const EelDRect *current_rect)
 {
-	GList *p;
-	_Bool    selection_changed, is_in, canvas_rect_calculated;
+	GPtrArray *candidates;
+	_Bool    selection_changed, is_in;
 	NautilusIcon *icon;
 	EelIRect canvas_rect;
 	EelCanvas *canvas;
+	unsigned int i;
 
 	selection_changed = FALSE;
-	canvas_rect_calculated = FALSE;
 
-	for (p = container->details->icons; p != NULL; p = p->next) {
-		icon = p->data;
+	canvas = EEL_CANVAS (container);
+	eel_canvas_w2c (canvas,
+			current_rect->x0,
+			current_rect->y0,
+			&canvas_rect.x0,
+			&canvas_rect.y0);
+	eel_canvas_w2c (canvas,
+			current_rect->x1,
+			current_rect->y1,
+			&canvas_rect.x1,
+			&canvas_rect.y1);
+
+	/* Icons outside both rectangles keep the selection they had
+	 * before rubberbanding, only look at the ones the band touched.
+	 */
+	candidates = g_ptr_array_new ();
+	nautilus_icon_grid_query (container->details->icon_grid,
+				  MIN (previous_rect->x0, current_rect->x0),
+				  MIN (previous_rect->y0, current_rect->y0),
+				  MAX (previous_rect->x1, current_rect->x1),
+				  MAX (previous_rect->y1, current_rect->y1),
+				  candidates);
 
-		if (!canvas_rect_calculated) {
-			/* Only do this calculation once, since all the canvas items
-			 * we are interating are in the same coordinate space
-			 */
-			canvas = EEL_CANVAS_ITEM (icon->item)->canvas;
-			eel_canvas_w2c (canvas,
-					current_rect->x0,
-					current_rect->y0,
-					&canvas_rect.x0,
-					&canvas_rect.y0);
-			eel_canvas_w2c (canvas,
-					current_rect->x1,
-					current_rect->y1,
-					&canvas_rect.x1,
-					&canvas_rect.y1);
-			canvas_rect_calculated = TRUE;
-		}
+	for (i = 0; i < candidates->len; i++) {
+		icon = g_ptr_array_index (candidates, i);
 
 		is_in = nautilus_icon_canvas_item_hit_test_rectangle (icon->item, canvas_rect);
 
@@ -2531,6 +2623,8 @@ rubberband_select (NautilusIconContainer *container,
 			 is_in ^ icon->was_selected_before_rubberband);
 	}
 
+	g_ptr_array_free (candidates, TRUE);
+
 	if (selection_changed) {
 		g_signal_emit (container,
 				 signals[SELECTION_CHANGED], 0);
@@ -2688,6 +2782,9 @@ start_rubberbanding (NautilusIconContainer *container,
 		(EEL_CANVAS (container), event->x, event->y,
 		 &band_info->start_x, &band_info->start_y);
 
+	band_info->prev_rect.x0 = band_info->prev_rect.x1 = band_info->start_x;
+	band_info->prev_rect.y0 = band_info->prev_rect.y1 = band_info->start_y;
+
 	context = gtk_widget_get_style_context (GTK_WIDGET (container));
 	gtk_style_context_save (context);
 	gtk_style_context_add_class (context, GTK_STYLE_CLASS_RUBBERBAND);
@@ -3651,6 +3748,64 @@ record_arrow_key_start (NautilusIconContainer *container,
 	container->details->arrow_key_direction = direction;
 }
 
+/* Same as find_best_icon () with closest_in_90_degrees, but only looks
+ * at the icons in a square around the arrow key start that grows until
+ * nothing outside it could be closer.
+ */
+static NautilusIcon *
+find_closest_icon (NautilusIconContainer *container,
+		   NautilusIcon *start_icon,
+		   int *best_dist)
+{
+	GPtrArray *candidates;
+	NautilusIcon *best, *candidate;
+	double start_x, start_y;
+	double radius;
+	_Bool    covers;
+	unsigned int i;
+
+	eel_canvas_c2w (EEL_CANVAS (container),
+			container->details->arrow_key_start_x,
+			container->details->arrow_key_start_y,
+			&start_x, &start_y);
+
+	candidates = g_ptr_array_new ();
+	radius = ICON_GRID_CELL_SIZE;
+
+	for (;;) {
+		g_ptr_array_set_size (candidates, 0);
+		nautilus_icon_grid_query (container->details->icon_grid,
+					  start_x - radius, start_y - radius,
+					  start_x + radius, start_y + radius,
+					  candidates);
+		covers = nautilus_icon_grid_covers (container->details->icon_grid,
+						    start_x - radius, start_y - radius,
+						    start_x + radius, start_y + radius);
+
+		best = NULL;
+		for (i = 0; i < candidates->len; i++) {
+			candidate = g_ptr_array_index (candidates, i);
+			if (candidate != start_icon &&
+			    closest_in_90_degrees (container, start_icon, best, candidate, best_dist)) {
+				best = candidate;
+			}
+		}
+
+		/* Anything not found lies farther than the radius */
+		if (covers ||
+		    (best != NULL &&
+		     sqrt (*best_dist) <= radius * EEL_CANVAS (container)->pixels_per_unit)) {
+			break;
+		}
+
+		radius *= 2;
+	}
+
+	g_ptr_array_free (candidates, TRUE);
+
+	return best;
+}
+
 static void
 keyboard_arrow_key (NautilusIconContainer *container,
 		    GdkEventKey *event,
@@ -3700,10 +3855,15 @@ keyboard_arrow_key (NautilusIconContainer *container,
 	} else {
 		record_arrow_key_start (container, from, direction);
 
-		to = find_best_icon
-			(container, from,
-			 container->details->auto_layout ? better_destination : better_destination_manual,
-			 &data);
+		if (!container->details->auto_layout &&
+		    better_destination_manual == closest_in_90_degrees) {
+			to = find_closest_icon (container, from, &data);
+		} else {
+			to = find_best_icon
+				(container, from,
+				 container->details->auto_layout ? better_destination : better_destination_manual,
+				 &data);
+		}
 
 		/* Wrap around to next/previous row/column */
 		if (to == NULL &&
@@ -4047,6 +4207,13 @@ finalize (GObject *object)
 
 	g_hash_table_destroy (details->icon_set);
 	details->icon_set = NULL;
+	g_hash_table_destroy (details->icon_uris);
+	details->icon_uris = NULL;
+
+	nautilus_icon_grid_free (details->icon_grid);
+	details->icon_grid = NULL;
+	g_hash_table_destroy (details->visible_icons);
+	details->visible_icons = NULL;
 
 	g_free (details->font);
 
@@ -6177,6 +6344,9 @@ nautilus_icon_container_init (NautilusIconContainer *container)
     details = g_new0 (NautilusIconContainerDetails, 1);
 
     details->icon_set = g_hash_table_new (g_direct_hash, g_direct_equal);
+    details->icon_uris = g_hash_table_new (g_str_hash, g_str_equal);
+    details->icon_grid = nautilus_icon_grid_new (ICON_GRID_CELL_SIZE);
+    details->visible_icons = g_hash_table_new (g_direct_hash, g_direct_equal);
     details->layout_timestamp = UNDEFINED_TIME;
     details->zoom_level = NAUTILUS_ZOOM_LEVEL_STANDARD;
 
@@ -6461,6 +6631,9 @@ nautilus_icon_container_clear (NautilusIconContainer *container)
 	details->stretch_icon = NULL;
 	details->drop_target = NULL;
 
+	/* The keys belong to the icons */
+	g_hash_table_remove_all (details->icon_uris);
+
 	for (p = details->icons; p != NULL; p = p->next) {
 		icon = p->data;
 		if (icon->is_monitored) {
@@ -6478,6 +6651,9 @@ nautilus_icon_container_clear (NautilusIconContainer *container)
  	g_hash_table_destroy (details->icon_set);
  	details->icon_set = g_hash_table_new (g_direct_hash, g_direct_equal);
 
+	nautilus_icon_grid_clear (details->icon_grid);
+	g_hash_table_remove_all (details->visible_icons);
+
 	nautilus_icon_container_update_scroll_region (container);
 }
 
@@ -6675,6 +6851,12 @@ icon_destroy (NautilusIconContainer *container,
 	details->icons = g_list_remove (details->icons, icon);
 	details->new_icons = g_list_remove (details->new_icons, icon);
 	g_hash_table_remove (details->icon_set, icon->data);
+	if (icon->uri != NULL &&
+	    g_hash_table_lookup (details->icon_uris, icon->uri) == icon) {
+		g_hash_table_remove (details->icon_uris, icon->uri);
+	}
+	nautilus_icon_grid_remove (details->icon_grid, icon);
+	g_hash_table_remove (details->visible_icons, icon);
 
 	was_selected = icon->is_selected;
 
@@ -6890,6 +7072,46 @@ nautilus_icon_container_prioritize_thumbnailing (NautilusIconContainer *containe
 	klass->prioritize_thumbnailing (container, icon->data);
 }
 
+static void
+nautilus_icon_container_deprioritize_thumbnailing (NautilusIconContainer *container,
+						   NautilusIcon *icon)
+{
+	NautilusIconContainerClass *klass;
+
+	klass = NAUTILUS_ICON_CONTAINER_GET_CLASS (container);
+	g_assert (klass->deprioritize_thumbnailing != NULL);
+
+	klass->deprioritize_thumbnailing (container, icon->data);
+}
+
+/* Sorts icons so the first in reading order comes last */
+static int
+compare_icons_reverse_render_order (gconstpointer a,
+				    gconstpointer b,
+				    void         *user_data)
+{
+	const NautilusIcon *icon_a, *icon_b;
+	_Bool vertical;
+	double a1, a2, b1, b2;
+
+	icon_a = *(NautilusIcon **) a;
+	icon_b = *(NautilusIcon **) b;
+	vertical = GPOINTER_TO_INT (user_data);
+
+	a1 = vertical ? icon_a->x : icon_a->y;
+	a2 = vertical ? icon_a->y : icon_a->x;
+	b1 = vertical ? icon_b->x : icon_b->y;
+	b2 = vertical ? icon_b->y : icon_b->x;
+
+	if (a1 != b1) {
+		return a1 < b1 ? 1 : -1;
+	}
+	if (a2 != b2) {
+		return a2 < b2 ? 1 : -1;
+	}
+	return 0;
+}
+
 static void
 nautilus_icon_container_update_visible_icons (NautilusIconContainer *container)
 {
@@ -6897,10 +7119,14 @@ nautilus_icon_container_update_visible_icons (NautilusIconContainer *container)
     double min_y, max_y;
     double min_x, max_x;
     double x0, y0, x1, y1;
-    GList *node;
+    GHashTable *visible_icons;
+    GHashTableIter iter;
+    GPtrArray *candidates;
     NautilusIcon *icon;
+    _Bool    vertical;
     _Bool    visible;
     GtkAllocation allocation;
+    unsigned int i;
 
     hadj = gtk_scrollable_get_hadjustment (GTK_SCROLLABLE (container));
     vadj = gtk_scrollable_get_vadjustment (GTK_SCROLLABLE (container));
@@ -6917,41 +7143,73 @@ nautilus_icon_container_update_visible_icons (NautilusIconContainer *container)
     eel_canvas_c2w (EEL_CANVAS (container),
                     max_x, max_y, &max_x, &max_y);
 
-    /* Do the iteration in reverse to get the render-order from top to
-     * bottom for the prioritized thumbnails.
+    /* Only the scrolled axis counts, as before */
+    vertical = nautilus_icon_container_is_layout_vertical (container);
+    if (vertical) {
+        min_y = -G_MAXDOUBLE;
+        max_y = G_MAXDOUBLE;
+    } else {
+        min_x = -G_MAXDOUBLE;
+        max_x = G_MAXDOUBLE;
+    }
+
+    candidates = g_ptr_array_new ();
+    nautilus_icon_grid_query (container->details->icon_grid,
+                              min_x, min_y, max_x, max_y,
+                              candidates);
+
+    /* Prioritize from the bottom up, so the thumbnails at the top of
+     * the view are made first.
      */
-    for (node = g_list_last (container->details->icons); node != NULL; node = node->prev) {
-        icon = node->data;
-
-        if (icon_is_positioned (icon)) {
-            eel_canvas_item_get_bounds (EEL_CANVAS_ITEM (icon->item),
-                                        &x0,
-                                        &y0,
-                                        &x1,
-                                        &y1);
-            eel_canvas_item_i2w (EEL_CANVAS_ITEM (icon->item)->parent,
-                                 &x0,
-                                 &y0);
-            eel_canvas_item_i2w (EEL_CANVAS_ITEM (icon->item)->parent,
-                                 &x1,
-                                 &y1);
-
-            if (nautilus_icon_container_is_layout_vertical (container)) {
-                visible = x1 >= min_x && x0 <= max_x;
-            } else {
-                visible = y1 >= min_y && y0 <= max_y;
-            }
+    g_ptr_array_sort_with_data (candidates,
+                                compare_icons_reverse_render_order,
+                                GINT_TO_POINTER (vertical));
+
+    visible_icons = g_hash_table_new (g_direct_hash, g_direct_equal);
+
+    for (i = 0; i < candidates->len; i++) {
+        icon = g_ptr_array_index (candidates, i);
+
+        eel_canvas_item_get_bounds (EEL_CANVAS_ITEM (icon->item),
+                                    &x0,
+                                    &y0,
+                                    &x1,
+                                    &y1);
+        eel_canvas_item_i2w (EEL_CANVAS_ITEM (icon->item)->parent,
+                             &x0,
+                             &y0);
+        eel_canvas_item_i2w (EEL_CANVAS_ITEM (icon->item)->parent,
+                             &x1,
+                             &y1);
+
+        if (vertical) {
+            visible = x1 >= min_x && x0 <= max_x;
+        } else {
+            visible = y1 >= min_y && y0 <= max_y;
+        }
 
-            if (visible) {
-                nautilus_icon_canvas_item_set_is_visible (icon->item, TRUE);
-                nautilus_icon_container_prioritize_thumbnailing (container,
-                                                                 icon);
-            }
-            else {
-                nautilus_icon_canvas_item_set_is_visible (icon->item, FALSE);
-            }
+        if (visible) {
+            g_hash_table_add (visible_icons, icon);
+            nautilus_icon_canvas_item_set_is_visible (icon->item, TRUE);
+            nautilus_icon_container_prioritize_thumbnailing (container,
+                                                             icon);
         }
     }
+
+    /* Hide what scrolled out of view since the last update */
+    g_hash_table_iter_init (&iter, container->details->visible_icons);
+    while (g_hash_table_iter_next (&iter, (void **) &icon, NULL)) {
+        if (!g_hash_table_contains (visible_icons, icon)) {
+            nautilus_icon_canvas_item_set_is_visible (icon->item, FALSE);
+            nautilus_icon_container_deprioritize_thumbnailing (container,
+                                                               icon);
+        }
+    }
+
+    g_hash_table_destroy (container->details->visible_icons);
+    container->details->visible_icons = visible_icons;
+
+    g_ptr_array_free (candidates, TRUE);
 }
 
 static void
@@ -7086,6 +7344,12 @@ nautilus_icon_container_update_icon (NautilusIconContainer *container,
 	nautilus_icon_canvas_item_set_embedded_text_rect (icon->item, &embedded_text_rect);
 	nautilus_icon_canvas_item_set_embedded_text (icon->item, embedded_text);
 
+	/* New text or image may reach further than the grid expects */
+	icon_update_grid (container, icon);
+
+	/* A renamed file shows up here too */
+	icon_update_uri (container, icon);
+
 	/* Let the pixbufs go. */
 	g_object_unref (pixbuf);
 
@@ -7309,6 +7573,7 @@ nautilus_icon_container_add (NautilusIconContainer *container,
 	details->new_icons = g_list_prepend (details->new_icons, icon);
 
 	g_hash_table_insert (details->icon_set, data, icon);
+	icon_update_uri (container, icon);
 
 	details->needs_resort = TRUE;
 
@@ -7740,34 +8005,34 @@ NautilusIcon *
 nautilus_icon_container_get_icon_by_uri (NautilusIconContainer *container,
 					 const char *uri)
 {
-	NautilusIconContainerDetails *details;
-	GList *p;
-
-	/* Eventually, we must avoid searching the entire icon list,
-	   but it's OK for now.
-	   A hash table mapping uri to icon is one possibility.
-	*/
-
-	details = container->details;
-
-	for (p = details->icons; p != NULL; p = p->next) {
-		NautilusIcon *icon;
-		char *icon_uri;
-		_Bool    is_match;
-
-		icon = p->data;
+	return g_hash_table_lookup (container->details->icon_uris, uri);
+}
 
-		icon_uri = nautilus_icon_container_get_icon_uri
-			(container, icon);
-		is_match = strcmp (uri, icon_uri) == 0;
-		g_free (icon_uri);
+/**
+ * nautilus_icon_container_get_icons_by_uri:
+ * @container: An icon container widget.
+ * @uris: A list of URIs.
+ *
+ * Locate the icons for a list of URIs, skipping URIs that have no
+ * icon. The icons are returned in the order of @uris.
+ * The caller frees the list with g_list_free.
+ **/
+GList *
+nautilus_icon_container_get_icons_by_uri (NautilusIconContainer *container,
+					  GList *uris)
+{
+	NautilusIcon *icon;
+	GList *icons, *l;
 
-		if (is_match) {
-			return icon;
+	icons = NULL;
+	for (l = uris; l != NULL; l = l->next) {
+		icon = g_hash_table_lookup (container->details->icon_uris, l->data);
+		if (icon != NULL) {
+			icons = g_list_prepend (icons, icon);
 		}
 	}
 
-	return NULL;
+	return g_list_reverse (icons);
 }
 
 static NautilusIcon *
@@ -152,6 +152,10 @@ typedef struct {
 	int          (* compare_icons_by_name)    (NautilusIconContainer *container,
 						   NautilusIconData *icon_a,
 						   NautilusIconData *icon_b);
+	/* Optional, sorts @data into the order of compare_icons */
+	void         (* sort_icon_data)           (NautilusIconContainer *container,
+						   NautilusIconData **data,
+						   unsigned int n_data);
 	void         (* freeze_updates)           (NautilusIconContainer *container);
 	void         (* unfreeze_updates)         (NautilusIconContainer *container);
 	void         (* start_monitor_top_left)   (NautilusIconContainer *container,
@@ -163,6 +167,8 @@ typedef struct {
 						   gconstpointer client);
 	void         (* prioritize_thumbnailing)  (NautilusIconContainer *container,
 						   NautilusIconData *data);
+	void         (* deprioritize_thumbnailing) (NautilusIconContainer *container,
+						    NautilusIconData *data);
 
 	/* Queries on icons for subclass/client.
 	 * These must be implemented => These are signals !
@@ -531,7 +531,9 @@ static NautilusIcon *
 nautilus_icon_container_item_at (NautilusIconContainer *container,
 				 int x, int y)
 {
-	GList *p;
+	GPtrArray *candidates;
+	NautilusIcon *icon, *hit;
+	unsigned int i;
 	int size;
 	EelDRect point;
 	EelIRect canvas_point;
@@ -546,26 +548,34 @@ nautilus_icon_container_item_at (NautilusIconContainer *container,
 	point.x1 = x + size;
 	point.y1 = y + size;
 
-	for (p = container->details->icons; p != NULL; p = p->next) {
-		NautilusIcon *icon;
-		icon = p->data;
-
-		eel_canvas_w2c (EEL_CANVAS (container),
-				point.x0,
-				point.y0,
-				&canvas_point.x0,
-				&canvas_point.y0);
-		eel_canvas_w2c (EEL_CANVAS (container),
-				point.x1,
-				point.y1,
-				&canvas_point.x1,
-				&canvas_point.y1);
+	eel_canvas_w2c (EEL_CANVAS (container),
+			point.x0,
+			point.y0,
+			&canvas_point.x0,
+			&canvas_point.y0);
+	eel_canvas_w2c (EEL_CANVAS (container),
+			point.x1,
+			point.y1,
+			&canvas_point.x1,
+			&canvas_point.y1);
+
+	candidates = g_ptr_array_new ();
+	nautilus_icon_grid_query (container->details->icon_grid,
+				  point.x0, point.y0, point.x1, point.y1,
+				  candidates);
+
+	hit = NULL;
+	for (i = 0; i < candidates->len; i++) {
+		icon = g_ptr_array_index (candidates, i);
 		if (nautilus_icon_canvas_item_hit_test_rectangle (icon->item, canvas_point)) {
-			return icon;
+			hit = icon;
+			break;
 		}
 	}
 
-	return NULL;
+	g_ptr_array_free (candidates, TRUE);
+
+	return hit;
 }
 
 static char *
@@ -788,12 +798,15 @@ static void
 handle_local_move (NautilusIconContainer *container,
                    double world_x, double world_y)
 {
-	GList *moved_icons, *p;
+	GList *moved_icons, *uris, *icons, *p, *l;
+	GHashTable *found;
 	NautilusDragSelectionItem *item;
 	NautilusIcon *icon;
+	NautilusFile *file;
 	char screen_string[32];
 	GdkScreen *screen;
 	time_t now;
+	int monitor;
 
 	if (container->details->auto_layout) {
 		return;
@@ -801,28 +814,36 @@ handle_local_move (NautilusIconContainer *container,
 
 	time (&now);
 
-	/* Move and select the icons. */
-	moved_icons = NULL;
+	uris = NULL;
 	for (p = container->details->dnd_info->drag_info.selection_list; p != NULL; p = p->next) {
+		item = p->data;
+		uris = g_list_prepend (uris, item->uri);
+	}
+	uris = g_list_reverse (uris);
 
-        NautilusFile *file;
-        int monitor;
+	icons = nautilus_icon_container_get_icons_by_uri (container, uris);
 
-		item = p->data;
+	if (g_list_length (icons) < g_list_length (uris)) {
+		/* probably dragged from another screen.  Add the missing
+		 * ones to this screen
+		 */
+		found = g_hash_table_new (g_str_hash, g_str_equal);
+		for (l = icons; l != NULL; l = l->next) {
+			icon = l->data;
+			g_hash_table_insert (found, icon->uri, icon);
+		}
 
-		icon = nautilus_icon_container_get_icon_by_uri
-			(container, item->uri);
+		screen = gtk_widget_get_screen (GTK_WIDGET (container));
+		g_snprintf (screen_string, sizeof (screen_string), "%d",
+			    gdk_screen_get_number (screen));
 
-		if (icon == NULL) {
-			/* probably dragged from another screen.  Add it to
-			 * this screen
-			 */
+		for (p = uris; p != NULL; p = p->next) {
+			if (g_hash_table_lookup (found, p->data) != NULL) {
+				continue;
+			}
 
-			file = nautilus_file_get_by_uri (item->uri);
+			file = nautilus_file_get_by_uri (p->data);
 
-			screen = gtk_widget_get_screen (GTK_WIDGET (container));
-			g_snprintf (screen_string, sizeof (screen_string), "%d",
-				    gdk_screen_get_number (screen));
 			nautilus_file_set_metadata (file,
 					NAUTILUS_METADATA_KEY_SCREEN,
 					NULL, screen_string);
@@ -830,18 +851,35 @@ handle_local_move (NautilusIconContainer *container,
 							 NAUTILUS_METADATA_KEY_ICON_POSITION_TIMESTAMP, now);
 
 			nautilus_icon_container_add (container, NAUTILUS_ICON_CONTAINER_ICON_DATA (file));
+		}
+		g_hash_table_destroy (found);
+
+		g_list_free (icons);
+		icons = nautilus_icon_container_get_icons_by_uri (container, uris);
+	}
 
-			icon = nautilus_icon_container_get_icon_by_uri
-				(container, item->uri);
+	monitor = nautilus_ui_get_monitor_for_widget (GTK_WIDGET (container));
+
+	/* Move and select the icons. Both lists are in drag order, the
+	 * icons only lack the items that could not be added.
+	 */
+	moved_icons = NULL;
+	l = icons;
+	for (p = container->details->dnd_info->drag_info.selection_list;
+	     p != NULL && l != NULL; p = p->next) {
+		item = p->data;
+		icon = l->data;
+
+		if (strcmp (icon->uri, item->uri) != 0) {
+			continue;
 		}
+		l = l->next;
 
-        if (file == NULL)
-            file = NAUTILUS_FILE (icon->data);
+		file = NAUTILUS_FILE (icon->data);
 
-        //nautilus_file_set_is_desktop_orphan (file, FALSE);
+		//nautilus_file_set_is_desktop_orphan (file, FALSE);
 
-        monitor = nautilus_ui_get_monitor_for_widget (GTK_WIDGET (container));
-        nautilus_file_set_integer_metadata (file, NAUTILUS_METADATA_KEY_MONITOR, 0, monitor);
+		nautilus_file_set_integer_metadata (file, NAUTILUS_METADATA_KEY_MONITOR, 0, monitor);
 
 		if (item->got_icon_position) {
 			nautilus_icon_container_move_icon
@@ -857,6 +895,8 @@ handle_local_move (NautilusIconContainer *container,
 	/* Might have been moved in a way that requires adjusting scroll region. */
 	nautilus_icon_container_update_scroll_region (container);
 	g_list_free (moved_icons);
+	g_list_free (icons);
+	g_list_free (uris);
 }
 
 static void
@@ -0,0 +1,338 @@
+/* -*- Mode: C; indent-tabs-mode: t; c-basic-offset: 8; tab-width: 8 -*-
+
+   nautilus-icon-grid.c: Spatial index of the icons in an icon container.
+
+   Copyright (C) 2026 Nautilus contributors
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 2 of the
+   License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public
+   License along with this program; if not, write to the
+   Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+   Boston, MA 02111-1307, USA.
+*/
+
+#include <config.h>
+#include "nautilus-icon-grid.h"
+
+#include <math.h>
+
+typedef struct {
+	gint64 key;
+	GPtrArray *entries;
+} GridCell;
+
+typedef struct {
+	void *item;
+	double x, y;
+	GridCell *cell;
+	unsigned int index; /* in cell->entries */
+} GridEntry;
+
+struct NautilusIconGrid {
+	double cell_size;
+
+	GHashTable *entries; /* item -> GridEntry */
+	GHashTable *cells;   /* &GridCell.key -> GridCell */
+
+	/* Cells that ever held an item since the last clear */
+	int min_cx, max_cx;
+	int min_cy, max_cy;
+
+	/* How far bounds reach from the position, all >= 0 */
+	double left, top, right, bottom;
+};
+
+static void
+grid_cell_free (GridCell *cell)
+{
+	g_ptr_array_free (cell->entries, TRUE);
+	g_slice_free (GridCell, cell);
+}
+
+static void
+grid_entry_free (GridEntry *entry)
+{
+	g_slice_free (GridEntry, entry);
+}
+
+static void
+reset_bounds (NautilusIconGrid *grid)
+{
+	grid->min_cx = G_MAXINT;
+	grid->min_cy = G_MAXINT;
+	grid->max_cx = G_MININT;
+	grid->max_cy = G_MININT;
+
+	grid->left = 0;
+	grid->top = 0;
+	grid->right = 0;
+	grid->bottom = 0;
+}
+
+NautilusIconGrid *
+nautilus_icon_grid_new (double cell_size)
+{
+	NautilusIconGrid *grid;
+
+	g_return_val_if_fail (cell_size > 0, NULL);
+
+	grid = g_new0 (NautilusIconGrid, 1);
+	grid->cell_size = cell_size;
+	grid->entries = g_hash_table_new_full (g_direct_hash, g_direct_equal,
+					       NULL, (GDestroyNotify) grid_entry_free);
+	grid->cells = g_hash_table_new_full (g_int64_hash, g_int64_equal,
+					     NULL, (GDestroyNotify) grid_cell_free);
+	reset_bounds (grid);
+
+	return grid;
+}
+
+void
+nautilus_icon_grid_free (NautilusIconGrid *grid)
+{
+	if (grid == NULL) {
+		return;
+	}
+
+	g_hash_table_destroy (grid->entries);
+	g_hash_table_destroy (grid->cells);
+	g_free (grid);
+}
+
+void
+nautilus_icon_grid_clear (NautilusIconGrid *grid)
+{
+	g_hash_table_remove_all (grid->entries);
+	g_hash_table_remove_all (grid->cells);
+	reset_bounds (grid);
+}
+
+int
+nautilus_icon_grid_get_n_items (NautilusIconGrid *grid)
+{
+	return g_hash_table_size (grid->entries);
+}
+
+/* Clamps first, so far away or infinite coordinates stay in range */
+static int
+get_cell_index (NautilusIconGrid *grid, double coordinate)
+{
+	double index;
+
+	index = floor (coordinate / grid->cell_size);
+
+	return (int) CLAMP (index, G_MININT / 2, G_MAXINT / 2);
+}
+
+static gint64
+get_cell_key (int cx, int cy)
+{
+	return (gint64) (((guint64) (guint32) cx << 32) | (guint32) cy);
+}
+
+static void
+remove_from_cell (NautilusIconGrid *grid, GridEntry *entry)
+{
+	GridCell *cell;
+	GridEntry *moved;
+
+	cell = entry->cell;
+
+	g_ptr_array_remove_index_fast (cell->entries, entry->index);
+	if (entry->index < cell->entries->len) {
+		moved = g_ptr_array_index (cell->entries, entry->index);
+		moved->index = entry->index;
+	}
+
+	entry->cell = NULL;
+
+	if (cell->entries->len == 0) {
+		g_hash_table_remove (grid->cells, &cell->key);
+	}
+}
+
+static void
+add_to_cell (NautilusIconGrid *grid, GridEntry *entry)
+{
+	GridCell *cell;
+	gint64 key;
+	int cx, cy;
+
+	cx = get_cell_index (grid, entry->x);
+	cy = get_cell_index (grid, entry->y);
+	key = get_cell_key (cx, cy);
+
+	cell = g_hash_table_lookup (grid->cells, &key);
+	if (cell == NULL) {
+		cell = g_slice_new (GridCell);
+		cell->key = key;
+		cell->entries = g_ptr_array_new ();
+		g_hash_table_insert (grid->cells, &cell->key, cell);
+	}
+
+	entry->cell = cell;
+	entry->index = cell->entries->len;
+	g_ptr_array_add (cell->entries, entry);
+
+	grid->min_cx = MIN (grid->min_cx, cx);
+	grid->max_cx = MAX (grid->max_cx, cx);
+	grid->min_cy = MIN (grid->min_cy, cy);
+	grid->max_cy = MAX (grid->max_cy, cy);
+}
+
+void
+nautilus_icon_grid_set_position (NautilusIconGrid *grid,
+				 void             *item,
+				 double            x,
+				 double            y)
+{
+	GridEntry *entry;
+
+	entry = g_hash_table_lookup (grid->entries, item);
+	if (entry == NULL) {
+		entry = g_slice_new0 (GridEntry);
+		entry->item = item;
+		g_hash_table_insert (grid->entries, item, entry);
+	} else if (entry->x == x && entry->y == y) {
+		return;
+	} else if (get_cell_index (grid, entry->x) == get_cell_index (grid, x) &&
+		   get_cell_index (grid, entry->y) == get_cell_index (grid, y)) {
+		/* Moved within its cell */
+		entry->x = x;
+		entry->y = y;
+		return;
+	} else {
+		remove_from_cell (grid, entry);
+	}
+
+	entry->x = x;
+	entry->y = y;
+	add_to_cell (grid, entry);
+}
+
+void
+nautilus_icon_grid_remove (NautilusIconGrid *grid,
+			   void             *item)
+{
+	GridEntry *entry;
+
+	entry = g_hash_table_lookup (grid->entries, item);
+	if (entry == NULL) {
+		return;
+	}
+
+	remove_from_cell (grid, entry);
+	g_hash_table_remove (grid->entries, item);
+}
+
+void
+nautilus_icon_grid_include_bounds (NautilusIconGrid *grid,
+				   double            x,
+				   double            y,
+				   double            x0,
+				   double            y0,
+				   double            x1,
+				   double            y1)
+{
+	grid->left = MAX (grid->left, x - x0);
+	grid->top = MAX (grid->top, y - y0);
+	grid->right = MAX (grid->right, x1 - x);
+	grid->bottom = MAX (grid->bottom, y1 - y);
+}
+
+static void
+query_cell (GridCell *cell,
+	    double px0, double py0,
+	    double px1, double py1,
+	    GPtrArray *items)
+{
+	GridEntry *entry;
+	unsigned int i;
+
+	for (i = 0; i < cell->entries->len; i++) {
+		entry = g_ptr_array_index (cell->entries, i);
+		if (entry->x >= px0 && entry->x <= px1 &&
+		    entry->y >= py0 && entry->y <= py1) {
+			g_ptr_array_add (items, entry->item);
+		}
+	}
+}
+
+void
+nautilus_icon_grid_query (NautilusIconGrid *grid,
+			  double            x0,
+			  double            y0,
+			  double            x1,
+			  double            y1,
+			  GPtrArray        *items)
+{
+	GHashTableIter iter;
+	GridCell *cell;
+	double px0, py0, px1, py1;
+	int cx0, cy0, cx1, cy1, cx, cy;
+	gint64 key;
+
+	if (g_hash_table_size (grid->cells) == 0) {
+		return;
+	}
+
+	/* The positions an item may have and still reach the rectangle */
+	px0 = x0 - grid->right;
+	px1 = x1 + grid->left;
+	py0 = y0 - grid->bottom;
+	py1 = y1 + grid->top;
+
+	cx0 = MAX (get_cell_index (grid, px0), grid->min_cx);
+	cx1 = MIN (get_cell_index (grid, px1), grid->max_cx);
+	cy0 = MAX (get_cell_index (grid, py0), grid->min_cy);
+	cy1 = MIN (get_cell_index (grid, py1), grid->max_cy);
+
+	if (cx0 > cx1 || cy0 > cy1) {
+		return;
+	}
+
+	/* Sparse grids are cheaper to walk cell by cell */
+	if ((double) (cx1 - cx0 + 1) * (cy1 - cy0 + 1) > g_hash_table_size (grid->cells)) {
+		g_hash_table_iter_init (&iter, grid->cells);
+		while (g_hash_table_iter_next (&iter, NULL, (void **) &cell)) {
+			query_cell (cell, px0, py0, px1, py1, items);
+		}
+		return;
+	}
+
+	for (cy = cy0; cy <= cy1; cy++) {
+		for (cx = cx0; cx <= cx1; cx++) {
+			key = get_cell_key (cx, cy);
+			cell = g_hash_table_lookup (grid->cells, &key);
+			if (cell != NULL) {
+				query_cell (cell, px0, py0, px1, py1, items);
+			}
+		}
+	}
+}
+
+_Bool
+nautilus_icon_grid_covers (NautilusIconGrid *grid,
+			   double            x0,
+			   double            y0,
+			   double            x1,
+			   double            y1)
+{
+	if (g_hash_table_size (grid->cells) == 0) {
+		return TRUE;
+	}
+
+	return x0 <= grid->min_cx * grid->cell_size - grid->left &&
+	       y0 <= grid->min_cy * grid->cell_size - grid->top &&
+	       x1 >= (grid->max_cx + 1) * grid->cell_size + grid->right &&
+	       y1 >= (grid->max_cy + 1) * grid->cell_size + grid->bottom;
+}
@@ -0,0 +1,79 @@
+/* -*- Mode: C; indent-tabs-mode: t; c-basic-offset: 8; tab-width: 8 -*-
+
+   nautilus-icon-grid.h: Spatial index of the icons in an icon container.
+
+   Copyright (C) 2026 Nautilus contributors
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 2 of the
+   License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public
+   License along with this program; if not, write to the
+   Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+   Boston, MA 02111-1307, USA.
+*/
+
+#ifndef NAUTILUS_ICON_GRID_H
+#define NAUTILUS_ICON_GRID_H
+
+#include <glib.h>
+
+/* Buckets items by their position into square cells, so the items
+ * near a rectangle can be found without looking at all of them.
+ *
+ * Items are indexed by a single point, their position. The extent
+ * tells how far an item's bounds may reach from that point, queries
+ * are widened by it and return every item whose bounds may intersect
+ * the rectangle. Callers still test the real bounds.
+ */
+typedef struct NautilusIconGrid NautilusIconGrid;
+
+NautilusIconGrid *nautilus_icon_grid_new            (double            cell_size);
+void              nautilus_icon_grid_free           (NautilusIconGrid *grid);
+void              nautilus_icon_grid_clear          (NautilusIconGrid *grid);
+
+/* Adds @item, or moves it if it is already in the grid */
+void              nautilus_icon_grid_set_position   (NautilusIconGrid *grid,
+						     void             *item,
+						     double            x,
+						     double            y);
+void              nautilus_icon_grid_remove         (NautilusIconGrid *grid,
+						     void             *item);
+int               nautilus_icon_grid_get_n_items    (NautilusIconGrid *grid);
+
+/* Grows the extent so it covers an item at (@x, @y) with the given
+ * bounds. The extent never shrinks until the grid is cleared.
+ */
+void              nautilus_icon_grid_include_bounds (NautilusIconGrid *grid,
+						     double            x,
+						     double            y,
+						     double            x0,
+						     double            y0,
+						     double            x1,
+						     double            y1);
+
+/* Appends to @items every item whose bounds may intersect the
+ * rectangle, in no particular order.
+ */
+void              nautilus_icon_grid_query          (NautilusIconGrid *grid,
+						     double            x0,
+						     double            y0,
+						     double            x1,
+						     double            y1,
+						     GPtrArray        *items);
+
+/* TRUE if the rectangle contains the bounds of every item */
+_Bool             nautilus_icon_grid_covers         (NautilusIconGrid *grid,
+						     double            x0,
+						     double            y0,
+						     double            x1,
+						     double            y1);
+
+#endif /* NAUTILUS_ICON_GRID_H */
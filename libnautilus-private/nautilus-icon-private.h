@@ -27,6 +27,7 @@
 
 /* An Icon. */
 #include "eel/eel-glib-extensions.h"
+#include "nautilus-icon-grid.h"
 
 typedef struct {
 	/* Object represented by this icon. */
@@ -35,6 +36,9 @@ typedef struct {
 	/* Canvas item for the icon. */
 	NautilusIconCanvasItem *item;
 
+	/* URI the icon is indexed under in icon_uris. */
+	char *uri;
+
 	/* X/Y coordinates. */
 	double x, y;
 
@@ -119,6 +123,11 @@ struct NautilusIconContainerDetails {
 	GList *icons;
 	GList *new_icons;
 	GHashTable *icon_set;
+	GHashTable *icon_uris;
+
+	/* Positioned icons by location, and the icons last found visible */
+	NautilusIconGrid *icon_grid;
+	GHashTable *visible_icons;
 
 	/* Current icon for keyboard navigation. */
 	NautilusIcon *keyboard_focus;
@@ -283,6 +292,8 @@ struct NautilusIconContainerDetails {
 /* Private functions shared by mutiple files. */
 NautilusIcon *nautilus_icon_container_get_icon_by_uri             (NautilusIconContainer *container,
 								   const char            *uri);
+GList *       nautilus_icon_container_get_icons_by_uri            (NautilusIconContainer *container,
+								   GList                 *uris);
 void          nautilus_icon_container_move_icon                   (NautilusIconContainer *container,
 								   NautilusIcon          *icon,
 								   int                    x,
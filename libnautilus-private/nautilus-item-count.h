@@ -0,0 +1,37 @@
+/* -*- Mode: C; indent-tabs-mode: t; c-basic-offset: 8; tab-width: 8 -*-
+
+   nautilus-item-count.h: Item counts of local directories.
+
+   Copyright (C) 2026 Nautilus contributors
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 2 of the
+   License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public
+   License along with this program; if not, write to the
+   Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+   Boston, MA 02111-1307, USA.
+*/
+
+#ifndef NAUTILUS_ITEM_COUNT_H
+#define NAUTILUS_ITEM_COUNT_H
+
+#include <glib.h>
+
+/* Counts the entries of the local directory @path, other than "." and
+ * "..", straight from the directory stream. Results are cached by the
+ * device, inode and modification time of the directory, so counting an
+ * unchanged directory again only takes a stat. May be called from any
+ * thread. Returns FALSE if @path can not be read as a directory.
+ */
+_Bool nautilus_item_count_local_directory (const char *path,
+					   int        *count);
+
+#endif /* NAUTILUS_ITEM_COUNT_H */
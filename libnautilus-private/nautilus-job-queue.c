@@ -19,17 +19,22 @@
    Boston, MA 02110-1335, USA.
 */
 
+
 #include <config.h>
 
 #include <gio/gio.h>
 
 #include <nautilus-progress-info.h>
 
+#include "nautilus-global-preferences.h"
 #include "nautilus-job-queue.h"
 
 struct _NautilusJobQueuePriv {
-	GList *queued_jobs;
-    GList *running_jobs;
+    GQueue     *queued_jobs;      /* Job, in submission order */
+    GHashTable *jobs_by_info;     /* NautilusProgressInfo -> Job, queued or running */
+    GHashTable *jobs_by_data;     /* user_data -> Job, queued only */
+    GHashTable *running_jobs;     /* Job set */
+    GHashTable *running_per_fs;   /* id::filesystem -> number of running jobs */
 };
 
 enum {
@@ -42,22 +47,43 @@ typedef struct {
     void                 *user_data;
     NautilusProgressInfo *info;
     GCancellable         *cancellable;
+
+    GList                *queue_link;   /* in queued_jobs while queued */
+    GPtrArray            *filesystems;  /* distinct id::filesystem values */
+    int                   n_pending_lookups;
+    _Bool                 running;
 } Job;
 
+typedef struct {
+    NautilusJobQueue     *self;
+    NautilusProgressInfo *info;
+    Job                  *job;  /* only valid while info maps to it */
+} FilesystemLookup;
+
 static NautilusJobQueue *singleton = NULL;
 
 static unsigned int signals[LAST_SIGNAL] = { 0, };
 
 G_DEFINE_TYPE (NautilusJobQueue, nautilus_job_queue, G_TYPE_OBJECT);
 
+static void
+job_free (Job *job)
+{
+    g_ptr_array_free (job->filesystems, TRUE);
+    g_free (job);
+}
+
 static void
 nautilus_job_queue_finalize (GObject *obj)
 {
 	NautilusJobQueue *self = NAUTILUS_JOB_QUEUE (obj);
 
-	if (self->priv->queued_jobs != NULL) {
-		g_list_free_full (self->priv->queued_jobs, g_object_unref);
-	}
+	/* Every job, queued or running, is in jobs_by_info */
+	g_hash_table_destroy (self->priv->jobs_by_info);
+	g_hash_table_destroy (self->priv->jobs_by_data);
+	g_hash_table_destroy (self->priv->running_jobs);
+	g_hash_table_destroy (self->priv->running_per_fs);
+	g_queue_free (self->priv->queued_jobs);
 
 	G_OBJECT_CLASS (nautilus_job_queue_parent_class)->finalize (obj);
 }
@@ -88,8 +114,13 @@ nautilus_job_queue_init (NautilusJobQueue *self)
 	self->priv = G_TYPE_INSTANCE_GET_PRIVATE (self, NAUTILUS_TYPE_JOB_QUEUE,
 						  NautilusJobQueuePriv);
 
-    self->priv->queued_jobs = NULL;
-    self->priv->running_jobs = NULL;
+    self->priv->queued_jobs = g_queue_new ();
+    self->priv->jobs_by_info = g_hash_table_new_full (NULL, NULL, NULL,
+                                                      (GDestroyNotify) job_free);
+    self->priv->jobs_by_data = g_hash_table_new (NULL, NULL);
+    self->priv->running_jobs = g_hash_table_new (NULL, NULL);
+    self->priv->running_per_fs = g_hash_table_new_full (g_str_hash, g_str_equal,
+                                                        g_free, NULL);
 }
 
 static void
@@ -114,42 +145,200 @@ nautilus_job_queue_class_init (NautilusJobQueueClass *klass)
 	g_type_class_add_private (klass, sizeof (NautilusJobQueuePriv));
 }
 
-static gint
-compare_info_func (gconstpointer a,
-                   gconstpointer b)
+static int
+get_max_jobs_per_filesystem (void)
+{
+    int max_jobs;
+
+    max_jobs = g_settings_get_int (nautilus_preferences,
+                                   NAUTILUS_PREFERENCES_MAX_JOBS_PER_FILESYSTEM);
+
+    /* Zero, the default, means no limit */
+    return max_jobs > 0 ? max_jobs : G_MAXINT;
+}
+
+static int
+get_running_on_filesystem (NautilusJobQueue *self, const char *fs)
 {
-    Job *job = (Job*) a;
-    return (job->info == b) ? 0 : 1;
+    return GPOINTER_TO_INT (g_hash_table_lookup (self->priv->running_per_fs, fs));
 }
 
-static gint
-compare_job_data_func (gconstpointer a,
-                       gconstpointer b)
+static void
+account_job_filesystems (NautilusJobQueue *self, Job *job, int delta)
 {
-    Job *job = (Job*) a;
-    return (job->job_func == b) ? 0 : 1;
+    const char *fs;
+    unsigned int i;
+    int count;
+
+    for (i = 0; i < job->filesystems->len; i++) {
+        fs = g_ptr_array_index (job->filesystems, i);
+        count = get_running_on_filesystem (self, fs) + delta;
+
+        if (count > 0) {
+            g_hash_table_insert (self->priv->running_per_fs,
+                                 g_strdup (fs), GINT_TO_POINTER (count));
+        } else {
+            g_hash_table_remove (self->priv->running_per_fs, fs);
+        }
+    }
+}
+
+static void
+job_add_filesystem (Job *job, const char *fs)
+{
+    unsigned int i;
+
+    for (i = 0; i < job->filesystems->len; i++) {
+        if (g_strcmp0 (g_ptr_array_index (job->filesystems, i), fs) == 0) {
+            return;
+        }
+    }
+
+    g_ptr_array_add (job->filesystems, g_strdup (fs));
+}
+
+/* A job we cannot place gets a key of its own, so it neither waits for
+ * nor holds up any other job.
+ */
+static void
+job_add_unknown_filesystem (Job *job)
+{
+    char *fs;
+
+    fs = g_strdup_printf ("unknown:%p", job);
+    job_add_filesystem (job, fs);
+    g_free (fs);
 }
 
 static void
 job_finished_cb (NautilusJobQueue *self,
                  NautilusProgressInfo *info)
 {
-    GList *ptr;
+    Job *job;
+
+    job = g_hash_table_lookup (self->priv->jobs_by_info, info);
+    if (job == NULL) {
+        return;
+    }
 
-    ptr = g_list_find_custom (self->priv->running_jobs, info, (GCompareFunc) compare_info_func);
-    if (!ptr)
-        ptr = g_list_find_custom (self->priv->queued_jobs, info, (GCompareFunc) compare_info_func);
+    g_signal_handlers_disconnect_by_func (info, job_finished_cb, self);
 
-    Job *job = ptr->data;
+    if (job->running) {
+        g_hash_table_remove (self->priv->running_jobs, job);
+        if (job->n_pending_lookups == 0) {
+            account_job_filesystems (self, job, -1);
+        }
+    } else {
+        g_queue_delete_link (self->priv->queued_jobs, job->queue_link);
+        g_hash_table_remove (self->priv->jobs_by_data, job->user_data);
+    }
 
-    self->priv->running_jobs = g_list_remove (self->priv->running_jobs, job);
-    self->priv->queued_jobs = g_list_remove (self->priv->queued_jobs, job);
+    /* A lookup still in flight notices the job is gone by its absence */
+    g_hash_table_remove (self->priv->jobs_by_info, info);
 
     nautilus_job_queue_start_next_job (self);
 }
 
 static void start_job (NautilusJobQueue *self, Job *job);
 
+static void
+filesystem_lookup_cb (GObject      *source_object,
+                      GAsyncResult *res,
+                      void         *user_data)
+{
+    FilesystemLookup *lookup;
+    NautilusJobQueue *self;
+    GFileInfo *info;
+    const char *fs;
+    Job *job;
+    _Bool gone;
+
+    lookup = user_data;
+    self = lookup->self;
+    job = lookup->job;
+
+    /* The job may have finished, or been cancelled, meanwhile */
+    gone = g_hash_table_lookup (self->priv->jobs_by_info, lookup->info) != job;
+    g_object_unref (lookup->info);
+    g_free (lookup);
+
+    info = g_file_query_info_finish (G_FILE (source_object), res, NULL);
+
+    if (gone) {
+        if (info != NULL) {
+            g_object_unref (info);
+        }
+        g_object_unref (self);
+        return;
+    }
+
+    fs = NULL;
+    if (info != NULL) {
+        fs = g_file_info_get_attribute_string (info, G_FILE_ATTRIBUTE_ID_FILESYSTEM);
+    }
+    if (fs != NULL) {
+        job_add_filesystem (job, fs);
+    } else {
+        job_add_unknown_filesystem (job);
+    }
+
+    if (info != NULL) {
+        g_object_unref (info);
+    }
+
+    if (--job->n_pending_lookups == 0) {
+        if (job->running) {
+            /* Started with skip_queue before we knew where it goes */
+            account_job_filesystems (self, job, +1);
+        } else {
+            nautilus_job_queue_start_next_job (self);
+        }
+    }
+
+    g_object_unref (self);
+}
+
+/* Looks up the file systems of the locations the job touches */
+static void
+job_lookup_filesystems (NautilusJobQueue *self, Job *job, GList *locations)
+{
+    FilesystemLookup *lookup;
+    GHashTable *seen;
+    GFile *location;
+    GList *l;
+
+    seen = g_hash_table_new (g_file_hash, (GEqualFunc) g_file_equal);
+
+    for (l = locations; l != NULL; l = l->next) {
+        location = l->data;
+
+        if (g_hash_table_contains (seen, location)) {
+            continue;
+        }
+        g_hash_table_add (seen, location);
+
+        lookup = g_new0 (FilesystemLookup, 1);
+        lookup->self = g_object_ref (self);
+        lookup->info = g_object_ref (job->info);
+        lookup->job = job;
+        job->n_pending_lookups++;
+
+        g_file_query_info_async (location,
+                                 G_FILE_ATTRIBUTE_ID_FILESYSTEM,
+                                 0,
+                                 G_PRIORITY_DEFAULT,
+                                 NULL,
+                                 filesystem_lookup_cb,
+                                 lookup);
+    }
+
+    g_hash_table_destroy (seen);
+
+    if (job->n_pending_lookups == 0) {
+        job_add_unknown_filesystem (job);
+    }
+}
+
 NautilusJobQueue *
 nautilus_job_queue_get (void)
 {
@@ -164,7 +353,21 @@ nautilus_job_queue_add_new_job (NautilusJobQueue *self,
                             NautilusProgressInfo *info,
                             _Bool                 skip_queue)
 {
-	if (g_list_find_custom (self->priv->queued_jobs, user_data, (GCompareFunc) compare_job_data_func) != NULL) {
+    nautilus_job_queue_add_new_job_for_files (self, job_func, user_data,
+                                              cancellable, info,
+                                              NULL, skip_queue);
+}
+
+void
+nautilus_job_queue_add_new_job_for_files (NautilusJobQueue     *self,
+                                          GIOSchedulerJobFunc   job_func,
+                                          void                 *user_data,
+                                          GCancellable         *cancellable,
+                                          NautilusProgressInfo *info,
+                                          GList                *locations,
+                                          _Bool                 skip_queue)
+{
+	if (g_hash_table_lookup (self->priv->jobs_by_data, user_data) != NULL) {
 		g_warning ("Adding the same file job object to the job queue");
 		return;
 	}
@@ -174,15 +377,25 @@ nautilus_job_queue_add_new_job (NautilusJobQueue *self,
     new_job->user_data = user_data;
     new_job->cancellable = cancellable;
     new_job->info = info;
+    new_job->filesystems = g_ptr_array_new_with_free_func (g_free);
 
-	self->priv->queued_jobs =
-		g_list_append (self->priv->queued_jobs, new_job);
+    g_queue_push_tail (self->priv->queued_jobs, new_job);
+    new_job->queue_link = g_queue_peek_tail_link (self->priv->queued_jobs);
+    g_hash_table_insert (self->priv->jobs_by_info, info, new_job);
+    g_hash_table_insert (self->priv->jobs_by_data, user_data, new_job);
 
     nautilus_progress_info_queue (info);
 
 	g_signal_connect_swapped (info, "finished",
                               G_CALLBACK (job_finished_cb), self);
 
+    /* Without a limit nothing ever waits, so there is nothing to look up */
+    if (get_max_jobs_per_filesystem () == G_MAXINT) {
+        skip_queue = TRUE;
+    } else {
+        job_lookup_filesystems (self, new_job, locations);
+    }
+
     if (skip_queue)
         start_job (self, new_job);
     else
@@ -194,36 +407,82 @@ nautilus_job_queue_add_new_job (NautilusJobQueue *self,
 static void
 start_job (NautilusJobQueue *self, Job *job)
 {
-    self->priv->queued_jobs = g_list_remove (self->priv->queued_jobs, job);
+    g_queue_delete_link (self->priv->queued_jobs, job->queue_link);
+    job->queue_link = NULL;
+    g_hash_table_remove (self->priv->jobs_by_data, job->user_data);
+
+    job->running = TRUE;
+    g_hash_table_add (self->priv->running_jobs, job);
+    if (job->n_pending_lookups == 0) {
+        account_job_filesystems (self, job, +1);
+    }
 
     g_io_scheduler_push_job (job->job_func,
                              job->user_data,
                              NULL, // destroy notify
                              0,
                              job->cancellable);
-
-    self->priv->running_jobs = g_list_append (self->priv->running_jobs, job);
 }
 
+/* Starts every queued job whose file systems all have room. A file
+ * system wanted by a job that has to wait is reserved for it, so later
+ * jobs only overtake it when they do not touch the same devices.
+ */
 void
 nautilus_job_queue_start_next_job (NautilusJobQueue *self)
 {
-    if (g_list_length (self->priv->running_jobs) == 0 && g_list_length (self->priv->queued_jobs) > 0)
-        start_job (self, self->priv->queued_jobs->data);
+    GHashTable *reserved;
+    GList *l, *next;
+    const char *fs;
+    unsigned int i;
+    int max_jobs;
+    _Bool can_start;
+    Job *job;
+
+    if (g_queue_is_empty (self->priv->queued_jobs))
+        return;
+
+    max_jobs = get_max_jobs_per_filesystem ();
+    reserved = g_hash_table_new (g_str_hash, g_str_equal);
+
+    for (l = self->priv->queued_jobs->head; l != NULL; l = next) {
+        next = l->next;
+        job = l->data;
+
+        /* Not known yet where it goes, nothing to reserve */
+        if (job->n_pending_lookups > 0)
+            continue;
+
+        can_start = TRUE;
+        for (i = 0; i < job->filesystems->len && can_start; i++) {
+            fs = g_ptr_array_index (job->filesystems, i);
+            can_start = !g_hash_table_contains (reserved, fs) &&
+                get_running_on_filesystem (self, fs) < max_jobs;
+        }
+
+        if (can_start) {
+            start_job (self, job);
+        } else {
+            for (i = 0; i < job->filesystems->len; i++)
+                g_hash_table_add (reserved, g_ptr_array_index (job->filesystems, i));
+        }
+    }
+
+    g_hash_table_destroy (reserved);
 }
 
 void
 nautilus_job_queue_start_job_by_info (NautilusJobQueue     *self,
                                   NautilusProgressInfo *info)
 {
-    GList *target = g_list_find_custom (self->priv->queued_jobs, info, (GCompareFunc) compare_info_func);
+    Job *job = g_hash_table_lookup (self->priv->jobs_by_info, info);
 
-    if (target)
-        start_job (self, target->data);
+    if (job && !job->running)
+        start_job (self, job);
 }
 
 GList *
 nautilus_job_queue_get_all_jobs (NautilusJobQueue *self)
 {
-	return self->priv->queued_jobs;
+	return self->priv->queued_jobs->head;
 }
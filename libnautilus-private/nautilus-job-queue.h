@@ -59,6 +59,18 @@ void nautilus_job_queue_add_new_job (NautilusJobQueue     *self,
                                      NautilusProgressInfo *info,
                                      _Bool                 skip_queue);
 
+/* Like nautilus_job_queue_add_new_job(), with the locations the job
+ * touches; the file system of each one is looked up as given. Jobs only
+ * wait for jobs on the same file systems.
+ */
+void nautilus_job_queue_add_new_job_for_files (NautilusJobQueue     *self,
+                                               GIOSchedulerJobFunc   job_func,
+                                               void                 *user_data,
+                                               GCancellable         *cancellable,
+                                               NautilusProgressInfo *info,
+                                               GList                *locations,
+                                               _Bool                 skip_queue);
+
 void nautilus_job_queue_start_next_job    (NautilusJobQueue *self);
 
 void nautilus_job_queue_start_job_by_info (NautilusJobQueue     *self,
@@ -62,17 +62,6 @@ nautilus_monitor_active (void)
 	return monitor_success;
 }
 
-static _Bool call_consume_changes_idle_id = 0;
-
-/* Is really _Bool but glib errently defines gboolean as int */
-static int
-call_consume_changes_idle_cb (void *not_used)
-{
-	nautilus_file_changes_consume_changes (TRUE);
-	call_consume_changes_idle_id = 0;
-	return FALSE;
-}
-
 static void
 dir_changed (GFileMonitor* monitor,
 	     GFile *child,
@@ -80,14 +69,6 @@ dir_changed (GFileMonitor* monitor,
 	     GFileMonitorEvent event_type,
 	     gpointer user_data)
 {
-	char *uri, *to_uri;
-
-	uri = g_file_get_uri (child);
-	to_uri = NULL;
-	if (other_file) {
-		to_uri = g_file_get_uri (other_file);
-	}
-
 	switch (event_type) {
 	default:
 	case G_FILE_MONITOR_EVENT_CHANGED:
@@ -111,14 +92,6 @@ dir_changed (GFileMonitor* monitor,
 		/* TODO: Do something */
 		break;
 	}
-
-	g_free (uri);
-	g_free (to_uri);
-
-	if (call_consume_changes_idle_id == 0) {
-		call_consume_changes_idle_id =
-			g_idle_add (call_consume_changes_idle_cb, NULL);
-	}
 }
 
 NautilusMonitor *
@@ -33,12 +33,22 @@
 
 #include <eel/eel-glib-extensions.h>
 
+/* Folded names longer than this take the allocating path, which is
+ * more than NAME_MAX even after decomposition of typical names.
+ */
+#define MATCHER_BUFFER_SIZE 1024
+
 struct NautilusQueryDetails {
 	char *text;
 	char *location_uri;
 	GList *mime_types;
 };
 
+struct NautilusQueryMatcher {
+	char **words;        /* NFD, lower case, no empty words */
+	_Bool all_ascii;     /* TRUE if every word is plain ASCII */
+};
+
 static void  nautilus_query_class_init       (NautilusQueryClass *class);
 static void  nautilus_query_init             (NautilusQuery      *query);
 
@@ -128,6 +138,213 @@ nautilus_query_add_mime_type (NautilusQuery *query, const char *mime_type)
 						    g_strdup (mime_type));
 }
 
+static inline _Bool
+str_is_ascii (const char *str, gsize *length)
+{
+	const unsigned char *p;
+
+	for (p = (const unsigned char *) str; *p != '\0'; p++) {
+		if (*p & 0x80) {
+			return FALSE;
+		}
+	}
+
+	*length = p - (const unsigned char *) str;
+
+	return TRUE;
+}
+
+/**
+ * nautilus_query_compile_matcher:
+ * @query: a #NautilusQuery
+ *
+ * Splits the query text into words and folds them the same way
+ * nautilus_query_matcher_matches() folds file names. The matcher
+ * does not change after creation so it can be shared between threads.
+ *
+ * Returns: a new matcher, free with nautilus_query_matcher_free().
+ */
+NautilusQueryMatcher *
+nautilus_query_compile_matcher (NautilusQuery *query)
+{
+	NautilusQueryMatcher *matcher;
+	char *folded, *normalized, *lower, **words;
+	GPtrArray *kept;
+	gsize length;
+	int i;
+
+	matcher = g_new0 (NautilusQueryMatcher, 1);
+	matcher->all_ascii = TRUE;
+
+	kept = g_ptr_array_new ();
+
+	if (query->details->text != NULL) {
+		/* Fold exactly like the names will be folded */
+		folded = g_malloc (MATCHER_BUFFER_SIZE);
+		if (nautilus_query_fold_name (query->details->text, folded, MATCHER_BUFFER_SIZE)) {
+			words = g_strsplit (folded, " ", -1);
+		} else {
+			normalized = g_utf8_normalize (query->details->text, -1, G_NORMALIZE_NFD);
+			lower = g_utf8_strdown (normalized, -1);
+			words = g_strsplit (lower, " ", -1);
+			g_free (normalized);
+			g_free (lower);
+		}
+		g_free (folded);
+
+		for (i = 0; words[i] != NULL; i++) {
+			if (words[i][0] == '\0') {
+				g_free (words[i]);
+				continue;
+			}
+			if (!str_is_ascii (words[i], &length)) {
+				matcher->all_ascii = FALSE;
+			}
+			g_ptr_array_add (kept, words[i]);
+		}
+		g_free (words);
+	}
+
+	g_ptr_array_add (kept, NULL);
+	matcher->words = (char **) g_ptr_array_free (kept, FALSE);
+
+	return matcher;
+}
+
+void
+nautilus_query_matcher_free (NautilusQueryMatcher *matcher)
+{
+	if (matcher == NULL) {
+		return;
+	}
+
+	g_strfreev (matcher->words);
+	g_free (matcher);
+}
+
+static _Bool
+folded_name_matches (NautilusQueryMatcher *matcher, const char *folded)
+{
+	int i;
+
+	for (i = 0; matcher->words[i] != NULL; i++) {
+		if (strstr (folded, matcher->words[i]) == NULL) {
+			return FALSE;
+		}
+	}
+
+	return TRUE;
+}
+
+const char * const *
+nautilus_query_matcher_get_words (NautilusQueryMatcher *matcher)
+{
+	return (const char * const *) matcher->words;
+}
+
+static _Bool
+fold_utf8_name (const char *name, char *buffer, gsize buffer_size)
+{
+	gunichar decomposition[G_UNICHAR_MAX_DECOMPOSITION_LENGTH];
+	const char *p;
+	gsize used, n, i;
+	char utf8[6];
+	int len;
+
+	used = 0;
+
+	for (p = name; *p != '\0'; p = g_utf8_next_char (p)) {
+		n = g_unichar_fully_decompose (g_utf8_get_char (p), FALSE,
+					       decomposition,
+					       G_UNICHAR_MAX_DECOMPOSITION_LENGTH);
+		for (i = 0; i < n; i++) {
+			len = g_unichar_to_utf8 (g_unichar_tolower (decomposition[i]), utf8);
+			if (used + len >= buffer_size) {
+				return FALSE;
+			}
+			memcpy (buffer + used, utf8, len);
+			used += len;
+		}
+	}
+
+	buffer[used] = '\0';
+
+	return TRUE;
+}
+
+/**
+ * nautilus_query_fold_name:
+ * @name: a file display name, in UTF-8
+ * @buffer: where to store the folded name
+ * @buffer_size: size of @buffer
+ *
+ * Decomposes and lower cases @name the way the words of a compiled
+ * query are folded, without allocating. Pure ASCII names are only
+ * lower cased.
+ *
+ * Returns: FALSE if the folded name does not fit in @buffer.
+ */
+_Bool
+nautilus_query_fold_name (const char *name, char *buffer, gsize buffer_size)
+{
+	gsize length, i;
+
+	/* Pure ASCII names are already in NFD, folding is a table lookup */
+	if (str_is_ascii (name, &length)) {
+		if (length >= buffer_size) {
+			return FALSE;
+		}
+
+		for (i = 0; i < length; i++) {
+			buffer[i] = g_ascii_tolower (name[i]);
+		}
+		buffer[length] = '\0';
+
+		return TRUE;
+	}
+
+	return fold_utf8_name (name, buffer, buffer_size);
+}
+
+/**
+ * nautilus_query_matcher_matches:
+ * @matcher: a compiled query
+ * @name: a file display name, in UTF-8
+ *
+ * Returns: TRUE if every word of the query occurs in @name, ignoring case.
+ */
+_Bool
+nautilus_query_matcher_matches (NautilusQueryMatcher *matcher,
+				const char           *name)
+{
+	char buffer[MATCHER_BUFFER_SIZE];
+	char *normalized, *lower;
+	gsize length;
+	_Bool hit;
+
+	if (matcher->words[0] == NULL) {
+		return TRUE;
+	}
+
+	/* Non ASCII words can not occur in an ASCII name */
+	if (!matcher->all_ascii && str_is_ascii (name, &length)) {
+		return FALSE;
+	}
+
+	if (nautilus_query_fold_name (name, buffer, sizeof (buffer))) {
+		return folded_name_matches (matcher, buffer);
+	}
+
+	/* Only reached for absurdly long names */
+	normalized = g_utf8_normalize (name, -1, G_NORMALIZE_NFD);
+	lower = g_utf8_strdown (normalized, -1);
+	hit = folded_name_matches (matcher, lower);
+	g_free (normalized);
+	g_free (lower);
+
+	return hit;
+}
+
 char *
 nautilus_query_to_readable_string (NautilusQuery *query)
 {
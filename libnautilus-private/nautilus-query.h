@@ -44,6 +44,11 @@ typedef struct {
 	GObjectClass parent_class;
 } NautilusQueryClass;
 
+/* Case folded form of the query words, built once per search so that
+ * testing a file name against the query does not allocate.
+ */
+typedef struct NautilusQueryMatcher NautilusQueryMatcher;
+
 GType          nautilus_query_get_type (void);
 _Bool       nautilus_query_enabled  (void);
 
@@ -59,6 +64,15 @@ GList *        nautilus_query_get_mime_types     (NautilusQuery *query);
 void           nautilus_query_set_mime_types     (NautilusQuery *query, GList *mime_types);
 void           nautilus_query_add_mime_type      (NautilusQuery *query, const char *mime_type);
 
+NautilusQueryMatcher *nautilus_query_compile_matcher (NautilusQuery        *query);
+_Bool          nautilus_query_matcher_matches    (NautilusQueryMatcher *matcher,
+                                                  const char           *name);
+void           nautilus_query_matcher_free       (NautilusQueryMatcher *matcher);
+const char * const *nautilus_query_matcher_get_words (NautilusQueryMatcher *matcher);
+_Bool          nautilus_query_fold_name          (const char           *name,
+                                                  char                 *buffer,
+                                                  gsize                 buffer_size);
+
 char *         nautilus_query_to_readable_string (NautilusQuery *query);
 NautilusQuery *nautilus_query_load               (char *file);
 _Bool       nautilus_query_save               (NautilusQuery *query, char *file);
@@ -0,0 +1,391 @@
+/* -*- Mode: C; indent-tabs-mode: t; c-basic-offset: 8; tab-width: 8 -*- */
+/*
+ * Copyright (C) 2026 Nautilus contributors
+ *
+ * Nautilus is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * Nautilus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program; see the file COPYING.  If not,
+ * write to the Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ *
+ */
+
+#include <config.h>
+#include "nautilus-search-engine-index.h"
+#include "nautilus-search-engine-simple.h"
+#include "nautilus-search-index.h"
+
+#include <string.h>
+#include <glib.h>
+#include <gio/gio.h>
+
+#define BATCH_SIZE 500
+
+typedef struct {
+	NautilusSearchEngineIndex *engine;
+	GCancellable *cancellable;
+
+	NautilusQueryMatcher *matcher;
+	GList *mime_types;
+	char *root_path;
+
+	int n_processed_files;
+	GList *uri_hits;
+} IndexSearchData;
+
+struct NautilusSearchEngineIndexDetails {
+	NautilusQuery *query;
+
+	IndexSearchData *active_search;
+
+	/* Used for searches outside the indexed roots */
+	NautilusSearchEngine *fallback;
+	_Bool fallback_active;
+};
+
+G_DEFINE_TYPE (NautilusSearchEngineIndex, nautilus_search_engine_index,
+	       NAUTILUS_TYPE_SEARCH_ENGINE);
+
+static void
+finalize (GObject *object)
+{
+	NautilusSearchEngineIndex *index;
+
+	index = NAUTILUS_SEARCH_ENGINE_INDEX (object);
+
+	g_clear_object (&index->details->query);
+
+	if (index->details->fallback != NULL) {
+		g_signal_handlers_disconnect_matched (index->details->fallback,
+						      G_SIGNAL_MATCH_DATA,
+						      0, 0, NULL, NULL, index);
+		g_clear_object (&index->details->fallback);
+	}
+
+	G_OBJECT_CLASS (nautilus_search_engine_index_parent_class)->finalize (object);
+}
+
+static char *
+get_query_root_path (NautilusQuery *query)
+{
+	char *uri, *path;
+
+	uri = nautilus_query_get_location (query);
+	path = NULL;
+	if (uri != NULL) {
+		path = g_filename_from_uri (uri, NULL, NULL);
+		g_free (uri);
+	} else {
+		path = g_strdup ("/");
+	}
+
+	return path;
+}
+
+static void
+index_search_data_free (IndexSearchData *data)
+{
+	g_object_unref (data->cancellable);
+	nautilus_query_matcher_free (data->matcher);
+	g_list_free_full (data->mime_types, g_free);
+	g_list_free_full (data->uri_hits, g_free);
+	g_free (data->root_path);
+	g_free (data);
+}
+
+/* Is really _Bool but glib errently defines gboolean as int */
+static int
+search_done_idle (void *user_data)
+{
+	IndexSearchData *data;
+
+	data = user_data;
+
+	if (!g_cancellable_is_cancelled (data->cancellable)) {
+		nautilus_search_engine_finished (NAUTILUS_SEARCH_ENGINE (data->engine));
+		data->engine->details->active_search = NULL;
+	}
+
+	index_search_data_free (data);
+
+	return FALSE;
+}
+
+typedef struct {
+	GList *uris;
+	IndexSearchData *search_data;
+} SearchHits;
+
+/* Is really _Bool but glib errently defines gboolean as int */
+static int
+search_add_hits_idle (void *user_data)
+{
+	SearchHits *hits;
+
+	hits = user_data;
+
+	if (!g_cancellable_is_cancelled (hits->search_data->cancellable)) {
+		nautilus_search_engine_hits_added (NAUTILUS_SEARCH_ENGINE (hits->search_data->engine),
+						   hits->uris);
+	}
+
+	g_list_free_full (hits->uris, g_free);
+	g_free (hits);
+
+	return FALSE;
+}
+
+static void
+send_batch (IndexSearchData *data)
+{
+	SearchHits *hits;
+
+	data->n_processed_files = 0;
+
+	if (data->uri_hits) {
+		hits = g_new (SearchHits, 1);
+		hits->uris = data->uri_hits;
+		hits->search_data = data;
+		g_idle_add (search_add_hits_idle, hits);
+	}
+	data->uri_hits = NULL;
+}
+
+/* The index has no content types, guess from the name like the
+ * directory model does before it has sniffed a file.
+ */
+static _Bool
+mime_type_matches (IndexSearchData *data, const char *path, _Bool is_directory)
+{
+	char *content_type;
+	_Bool hit;
+	GList *l;
+
+	if (is_directory) {
+		content_type = g_strdup ("inode/directory");
+	} else {
+		content_type = g_content_type_guess (path, NULL, 0, NULL);
+	}
+
+	hit = FALSE;
+	for (l = data->mime_types; l != NULL; l = l->next) {
+		if (g_content_type_equals (content_type, l->data)) {
+			hit = TRUE;
+			break;
+		}
+	}
+
+	g_free (content_type);
+
+	return hit;
+}
+
+static _Bool
+index_hit (const char *path, _Bool is_directory, void *user_data)
+{
+	IndexSearchData *data;
+	char *uri;
+
+	data = user_data;
+
+	if (data->mime_types != NULL && !mime_type_matches (data, path, is_directory)) {
+		return TRUE;
+	}
+
+	uri = g_filename_to_uri (path, NULL, NULL);
+	if (uri != NULL) {
+		data->uri_hits = g_list_prepend (data->uri_hits, uri);
+	}
+
+	data->n_processed_files++;
+	if (data->n_processed_files > BATCH_SIZE) {
+		send_batch (data);
+	}
+
+	return !g_cancellable_is_cancelled (data->cancellable);
+}
+
+static void   *
+search_thread_func (void   * user_data)
+{
+	IndexSearchData *data;
+
+	data = user_data;
+
+	nautilus_search_index_query (data->matcher, data->root_path,
+				     data->cancellable, index_hit, data);
+	send_batch (data);
+
+	g_idle_add (search_done_idle, data);
+
+	return NULL;
+}
+
+static void
+fallback_hits_added (NautilusSearchEngine *fallback, GList *hits, void *user_data)
+{
+	nautilus_search_engine_hits_added (NAUTILUS_SEARCH_ENGINE (user_data), hits);
+}
+
+static void
+fallback_hits_subtracted (NautilusSearchEngine *fallback, GList *hits, void *user_data)
+{
+	nautilus_search_engine_hits_subtracted (NAUTILUS_SEARCH_ENGINE (user_data), hits);
+}
+
+static void
+fallback_finished (NautilusSearchEngine *fallback, void *user_data)
+{
+	NautilusSearchEngineIndex *index;
+
+	index = NAUTILUS_SEARCH_ENGINE_INDEX (user_data);
+	index->details->fallback_active = FALSE;
+
+	nautilus_search_engine_finished (NAUTILUS_SEARCH_ENGINE (index));
+}
+
+static void
+fallback_error (NautilusSearchEngine *fallback, const char *error_message, void *user_data)
+{
+	nautilus_search_engine_error (NAUTILUS_SEARCH_ENGINE (user_data), error_message);
+}
+
+static void
+start_fallback (NautilusSearchEngineIndex *index)
+{
+	NautilusSearchEngine *fallback;
+
+	if (index->details->fallback == NULL) {
+		fallback = nautilus_search_engine_simple_new ();
+		g_signal_connect (fallback, "hits-added",
+				  G_CALLBACK (fallback_hits_added), index);
+		g_signal_connect (fallback, "hits-subtracted",
+				  G_CALLBACK (fallback_hits_subtracted), index);
+		g_signal_connect (fallback, "finished",
+				  G_CALLBACK (fallback_finished), index);
+		g_signal_connect (fallback, "error",
+				  G_CALLBACK (fallback_error), index);
+		index->details->fallback = fallback;
+	}
+
+	index->details->fallback_active = TRUE;
+	nautilus_search_engine_set_query (index->details->fallback, index->details->query);
+	nautilus_search_engine_start (index->details->fallback);
+}
+
+static void
+nautilus_search_engine_index_start (NautilusSearchEngine *engine)
+{
+	NautilusSearchEngineIndex *index;
+	IndexSearchData *data;
+	GThread *thread;
+	char *root_path;
+
+	index = NAUTILUS_SEARCH_ENGINE_INDEX (engine);
+
+	if (index->details->active_search != NULL || index->details->fallback_active) {
+		return;
+	}
+
+	if (index->details->query == NULL) {
+		return;
+	}
+
+	root_path = get_query_root_path (index->details->query);
+	if (!nautilus_search_index_covers (root_path)) {
+		g_free (root_path);
+		start_fallback (index);
+		return;
+	}
+
+	data = g_new0 (IndexSearchData, 1);
+	data->engine = index;
+	data->cancellable = g_cancellable_new ();
+	data->matcher = nautilus_query_compile_matcher (index->details->query);
+	data->mime_types = nautilus_query_get_mime_types (index->details->query);
+	data->root_path = root_path;
+
+	thread = g_thread_new ("nautilus-search-index", search_thread_func, data);
+	index->details->active_search = data;
+
+	g_thread_unref (thread);
+}
+
+static void
+nautilus_search_engine_index_stop (NautilusSearchEngine *engine)
+{
+	NautilusSearchEngineIndex *index;
+
+	index = NAUTILUS_SEARCH_ENGINE_INDEX (engine);
+
+	if (index->details->active_search != NULL) {
+		g_cancellable_cancel (index->details->active_search->cancellable);
+		index->details->active_search = NULL;
+	}
+
+	if (index->details->fallback_active) {
+		nautilus_search_engine_stop (index->details->fallback);
+		index->details->fallback_active = FALSE;
+	}
+}
+
+static void
+nautilus_search_engine_index_set_query (NautilusSearchEngine *engine, NautilusQuery *query)
+{
+	NautilusSearchEngineIndex *index;
+
+	index = NAUTILUS_SEARCH_ENGINE_INDEX (engine);
+
+	if (query) {
+		g_object_ref (query);
+	}
+
+	if (index->details->query) {
+		g_object_unref (index->details->query);
+	}
+
+	index->details->query = query;
+}
+
+static void
+nautilus_search_engine_index_class_init (NautilusSearchEngineIndexClass *class)
+{
+	GObjectClass *gobject_class;
+	NautilusSearchEngineClass *engine_class;
+
+	gobject_class = G_OBJECT_CLASS (class);
+	gobject_class->finalize = finalize;
+
+	engine_class = NAUTILUS_SEARCH_ENGINE_CLASS (class);
+	engine_class->set_query = nautilus_search_engine_index_set_query;
+	engine_class->start = nautilus_search_engine_index_start;
+	engine_class->stop = nautilus_search_engine_index_stop;
+
+	g_type_class_add_private (class, sizeof (NautilusSearchEngineIndexDetails));
+}
+
+static void
+nautilus_search_engine_index_init (NautilusSearchEngineIndex *engine)
+{
+	engine->details = G_TYPE_INSTANCE_GET_PRIVATE (engine, NAUTILUS_TYPE_SEARCH_ENGINE_INDEX,
+						       NautilusSearchEngineIndexDetails);
+}
+
+NautilusSearchEngine *
+nautilus_search_engine_index_new (void)
+{
+	NautilusSearchEngine *engine;
+
+	engine = g_object_new (NAUTILUS_TYPE_SEARCH_ENGINE_INDEX, NULL);
+
+	return engine;
+}
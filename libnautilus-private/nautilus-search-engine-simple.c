@@ -25,26 +25,54 @@
 #include "nautilus-search-engine-simple.h"
 
 #include <string.h>
+#include <unistd.h>
 #include <glib.h>
 #include <gio/gio.h>
 
 #define BATCH_SIZE 500
 
+/* Upper bound on the number of directory walkers, enumerating is mostly
+ * I/O bound so this does not need to track the core count exactly.
+ */
+#define MAX_SEARCH_WORKERS 8
+
+/* How long an idle worker sleeps before looking for work to steal */
+#define IDLE_WAIT_USEC (10 * G_TIME_SPAN_MILLISECOND)
+
+typedef struct SearchThreadData SearchThreadData;
+
+/* Each worker owns a deque of directories. The owner pushes and pops at
+ * the head, which keeps it depth first inside its own subtree, while idle
+ * workers steal from the tail where the larger, older subtrees are.
+ */
 typedef struct {
+	SearchThreadData *data;
+	GMutex lock;
+	GQueue directories; /* GFiles */
+
+	int n_processed_files;
+	GList *uri_hits;
+} SearchWorker;
+
+struct SearchThreadData {
 	NautilusSearchEngineSimple *engine;
 	GCancellable *cancellable;
 
 	GList *mime_types;
-	char **words;
+	NautilusQueryMatcher *matcher;
 	GList *found_list;
 
-	GQueue *directories; /* GFiles */
+	SearchWorker *workers;
+	int n_workers;
+	int running_workers;     /* atomic */
+	int pending_directories; /* atomic, queued or being visited */
 
-	GHashTable *visited;
+	GMutex idle_lock;
+	GCond idle_cond;
 
-	int n_processed_files;
-	GList *uri_hits;
-} SearchThreadData;
+	GMutex visited_lock;
+	GHashTable *visited;
+};
 
 
 struct NautilusSearchEngineSimpleDetails {
@@ -73,18 +101,40 @@ finalize (GObject *object)
 	G_OBJECT_CLASS (nautilus_search_engine_simple_parent_class)->finalize (object);
 }
 
+static int
+get_n_search_workers (void)
+{
+	long n_cpus;
+
+	n_cpus = sysconf (_SC_NPROCESSORS_ONLN);
+
+	return CLAMP (n_cpus, 1, MAX_SEARCH_WORKERS);
+}
+
 static SearchThreadData *
 search_thread_data_new (NautilusSearchEngineSimple *engine, NautilusQuery *query)
 {
 	SearchThreadData *data;
-	char *text, *lower, *normalized, *uri;
+	char *uri;
 	GFile *location;
+	int i;
 
 	data = g_new0 (SearchThreadData, 1);
 
 	data->engine = engine;
-	data->directories = g_queue_new ();
 	data->visited = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+	g_mutex_init (&data->visited_lock);
+	g_mutex_init (&data->idle_lock);
+	g_cond_init (&data->idle_cond);
+
+	data->n_workers = get_n_search_workers ();
+	data->workers = g_new0 (SearchWorker, data->n_workers);
+	for (i = 0; i < data->n_workers; i++) {
+		data->workers[i].data = data;
+		g_mutex_init (&data->workers[i].lock);
+		g_queue_init (&data->workers[i].directories);
+	}
+
 	uri = nautilus_query_get_location (query);
 	location = NULL;
 	if (uri != NULL) {
@@ -94,15 +144,11 @@ search_thread_data_new (NautilusSearchEngineSimple *engine, NautilusQuery *query
 	if (location == NULL) {
 		location = g_file_new_for_path ("/");
 	}
-	g_queue_push_tail (data->directories, location);
+	/* The first worker starts with the root, the others steal from it */
+	g_queue_push_tail (&data->workers[0].directories, location);
+	data->pending_directories = 1;
 
-	text = nautilus_query_get_text (query);
-	normalized = g_utf8_normalize (text, -1, G_NORMALIZE_NFD);
-	lower = g_utf8_strdown (normalized, -1);
-	data->words = g_strsplit (lower, " ", -1);
-	g_free (text);
-	g_free (lower);
-	g_free (normalized);
+	data->matcher = nautilus_query_compile_matcher (query);
 
 	data->mime_types = nautilus_query_get_mime_types (query);
 
@@ -114,14 +160,26 @@ search_thread_data_new (NautilusSearchEngineSimple *engine, NautilusQuery *query
 static void
 search_thread_data_free (SearchThreadData *data)
 {
-	g_queue_foreach (data->directories,
-			 (GFunc)g_object_unref, NULL);
-	g_queue_free (data->directories);
+	SearchWorker *worker;
+	int i;
+
+	for (i = 0; i < data->n_workers; i++) {
+		worker = &data->workers[i];
+		g_queue_foreach (&worker->directories,
+				 (GFunc)g_object_unref, NULL);
+		g_queue_clear (&worker->directories);
+		g_list_free_full (worker->uri_hits, g_free);
+		g_mutex_clear (&worker->lock);
+	}
+	g_free (data->workers);
+
 	g_hash_table_destroy (data->visited);
+	g_mutex_clear (&data->visited_lock);
+	g_mutex_clear (&data->idle_lock);
+	g_cond_clear (&data->idle_cond);
 	g_object_unref (data->cancellable);
-	g_strfreev (data->words);
+	nautilus_query_matcher_free (data->matcher);
 	g_list_free_full (data->mime_types, g_free);
-	g_list_free_full (data->uri_hits, g_free);
 	g_free (data);
 }
 
@@ -168,20 +226,92 @@ search_thread_add_hits_idle (void *user_data)
 	return FALSE;
 }
 
+/* Hits are collected per worker so only the idle handoff, which is
+ * thread safe, is shared between workers.
+ */
 static void
-send_batch (SearchThreadData *data)
+send_batch (SearchWorker *worker)
 {
 	SearchHits *hits;
 
-	data->n_processed_files = 0;
+	worker->n_processed_files = 0;
 
-	if (data->uri_hits) {
+	if (worker->uri_hits) {
 		hits = g_new (SearchHits, 1);
-		hits->uris = data->uri_hits;
-		hits->thread_data = data;
+		hits->uris = worker->uri_hits;
+		hits->thread_data = worker->data;
 		g_idle_add (search_thread_add_hits_idle, hits);
 	}
-	data->uri_hits = NULL;
+	worker->uri_hits = NULL;
+}
+
+static void
+push_directory (SearchWorker *worker, GFile *dir)
+{
+	SearchThreadData *data;
+
+	data = worker->data;
+
+	g_atomic_int_inc (&data->pending_directories);
+
+	g_mutex_lock (&worker->lock);
+	g_queue_push_head (&worker->directories, dir);
+	g_mutex_unlock (&worker->lock);
+
+	g_mutex_lock (&data->idle_lock);
+	g_cond_signal (&data->idle_cond);
+	g_mutex_unlock (&data->idle_lock);
+}
+
+static GFile *
+pop_directory (SearchWorker *worker)
+{
+	GFile *dir;
+
+	g_mutex_lock (&worker->lock);
+	dir = g_queue_pop_head (&worker->directories);
+	g_mutex_unlock (&worker->lock);
+
+	return dir;
+}
+
+static GFile *
+steal_directory (SearchWorker *thief)
+{
+	SearchThreadData *data;
+	SearchWorker *victim;
+	GFile *dir;
+	int start, i;
+
+	data = thief->data;
+	start = thief - data->workers;
+	dir = NULL;
+
+	for (i = 1; dir == NULL && i < data->n_workers; i++) {
+		victim = &data->workers[(start + i) % data->n_workers];
+
+		g_mutex_lock (&victim->lock);
+		dir = g_queue_pop_tail (&victim->directories);
+		g_mutex_unlock (&victim->lock);
+	}
+
+	return dir;
+}
+
+/* Returns TRUE if the directory id was already seen by any worker */
+static _Bool
+mark_directory_visited (SearchThreadData *data, const char *id)
+{
+	_Bool visited;
+
+	g_mutex_lock (&data->visited_lock);
+	visited = g_hash_table_lookup_extended (data->visited, id, NULL, NULL);
+	if (!visited) {
+		g_hash_table_insert (data->visited, g_strdup (id), NULL);
+	}
+	g_mutex_unlock (&data->visited_lock);
+
+	return visited;
 }
 
 #define STD_ATTRIBUTES \
@@ -192,15 +322,14 @@ send_batch (SearchThreadData *data)
 	G_FILE_ATTRIBUTE_ID_FILE
 
 static void
-visit_directory (GFile *dir, SearchThreadData *data)
+visit_directory (GFile *dir, SearchWorker *worker)
 {
+	SearchThreadData *data = worker->data;
 	GFileEnumerator *enumerator;
 	GFileInfo *info;
 	GFile *child;
 	const char *mime_type, *display_name;
-	char *lower_name, *normalized;
 	_Bool hit;
-	int i;
 	GList *l;
 	const char *id;
 	_Bool visited;
@@ -228,18 +357,7 @@ visit_directory (GFile *dir, SearchThreadData *data)
 			goto next;
 		}
 
-		normalized = g_utf8_normalize (display_name, -1, G_NORMALIZE_NFD);
-		lower_name = g_utf8_strdown (normalized, -1);
-		g_free (normalized);
-
-		hit = TRUE;
-		for (i = 0; data->words[i] != NULL; i++) {
-			if (strstr (lower_name, data->words[i]) == NULL) {
-				hit = FALSE;
-				break;
-			}
-		}
-		g_free (lower_name);
+		hit = nautilus_query_matcher_matches (data->matcher, display_name);
 
 		if (hit && data->mime_types) {
 			mime_type = g_file_info_get_content_type (info);
@@ -256,28 +374,23 @@ visit_directory (GFile *dir, SearchThreadData *data)
 		child = g_file_get_child (dir, g_file_info_get_name (info));
 
 		if (hit) {
-			data->uri_hits = g_list_prepend (data->uri_hits, g_file_get_uri (child));
+			worker->uri_hits = g_list_prepend (worker->uri_hits, g_file_get_uri (child));
 		}
 
-		data->n_processed_files++;
-		if (data->n_processed_files > BATCH_SIZE) {
-			send_batch (data);
+		worker->n_processed_files++;
+		if (worker->n_processed_files > BATCH_SIZE) {
+			send_batch (worker);
 		}
 
 		if (g_file_info_get_file_type (info) == G_FILE_TYPE_DIRECTORY) {
 			id = g_file_info_get_attribute_string (info, G_FILE_ATTRIBUTE_ID_FILE);
 			visited = FALSE;
 			if (id) {
-				if (g_hash_table_lookup_extended (data->visited,
-								  id, NULL, NULL)) {
-					visited = TRUE;
-				} else {
-					g_hash_table_insert (data->visited, g_strdup (id), NULL);
-				}
+				visited = mark_directory_visited (data, id);
 			}
 
 			if (!visited) {
-				g_queue_push_tail (data->directories, g_object_ref (child));
+				push_directory (worker, g_object_ref (child));
 			}
 		}
 
@@ -290,37 +403,92 @@ visit_directory (GFile *dir, SearchThreadData *data)
 }
 
 
+static void   *
+search_worker_func (void   * user_data)
+{
+	SearchWorker *worker;
+	SearchThreadData *data;
+	GFile *dir;
+	gint64 end_time;
+
+	worker = user_data;
+	data = worker->data;
+
+	while (!g_cancellable_is_cancelled (data->cancellable)) {
+		dir = pop_directory (worker);
+		if (dir == NULL) {
+			dir = steal_directory (worker);
+		}
+
+		if (dir != NULL) {
+			visit_directory (dir, worker);
+			g_object_unref (dir);
+
+			if (g_atomic_int_dec_and_test (&data->pending_directories)) {
+				/* Wake everyone so they notice the walk is over */
+				g_mutex_lock (&data->idle_lock);
+				g_cond_broadcast (&data->idle_cond);
+				g_mutex_unlock (&data->idle_lock);
+			}
+			continue;
+		}
+
+		if (g_atomic_int_get (&data->pending_directories) == 0) {
+			break;
+		}
+
+		/* Someone is still visiting a directory and may push more
+		 * work, wait for it rather than spinning.
+		 */
+		end_time = g_get_monotonic_time () + IDLE_WAIT_USEC;
+		g_mutex_lock (&data->idle_lock);
+		g_cond_wait_until (&data->idle_cond, &data->idle_lock, end_time);
+		g_mutex_unlock (&data->idle_lock);
+	}
+	send_batch (worker);
+
+	/* The last worker out hands the search back to the main loop, after
+	 * every batch it and the others have queued.
+	 */
+	if (g_atomic_int_dec_and_test (&data->running_workers)) {
+		g_idle_add (search_thread_done_idle, data);
+	}
+
+	return NULL;
+}
+
 static void   *
 search_thread_func (void   * user_data)
 {
 	SearchThreadData *data;
 	GFile *dir;
 	GFileInfo *info;
+	GThread *thread;
 	const char *id;
+	int i;
 
 	data = user_data;
 
 	/* Insert id for toplevel directory into visited */
-	dir = g_queue_peek_head (data->directories);
+	dir = g_queue_peek_head (&data->workers[0].directories);
 	info = g_file_query_info (dir, G_FILE_ATTRIBUTE_ID_FILE, 0, data->cancellable, NULL);
 	if (info) {
 		id = g_file_info_get_attribute_string (info, G_FILE_ATTRIBUTE_ID_FILE);
 		if (id) {
-			g_hash_table_insert (data->visited, g_strdup (id), NULL);
+			mark_directory_visited (data, id);
 		}
 		g_object_unref (info);
 	}
 
-	while (!g_cancellable_is_cancelled (data->cancellable) &&
-	       (dir = g_queue_pop_head (data->directories)) != NULL) {
-		visit_directory (dir, data);
-		g_object_unref (dir);
+	/* This thread becomes worker 0 */
+	g_atomic_int_set (&data->running_workers, data->n_workers);
+	for (i = 1; i < data->n_workers; i++) {
+		thread = g_thread_new ("nautilus-search-simple-worker",
+				       search_worker_func, &data->workers[i]);
+		g_thread_unref (thread);
 	}
-	send_batch (data);
 
-	g_idle_add (search_thread_done_idle, data);
-
-	return NULL;
+	return search_worker_func (&data->workers[0]);
 }
 
 static void
@@ -23,7 +23,7 @@
 
 #include <config.h>
 #include "nautilus-search-engine.h"
-#include "nautilus-search-engine-simple.h"
+#include "nautilus-search-engine-index.h"
 
 #ifdef ENABLE_TRACKER
 #include "nautilus-search-engine-tracker.h"
@@ -103,7 +103,8 @@ nautilus_search_engine_new (void)
 	}
 #endif
 	
-	engine = nautilus_search_engine_simple_new ();
+	/* Falls back to crawling outside the indexed folders */
+	engine = nautilus_search_engine_index_new ();
 	return engine;
 }
 
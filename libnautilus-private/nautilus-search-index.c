@@ -0,0 +1,1269 @@
+/* -*- Mode: C; indent-tabs-mode: t; c-basic-offset: 8; tab-width: 8 -*-
+
+   nautilus-search-index.c: Persistent file name index for local search.
+
+   Copyright (C) 2026 Nautilus contributors
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 2 of the
+   License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public
+   License along with this program; if not, write to the
+   Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+   Boston, MA 02111-1307, USA.
+*/
+
+/* The index file is a header followed by four packed arrays:
+ *
+ *   entries   one per file, parent entry id, name offset and flags.
+ *             Roots have no parent and their name is the full path.
+ *   trigrams  every trigram of the folded names, sorted, with the
+ *             range of the postings array that lists its entries.
+ *   postings  entry ids, ascending within each trigram.
+ *   strings   the file names, NUL terminated.
+ *
+ * A query takes the rarest trigram of its words, checks each entry on
+ * that posting list with the compiled matcher and rebuilds the path
+ * by following the parent ids. Changes reported after the index was
+ * written are kept in an in-memory delta that queries apply on top.
+ */
+
+#include <config.h>
+#include "nautilus-search-index.h"
+
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#include <glib/gstdio.h>
+
+#include "nautilus-directory-notify.h"
+#include "nautilus-global-preferences.h"
+
+#define INDEX_MAGIC "NAUTIDX"
+#define INDEX_VERSION 1
+
+#define INDEX_NO_PARENT G_MAXUINT32
+
+/* Rebuild an index older than this, in seconds */
+#define INDEX_MAX_AGE (24 * 60 * 60)
+
+/* Shortest wait before the next refresh, so a rebuild that keeps
+ * failing does not run back to back */
+#define INDEX_MIN_REFRESH_DELAY (60 * 60)
+
+/* Rebuild once this many changes have piled up in the delta */
+#define INDEX_DELTA_REBUILD_THRESHOLD 50000
+
+#define INDEX_NAME_BUFFER_SIZE 1024
+#define INDEX_PATH_BUFFER_SIZE 4096
+#define INDEX_MAX_DEPTH 256
+
+/* How many candidates to check between looks at the cancellable */
+#define INDEX_CANCEL_CHECK_INTERVAL 4096
+
+enum {
+	INDEX_ENTRY_DIRECTORY = 1 << 0,
+	INDEX_ENTRY_ROOT = 1 << 1,
+	INDEX_ENTRY_UNKNOWN_TYPE = 1 << 2 /* delta only, looked up by the query */
+};
+
+typedef struct {
+	char magic[8];
+	guint32 version;
+	guint32 roots_hash;
+	gint64 build_time;
+	guint32 n_entries;
+	guint32 n_trigrams;
+	guint32 n_postings;
+	guint32 strings_size;
+} IndexHeader;
+
+typedef struct {
+	guint32 parent;
+	guint32 name;
+	guint32 flags;
+} IndexEntry;
+
+typedef struct {
+	guint32 trigram;
+	guint32 first;
+	guint32 count;
+} IndexTrigram;
+
+typedef struct {
+	int ref_count;
+	GMappedFile *mapped;
+	const IndexHeader *header;
+	const IndexEntry *entries;
+	const IndexTrigram *trigrams;
+	const guint32 *postings;
+	const char *strings;
+} IndexSnapshot;
+
+typedef struct {
+	GHashTable *added;   /* path -> INDEX_ENTRY_ flags, reported from the delta */
+	GHashTable *removed; /* path, hides it and everything below */
+	GHashTable *moved;   /* old path -> new path, for what is below */
+} IndexDelta;
+
+typedef struct {
+	char **roots;
+	guint32 roots_hash;
+} IndexBuildData;
+
+static GMutex index_lock;
+static IndexSnapshot *current_snapshot;
+static IndexDelta *current_delta;
+static IndexDelta *pending_delta; /* changes while a rebuild runs */
+static char **index_roots;
+static guint32 index_roots_hash;
+static _Bool rebuild_running;
+static unsigned int refresh_timeout_id;
+
+static void start_rebuild_locked (void);
+static void schedule_refresh_locked (void);
+
+static char *
+get_index_path (void)
+{
+	return g_build_filename (g_get_user_cache_dir (), "nautilus", "search-index", NULL);
+}
+
+static guint32
+get_roots_hash (char **roots)
+{
+	char *joined;
+	guint32 hash;
+
+	joined = g_strjoinv ("\n", roots);
+	hash = g_str_hash (joined);
+	g_free (joined);
+
+	return hash;
+}
+
+static _Bool
+path_has_prefix (const char *path, const char *prefix)
+{
+	gsize len;
+
+	len = strlen (prefix);
+	if (len > 0 && prefix[len - 1] == '/') {
+		len--;
+	}
+
+	return strncmp (path, prefix, len) == 0 &&
+		(path[len] == '\0' || path[len] == '/');
+}
+
+static _Bool
+path_is_below_roots (const char *path, char **roots)
+{
+	int i;
+
+	for (i = 0; roots != NULL && roots[i] != NULL; i++) {
+		if (path_has_prefix (path, roots[i])) {
+			return TRUE;
+		}
+	}
+
+	return FALSE;
+}
+
+/* Below a root and not hidden under it, the files the crawl indexes */
+static _Bool
+path_is_indexed (const char *path, char **roots)
+{
+	gsize len;
+	int i;
+
+	for (i = 0; roots != NULL && roots[i] != NULL; i++) {
+		if (!path_has_prefix (path, roots[i])) {
+			continue;
+		}
+
+		len = strlen (roots[i]);
+		if (len > 0 && roots[i][len - 1] == '/') {
+			len--;
+		}
+		if (strstr (path + len, "/.") == NULL) {
+			return TRUE;
+		}
+	}
+
+	return FALSE;
+}
+
+/* Names on disk are not necessarily UTF-8, match on the display name */
+static _Bool
+name_matches (NautilusQueryMatcher *matcher, const char *name)
+{
+	char *display_name;
+	_Bool hit;
+
+	if (g_utf8_validate (name, -1, NULL)) {
+		return nautilus_query_matcher_matches (matcher, name);
+	}
+
+	display_name = g_filename_display_name (name);
+	hit = nautilus_query_matcher_matches (matcher, display_name);
+	g_free (display_name);
+
+	return hit;
+}
+
+static inline guint32
+trigram_at (const char *p)
+{
+	return ((guint32) (guchar) p[0] << 16) |
+		((guint32) (guchar) p[1] << 8) |
+		(guint32) (guchar) p[2];
+}
+
+static int
+compare_guint32 (const void *a, const void *b)
+{
+	guint32 x = *(const guint32 *) a;
+	guint32 y = *(const guint32 *) b;
+
+	return x < y ? -1 : x > y;
+}
+
+static int
+compare_trigrams (const void *a, const void *b)
+{
+	guint32 x = ((const IndexTrigram *) a)->trigram;
+	guint32 y = ((const IndexTrigram *) b)->trigram;
+
+	return x < y ? -1 : x > y;
+}
+
+/* Fills @trigrams with the distinct trigrams of the folded @name,
+ * returns how many there are.
+ */
+static int
+get_name_trigrams (const char *name, guint32 *trigrams)
+{
+	char folded[INDEX_NAME_BUFFER_SIZE];
+	char *display_name;
+	_Bool folded_ok;
+	int len, n, i, j;
+
+	if (g_utf8_validate (name, -1, NULL)) {
+		folded_ok = nautilus_query_fold_name (name, folded, sizeof (folded));
+	} else {
+		display_name = g_filename_display_name (name);
+		folded_ok = nautilus_query_fold_name (display_name, folded, sizeof (folded));
+		g_free (display_name);
+	}
+
+	if (!folded_ok) {
+		return 0;
+	}
+
+	len = strlen (folded);
+	n = 0;
+	for (i = 0; i + 3 <= len; i++) {
+		trigrams[n++] = trigram_at (folded + i);
+	}
+
+	qsort (trigrams, n, sizeof (guint32), compare_guint32);
+
+	for (i = 0, j = 0; i < n; i++) {
+		if (j == 0 || trigrams[j - 1] != trigrams[i]) {
+			trigrams[j++] = trigrams[i];
+		}
+	}
+
+	return j;
+}
+
+static IndexSnapshot *
+snapshot_ref (IndexSnapshot *snapshot)
+{
+	if (snapshot != NULL) {
+		g_atomic_int_inc (&snapshot->ref_count);
+	}
+
+	return snapshot;
+}
+
+static void
+snapshot_unref (IndexSnapshot *snapshot)
+{
+	if (snapshot != NULL && g_atomic_int_dec_and_test (&snapshot->ref_count)) {
+		g_mapped_file_unref (snapshot->mapped);
+		g_free (snapshot);
+	}
+}
+
+static IndexSnapshot *
+snapshot_load (const char *path, guint32 roots_hash)
+{
+	IndexSnapshot *snapshot;
+	GMappedFile *mapped;
+	const IndexHeader *header;
+	const char *contents;
+	gsize length, expected;
+
+	mapped = g_mapped_file_new (path, FALSE, NULL);
+	if (mapped == NULL) {
+		return NULL;
+	}
+
+	contents = g_mapped_file_get_contents (mapped);
+	length = g_mapped_file_get_length (mapped);
+	header = (const IndexHeader *) contents;
+
+	if (length < sizeof (IndexHeader) ||
+	    memcmp (header->magic, INDEX_MAGIC, sizeof (header->magic)) != 0 ||
+	    header->version != INDEX_VERSION ||
+	    header->roots_hash != roots_hash) {
+		g_mapped_file_unref (mapped);
+		return NULL;
+	}
+
+	expected = sizeof (IndexHeader) +
+		(gsize) header->n_entries * sizeof (IndexEntry) +
+		(gsize) header->n_trigrams * sizeof (IndexTrigram) +
+		(gsize) header->n_postings * sizeof (guint32) +
+		header->strings_size;
+	if (length != expected) {
+		g_mapped_file_unref (mapped);
+		return NULL;
+	}
+
+	snapshot = g_new0 (IndexSnapshot, 1);
+	snapshot->ref_count = 1;
+	snapshot->mapped = mapped;
+	snapshot->header = header;
+	snapshot->entries = (const IndexEntry *) (header + 1);
+	snapshot->trigrams = (const IndexTrigram *) (snapshot->entries + header->n_entries);
+	snapshot->postings = (const guint32 *) (snapshot->trigrams + header->n_trigrams);
+	snapshot->strings = (const char *) (snapshot->postings + header->n_postings);
+
+	return snapshot;
+}
+
+/* Writes the path of entry @id into @buffer */
+static _Bool
+snapshot_get_path (IndexSnapshot *snapshot, guint32 id, char *buffer, gsize size)
+{
+	guint32 chain[INDEX_MAX_DEPTH];
+	const char *name;
+	gsize used, len;
+	int depth;
+
+	depth = 0;
+	while (id != INDEX_NO_PARENT) {
+		if (depth == INDEX_MAX_DEPTH || id >= snapshot->header->n_entries) {
+			return FALSE;
+		}
+		chain[depth++] = id;
+		id = snapshot->entries[id].parent;
+	}
+
+	used = 0;
+	while (depth-- > 0) {
+		name = snapshot->strings + snapshot->entries[chain[depth]].name;
+		len = strlen (name);
+
+		if (used > 0 && buffer[used - 1] != '/') {
+			if (used + 1 >= size) {
+				return FALSE;
+			}
+			buffer[used++] = '/';
+		}
+		if (used + len >= size) {
+			return FALSE;
+		}
+		memcpy (buffer + used, name, len);
+		used += len;
+	}
+	buffer[used] = '\0';
+
+	return TRUE;
+}
+
+static const IndexTrigram *
+snapshot_find_trigram (IndexSnapshot *snapshot, guint32 trigram)
+{
+	const IndexTrigram *trigrams;
+	guint32 low, high, mid;
+
+	trigrams = snapshot->trigrams;
+	low = 0;
+	high = snapshot->header->n_trigrams;
+
+	while (low < high) {
+		mid = low + (high - low) / 2;
+		if (trigrams[mid].trigram < trigram) {
+			low = mid + 1;
+		} else {
+			high = mid;
+		}
+	}
+
+	if (low < snapshot->header->n_trigrams && trigrams[low].trigram == trigram) {
+		return &trigrams[low];
+	}
+
+	return NULL;
+}
+
+static IndexDelta *
+delta_new (void)
+{
+	IndexDelta *delta;
+
+	delta = g_new0 (IndexDelta, 1);
+	delta->added = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+	delta->removed = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+	delta->moved = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
+
+	return delta;
+}
+
+static void
+delta_free (IndexDelta *delta)
+{
+	if (delta == NULL) {
+		return;
+	}
+
+	g_hash_table_destroy (delta->added);
+	g_hash_table_destroy (delta->removed);
+	g_hash_table_destroy (delta->moved);
+	g_free (delta);
+}
+
+static guint
+delta_size (IndexDelta *delta)
+{
+	return g_hash_table_size (delta->added) +
+		g_hash_table_size (delta->removed) +
+		g_hash_table_size (delta->moved);
+}
+
+static void
+delta_note_added (IndexDelta *delta, const char *path, guint32 flags)
+{
+	g_hash_table_insert (delta->added, g_strdup (path), GUINT_TO_POINTER (flags));
+}
+
+static void
+delta_note_removed (IndexDelta *delta, const char *path, guint32 flags)
+{
+	GHashTableIter iter;
+	const char *added;
+
+	g_hash_table_iter_init (&iter, delta->added);
+	while (g_hash_table_iter_next (&iter, (void **) &added, NULL)) {
+		if (path_has_prefix (added, path)) {
+			g_hash_table_iter_remove (&iter);
+		}
+	}
+
+	g_hash_table_add (delta->removed, g_strdup (path));
+}
+
+static char *
+rebase_path (const char *path, const char *from, const char *to)
+{
+	return g_strconcat (to, path + strlen (from), NULL);
+}
+
+static void
+delta_note_moved (IndexDelta *delta, const char *from, const char *to, guint32 flags)
+{
+	GHashTableIter iter;
+	GHashTable *rebased;
+	const char *path;
+	void *flags;
+	char *new_to;
+
+	/* Move what was added since the index was written along */
+	rebased = g_hash_table_new (g_str_hash, g_str_equal);
+	g_hash_table_iter_init (&iter, delta->added);
+	while (g_hash_table_iter_next (&iter, (void **) &path, &flags)) {
+		if (path_has_prefix (path, from)) {
+			g_hash_table_insert (rebased, rebase_path (path, from, to), flags);
+			g_hash_table_iter_remove (&iter);
+		}
+	}
+	g_hash_table_iter_init (&iter, rebased);
+	while (g_hash_table_iter_next (&iter, (void **) &path, &flags)) {
+		g_hash_table_insert (delta->added, (char *) path, flags);
+	}
+	g_hash_table_destroy (rebased);
+
+	/* Chain earlier moves into this one */
+	g_hash_table_iter_init (&iter, delta->moved);
+	while (g_hash_table_iter_next (&iter, NULL, (void **) &path)) {
+		if (path_has_prefix (path, from)) {
+			new_to = rebase_path (path, from, to);
+			g_hash_table_iter_replace (&iter, new_to);
+		}
+	}
+
+	g_hash_table_insert (delta->moved, g_strdup (from), g_strdup (to));
+	delta_note_added (delta, to, flags);
+}
+
+/* Replays @delta onto @target. Within one delta only the final state of
+ * each path is known, replaying removals first keeps remove-then-add.
+ */
+static void
+delta_merge (IndexDelta *target, IndexDelta *delta)
+{
+	GHashTableIter iter;
+	const char *path, *to;
+	void *flags;
+
+	g_hash_table_iter_init (&iter, delta->removed);
+	while (g_hash_table_iter_next (&iter, (void **) &path, NULL)) {
+		delta_note_removed (target, path, 0);
+	}
+
+	/* The added entries below carry the right flags for the targets */
+	g_hash_table_iter_init (&iter, delta->moved);
+	while (g_hash_table_iter_next (&iter, (void **) &path, (void **) &to)) {
+		delta_note_moved (target, path, to, 0);
+	}
+
+	g_hash_table_iter_init (&iter, delta->added);
+	while (g_hash_table_iter_next (&iter, (void **) &path, &flags)) {
+		delta_note_added (target, path, GPOINTER_TO_UINT (flags));
+	}
+}
+
+static _Bool
+delta_is_removed (IndexDelta *delta, const char *path)
+{
+	char buffer[INDEX_PATH_BUFFER_SIZE];
+	char *slash;
+
+	if (g_hash_table_size (delta->removed) == 0) {
+		return FALSE;
+	}
+
+	if (g_strlcpy (buffer, path, sizeof (buffer)) >= sizeof (buffer)) {
+		return FALSE;
+	}
+
+	do {
+		if (g_hash_table_contains (delta->removed, buffer)) {
+			return TRUE;
+		}
+		slash = strrchr (buffer, '/');
+		if (slash != NULL) {
+			*slash = '\0';
+		}
+	} while (slash != NULL && buffer[0] != '\0');
+
+	return FALSE;
+}
+
+/* Applies the delta to an indexed @path. Returns NULL if the file is
+ * gone or reported from the delta, otherwise @path or its new location
+ * in @buffer.
+ */
+static const char *
+delta_apply (IndexDelta *delta, const char *path, char *buffer, gsize size)
+{
+	char ancestor[INDEX_PATH_BUFFER_SIZE];
+	const char *to;
+	char *slash;
+
+	if (g_hash_table_contains (delta->added, path) ||
+	    g_hash_table_contains (delta->moved, path) ||
+	    delta_is_removed (delta, path)) {
+		return NULL;
+	}
+
+	if (g_hash_table_size (delta->moved) == 0 ||
+	    g_strlcpy (ancestor, path, sizeof (ancestor)) >= sizeof (ancestor)) {
+		return path;
+	}
+
+	while ((slash = strrchr (ancestor, '/')) != NULL && slash != ancestor) {
+		*slash = '\0';
+		to = g_hash_table_lookup (delta->moved, ancestor);
+		if (to != NULL) {
+			if (g_snprintf (buffer, size, "%s%s", to, path + strlen (ancestor)) >= (int) size ||
+			    delta_is_removed (delta, buffer) ||
+			    g_hash_table_contains (delta->added, buffer)) {
+				return NULL;
+			}
+			return buffer;
+		}
+	}
+
+	return path;
+}
+
+/* Building */
+
+static void
+append_entry (GArray *entries, GString *strings, guint32 parent,
+	      const char *name, guint32 flags)
+{
+	IndexEntry entry;
+
+	entry.parent = parent;
+	entry.name = strings->len;
+	entry.flags = flags;
+	g_string_append_len (strings, name, strlen (name) + 1);
+
+	g_array_append_val (entries, entry);
+}
+
+static void
+crawl_directory (GArray *entries, GString *strings, guint32 id, const char *path)
+{
+	DIR *dir;
+	struct dirent *dent;
+	struct stat statbuf;
+	char *child;
+	guint32 flags;
+	_Bool is_dir;
+
+	dir = opendir (path);
+	if (dir == NULL) {
+		return;
+	}
+
+	while ((dent = readdir (dir)) != NULL) {
+		/* Hidden files are not searched, same as the simple engine */
+		if (dent->d_name[0] == '.') {
+			continue;
+		}
+
+		if (entries->len >= INDEX_NO_PARENT - 1) {
+			break;
+		}
+
+#ifdef _DIRENT_HAVE_D_TYPE
+		if (dent->d_type != DT_UNKNOWN) {
+			is_dir = dent->d_type == DT_DIR;
+		} else
+#endif
+		{
+			child = g_build_filename (path, dent->d_name, NULL);
+			is_dir = g_lstat (child, &statbuf) == 0 && S_ISDIR (statbuf.st_mode);
+			g_free (child);
+		}
+
+		flags = is_dir ? INDEX_ENTRY_DIRECTORY : 0;
+		append_entry (entries, strings, id, dent->d_name, flags);
+	}
+
+	closedir (dir);
+}
+
+static char *
+build_entry_path (GArray *entries, GString *strings, guint32 id)
+{
+	GPtrArray *names;
+	IndexEntry *entry;
+	char *path;
+
+	names = g_ptr_array_new ();
+	while (id != INDEX_NO_PARENT) {
+		entry = &g_array_index (entries, IndexEntry, id);
+		g_ptr_array_add (names, strings->str + entry->name);
+		id = entry->parent;
+	}
+
+	/* Names were collected leaf first */
+	path = g_strdup (g_ptr_array_index (names, names->len - 1));
+	while (names->len > 1) {
+		char *tmp;
+
+		g_ptr_array_remove_index (names, names->len - 1);
+		tmp = g_build_filename (path, g_ptr_array_index (names, names->len - 1), NULL);
+		g_free (path);
+		path = tmp;
+	}
+
+	g_ptr_array_free (names, TRUE);
+
+	return path;
+}
+
+static _Bool
+write_index (const char *path, guint32 roots_hash, GArray *entries, GString *strings)
+{
+	IndexHeader header;
+	IndexTrigram trigram, *slot;
+	GArray *trigram_table;
+	GHashTable *trigram_slots;
+	GHashTableIter iter;
+	void *key, *value;
+	guint32 name_trigrams[INDEX_NAME_BUFFER_SIZE];
+	guint32 *postings;
+	guint32 i, k, n_postings;
+	IndexEntry *entry;
+	char *tmp_path, *dir;
+	FILE *out;
+	int n, j;
+	_Bool ok;
+
+	/* First count the entries of each trigram, trigram -> count */
+	trigram_slots = g_hash_table_new (g_direct_hash, g_direct_equal);
+	n_postings = 0;
+	for (i = 0; i < entries->len; i++) {
+		entry = &g_array_index (entries, IndexEntry, i);
+		if (entry->flags & INDEX_ENTRY_ROOT) {
+			continue;
+		}
+		n = get_name_trigrams (strings->str + entry->name, name_trigrams);
+		for (j = 0; j < n; j++) {
+			key = GUINT_TO_POINTER (name_trigrams[j]);
+			value = g_hash_table_lookup (trigram_slots, key);
+			g_hash_table_insert (trigram_slots, key,
+					     GUINT_TO_POINTER (GPOINTER_TO_UINT (value) + 1));
+		}
+		n_postings += n;
+	}
+
+	trigram_table = g_array_sized_new (FALSE, FALSE, sizeof (IndexTrigram),
+					   g_hash_table_size (trigram_slots));
+	g_hash_table_iter_init (&iter, trigram_slots);
+	while (g_hash_table_iter_next (&iter, &key, &value)) {
+		trigram.trigram = GPOINTER_TO_UINT (key);
+		trigram.first = 0;
+		trigram.count = GPOINTER_TO_UINT (value);
+		g_array_append_val (trigram_table, trigram);
+	}
+	g_array_sort (trigram_table, compare_trigrams);
+
+	/* Lay the posting lists out in trigram order, trigram -> slot + 1 */
+	n_postings = 0;
+	for (k = 0; k < trigram_table->len; k++) {
+		slot = &g_array_index (trigram_table, IndexTrigram, k);
+		slot->first = n_postings;
+		n_postings += slot->count;
+		slot->count = 0;
+		g_hash_table_insert (trigram_slots, GUINT_TO_POINTER (slot->trigram),
+				     GUINT_TO_POINTER (k + 1));
+	}
+
+	/* Then fill them, going through the entries in order keeps each
+	 * list ascending.
+	 */
+	postings = g_new (guint32, MAX (n_postings, 1));
+	for (i = 0; i < entries->len; i++) {
+		entry = &g_array_index (entries, IndexEntry, i);
+		if (entry->flags & INDEX_ENTRY_ROOT) {
+			continue;
+		}
+		n = get_name_trigrams (strings->str + entry->name, name_trigrams);
+		for (j = 0; j < n; j++) {
+			k = GPOINTER_TO_UINT (g_hash_table_lookup (trigram_slots,
+								   GUINT_TO_POINTER (name_trigrams[j]))) - 1;
+			slot = &g_array_index (trigram_table, IndexTrigram, k);
+			postings[slot->first + slot->count++] = i;
+		}
+	}
+	g_hash_table_destroy (trigram_slots);
+
+	memset (&header, 0, sizeof (header));
+	memcpy (header.magic, INDEX_MAGIC, sizeof (header.magic));
+	header.version = INDEX_VERSION;
+	header.roots_hash = roots_hash;
+	header.build_time = g_get_real_time () / G_USEC_PER_SEC;
+	header.n_entries = entries->len;
+	header.n_trigrams = trigram_table->len;
+	header.n_postings = n_postings;
+	header.strings_size = strings->len;
+
+	dir = g_path_get_dirname (path);
+	g_mkdir_with_parents (dir, 0700);
+	g_free (dir);
+
+	/* Write next to the old index and swap, readers keep their mapping */
+	tmp_path = g_strconcat (path, ".tmp", NULL);
+	out = g_fopen (tmp_path, "wb");
+	ok = out != NULL;
+	if (ok) {
+		ok = fwrite (&header, sizeof (header), 1, out) == 1;
+		ok = ok && fwrite (entries->data, sizeof (IndexEntry), entries->len, out) == entries->len;
+		ok = ok && fwrite (trigram_table->data, sizeof (IndexTrigram), trigram_table->len, out) == trigram_table->len;
+		ok = ok && fwrite (postings, sizeof (guint32), n_postings, out) == n_postings;
+		ok = ok && fwrite (strings->str, 1, strings->len, out) == strings->len;
+		ok = (fclose (out) == 0) && ok;
+	}
+	ok = ok && g_rename (tmp_path, path) == 0;
+	if (!ok) {
+		g_unlink (tmp_path);
+	}
+
+	g_free (tmp_path);
+	g_free (postings);
+	g_array_free (trigram_table, TRUE);
+
+	return ok;
+}
+
+static void *
+rebuild_thread_func (void *user_data)
+{
+	IndexBuildData *data;
+	IndexSnapshot *snapshot;
+	GArray *entries;
+	GString *strings;
+	IndexEntry *entry;
+	char *index_path, *path;
+	guint32 i;
+
+	data = user_data;
+
+	entries = g_array_new (FALSE, FALSE, sizeof (IndexEntry));
+	strings = g_string_new (NULL);
+
+	for (i = 0; data->roots[i] != NULL; i++) {
+		append_entry (entries, strings, INDEX_NO_PARENT, data->roots[i],
+			      INDEX_ENTRY_ROOT | INDEX_ENTRY_DIRECTORY);
+	}
+
+	/* The entries array doubles as the breadth first work queue */
+	for (i = 0; i < entries->len; i++) {
+		entry = &g_array_index (entries, IndexEntry, i);
+		if (!(entry->flags & INDEX_ENTRY_DIRECTORY)) {
+			continue;
+		}
+		path = build_entry_path (entries, strings, i);
+		crawl_directory (entries, strings, i, path);
+		g_free (path);
+	}
+
+	index_path = get_index_path ();
+	snapshot = NULL;
+	if (write_index (index_path, data->roots_hash, entries, strings)) {
+		snapshot = snapshot_load (index_path, data->roots_hash);
+	}
+	g_free (index_path);
+
+	g_array_free (entries, TRUE);
+	g_string_free (strings, TRUE);
+
+	g_mutex_lock (&index_lock);
+
+	if (snapshot != NULL && data->roots_hash == index_roots_hash) {
+		snapshot_unref (current_snapshot);
+		current_snapshot = snapshot;
+		delta_free (pending_delta);
+	} else {
+		/* Failed or the roots changed under us, keep what we had */
+		snapshot_unref (snapshot);
+		delta_merge (pending_delta, current_delta);
+		delta_free (current_delta);
+		current_delta = pending_delta;
+	}
+	pending_delta = NULL;
+	rebuild_running = FALSE;
+
+	if (data->roots_hash != index_roots_hash) {
+		start_rebuild_locked ();
+	}
+	if (!rebuild_running) {
+		schedule_refresh_locked ();
+	}
+
+	g_mutex_unlock (&index_lock);
+
+	g_strfreev (data->roots);
+	g_free (data);
+
+	return NULL;
+}
+
+static void
+start_rebuild_locked (void)
+{
+	IndexBuildData *data;
+	GThread *thread;
+
+	if (rebuild_running || index_roots == NULL || index_roots[0] == NULL) {
+		return;
+	}
+
+	rebuild_running = TRUE;
+
+	/* Changes from now on may or may not make it into the new index,
+	 * keep applying the old ones until it is swapped in.
+	 */
+	pending_delta = current_delta;
+	current_delta = delta_new ();
+
+	data = g_new0 (IndexBuildData, 1);
+	data->roots = g_strdupv (index_roots);
+	data->roots_hash = index_roots_hash;
+
+	thread = g_thread_new ("nautilus-search-index", rebuild_thread_func, data);
+	g_thread_unref (thread);
+}
+
+/* Is really _Bool but glib errently defines gboolean as int */
+static int
+refresh_timeout_callback (void *user_data)
+{
+	g_mutex_lock (&index_lock);
+
+	/* A finishing rebuild replaced us while we waited for the lock */
+	if (!g_source_is_destroyed (g_main_current_source ())) {
+		refresh_timeout_id = 0;
+		start_rebuild_locked ();
+	}
+
+	g_mutex_unlock (&index_lock);
+
+	return FALSE;
+}
+
+/* Rebuilds the index once it is INDEX_MAX_AGE old, the changes made
+ * while nautilus was not running are only picked up that way.
+ */
+static void
+schedule_refresh_locked (void)
+{
+	gint64 delay;
+
+	if (refresh_timeout_id != 0) {
+		g_source_remove (refresh_timeout_id);
+		refresh_timeout_id = 0;
+	}
+
+	if (index_roots == NULL || index_roots[0] == NULL) {
+		return;
+	}
+
+	delay = INDEX_MIN_REFRESH_DELAY;
+	if (current_snapshot != NULL) {
+		delay = MAX (delay, current_snapshot->header->build_time + INDEX_MAX_AGE -
+			     g_get_real_time () / G_USEC_PER_SEC);
+	}
+
+	refresh_timeout_id = g_timeout_add_seconds (delay, refresh_timeout_callback, NULL);
+}
+
+static void
+load_roots_locked (void)
+{
+	char **roots;
+	GPtrArray *absolute;
+	int i;
+
+	roots = g_settings_get_strv (nautilus_preferences, NAUTILUS_PREFERENCES_SEARCH_INDEX_ROOTS);
+
+	absolute = g_ptr_array_new ();
+	for (i = 0; roots[i] != NULL; i++) {
+		if (g_path_is_absolute (roots[i])) {
+			g_ptr_array_add (absolute, g_strdup (roots[i]));
+		}
+	}
+	g_ptr_array_add (absolute, NULL);
+	g_strfreev (roots);
+
+	g_strfreev (index_roots);
+	index_roots = (char **) g_ptr_array_free (absolute, FALSE);
+	index_roots_hash = get_roots_hash (index_roots);
+}
+
+static void
+roots_changed_callback (GSettings *settings, const char *key, void *user_data)
+{
+	g_mutex_lock (&index_lock);
+
+	load_roots_locked ();
+	start_rebuild_locked ();
+
+	g_mutex_unlock (&index_lock);
+}
+
+void
+nautilus_search_index_init (void)
+{
+	static _Bool initialized = FALSE;
+	IndexSnapshot *snapshot;
+	char *index_path;
+
+	if (initialized) {
+		return;
+	}
+
+	initialized = TRUE;
+
+	nautilus_global_preferences_init ();
+
+	g_mutex_lock (&index_lock);
+
+	current_delta = delta_new ();
+	load_roots_locked ();
+
+	if (index_roots[0] != NULL) {
+		index_path = get_index_path ();
+		snapshot = snapshot_load (index_path, index_roots_hash);
+		g_free (index_path);
+
+		current_snapshot = snapshot;
+
+		/* Nothing was watching while we were not running */
+		if (snapshot == NULL ||
+		    g_get_real_time () / G_USEC_PER_SEC - snapshot->header->build_time > INDEX_MAX_AGE) {
+			start_rebuild_locked ();
+		} else {
+			schedule_refresh_locked ();
+		}
+	}
+
+	g_mutex_unlock (&index_lock);
+
+	g_signal_connect (nautilus_preferences,
+			  "changed::" NAUTILUS_PREFERENCES_SEARCH_INDEX_ROOTS,
+			  G_CALLBACK (roots_changed_callback), NULL);
+}
+
+_Bool
+nautilus_search_index_covers (const char *path)
+{
+	_Bool covers;
+
+	if (path == NULL) {
+		return FALSE;
+	}
+
+	g_mutex_lock (&index_lock);
+
+	covers = current_snapshot != NULL &&
+		current_snapshot->header->roots_hash == index_roots_hash &&
+		path_is_below_roots (path, index_roots);
+
+	g_mutex_unlock (&index_lock);
+
+	return covers;
+}
+
+void
+nautilus_search_index_query (NautilusQueryMatcher       *matcher,
+			     const char                 *root_path,
+			     GCancellable               *cancellable,
+			     NautilusSearchIndexHitFunc  func,
+			     void                       *user_data)
+{
+	IndexSnapshot *snapshot;
+	IndexDelta *delta;
+	const IndexTrigram *trigram, *rarest;
+	const guint32 *candidates;
+	const char * const *words;
+	const IndexEntry *entry;
+	const char *path, *name;
+	char buffer[INDEX_PATH_BUFFER_SIZE];
+	char moved_buffer[INDEX_PATH_BUFFER_SIZE];
+	GHashTableIter iter;
+	void *flags;
+	guint32 n_candidates, i, id;
+	_Bool no_candidates, is_directory;
+	gsize len, j;
+	int w;
+
+	g_mutex_lock (&index_lock);
+
+	snapshot = snapshot_ref (current_snapshot);
+
+	/* Take a private copy so the main thread can keep recording */
+	delta = delta_new ();
+	if (pending_delta != NULL) {
+		delta_merge (delta, pending_delta);
+	}
+	delta_merge (delta, current_delta);
+
+	g_mutex_unlock (&index_lock);
+
+	if (snapshot == NULL) {
+		delta_free (delta);
+		return;
+	}
+
+	/* Pick the shortest posting list of any word trigram */
+	words = nautilus_query_matcher_get_words (matcher);
+	rarest = NULL;
+	no_candidates = FALSE;
+	for (w = 0; words[w] != NULL && !no_candidates; w++) {
+		len = strlen (words[w]);
+		for (j = 0; j + 3 <= len; j++) {
+			trigram = snapshot_find_trigram (snapshot, trigram_at (words[w] + j));
+			if (trigram == NULL) {
+				no_candidates = TRUE;
+				break;
+			}
+			if (rarest == NULL || trigram->count < rarest->count) {
+				rarest = trigram;
+			}
+		}
+	}
+
+	if (no_candidates) {
+		n_candidates = 0;
+		candidates = NULL;
+	} else if (rarest != NULL) {
+		n_candidates = rarest->count;
+		candidates = snapshot->postings + rarest->first;
+	} else {
+		/* Words too short for trigrams, check every name */
+		n_candidates = snapshot->header->n_entries;
+		candidates = NULL;
+	}
+
+	for (i = 0; i < n_candidates; i++) {
+		if (i % INDEX_CANCEL_CHECK_INTERVAL == 0 &&
+		    g_cancellable_is_cancelled (cancellable)) {
+			goto out;
+		}
+
+		id = candidates != NULL ? candidates[i] : i;
+		entry = &snapshot->entries[id];
+		if (entry->flags & INDEX_ENTRY_ROOT) {
+			continue;
+		}
+
+		if (!name_matches (matcher, snapshot->strings + entry->name)) {
+			continue;
+		}
+
+		if (!snapshot_get_path (snapshot, id, buffer, sizeof (buffer))) {
+			continue;
+		}
+
+		path = delta_apply (delta, buffer, moved_buffer, sizeof (moved_buffer));
+		if (path == NULL || !path_has_prefix (path, root_path) ||
+		    strcmp (path, root_path) == 0) {
+			continue;
+		}
+
+		if (!func (path, (entry->flags & INDEX_ENTRY_DIRECTORY) != 0, user_data)) {
+			goto out;
+		}
+	}
+
+	/* Files that appeared after the index was written */
+	g_hash_table_iter_init (&iter, delta->added);
+	while (g_hash_table_iter_next (&iter, (void **) &path, &flags)) {
+		name = strrchr (path, '/');
+		name = name != NULL ? name + 1 : path;
+
+		if (!path_has_prefix (path, root_path) || strcmp (path, root_path) == 0 ||
+		    !name_matches (matcher, name)) {
+			continue;
+		}
+
+		/* Looked up here so noting the change stays cheap */
+		if (GPOINTER_TO_UINT (flags) & INDEX_ENTRY_UNKNOWN_TYPE) {
+			is_directory = g_file_test (path, G_FILE_TEST_IS_DIR);
+		} else {
+			is_directory = (GPOINTER_TO_UINT (flags) & INDEX_ENTRY_DIRECTORY) != 0;
+		}
+
+		if (!func (path, is_directory, user_data)) {
+			break;
+		}
+	}
+
+ out:
+	delta_free (delta);
+	snapshot_unref (snapshot);
+}
+
+typedef void (* DeltaNoteFunc) (IndexDelta *delta, const char *path, guint32 flags);
+
+static void
+note_locations (GList *locations, DeltaNoteFunc note, guint32 flags)
+{
+	GList *l;
+	char *path;
+
+	g_mutex_lock (&index_lock);
+
+	if (index_roots == NULL || index_roots[0] == NULL) {
+		g_mutex_unlock (&index_lock);
+		return;
+	}
+
+	for (l = locations; l != NULL; l = l->next) {
+		path = g_file_get_path (l->data);
+		if (path != NULL && path_is_indexed (path, index_roots)) {
+			note (current_delta, path, flags);
+		}
+		g_free (path);
+	}
+
+	if (delta_size (current_delta) > INDEX_DELTA_REBUILD_THRESHOLD) {
+		start_rebuild_locked ();
+	}
+
+	g_mutex_unlock (&index_lock);
+}
+
+void
+nautilus_search_index_files_added (GList *locations)
+{
+	note_locations (locations, delta_note_added, INDEX_ENTRY_UNKNOWN_TYPE);
+}
+
+void
+nautilus_search_index_files_removed (GList *locations)
+{
+	note_locations (locations, delta_note_removed, 0);
+}
+
+void
+nautilus_search_index_files_moved (GList *file_pairs)
+{
+	GList *l;
+	GFilePair *pair;
+	char *from, *to;
+
+	g_mutex_lock (&index_lock);
+
+	if (index_roots == NULL || index_roots[0] == NULL) {
+		g_mutex_unlock (&index_lock);
+		return;
+	}
+
+	for (l = file_pairs; l != NULL; l = l->next) {
+		pair = l->data;
+		from = g_file_get_path (pair->from);
+		to = g_file_get_path (pair->to);
+
+		if (from != NULL && path_is_indexed (from, index_roots)) {
+			if (to != NULL && path_is_indexed (to, index_roots)) {
+				delta_note_moved (current_delta, from, to, INDEX_ENTRY_UNKNOWN_TYPE);
+			} else {
+				delta_note_removed (current_delta, from, 0);
+			}
+		} else if (to != NULL && path_is_indexed (to, index_roots)) {
+			delta_note_added (current_delta, to, INDEX_ENTRY_UNKNOWN_TYPE);
+		}
+
+		g_free (from);
+		g_free (to);
+	}
+
+	if (delta_size (current_delta) > INDEX_DELTA_REBUILD_THRESHOLD) {
+		start_rebuild_locked ();
+	}
+
+	g_mutex_unlock (&index_lock);
+}
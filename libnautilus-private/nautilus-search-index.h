@@ -0,0 +1,62 @@
+/* -*- Mode: C; indent-tabs-mode: t; c-basic-offset: 8; tab-width: 8 -*-
+
+   nautilus-search-index.h: Persistent file name index for local search.
+
+   Copyright (C) 2026 Nautilus contributors
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 2 of the
+   License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public
+   License along with this program; if not, write to the
+   Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+   Boston, MA 02111-1307, USA.
+*/
+
+#ifndef NAUTILUS_SEARCH_INDEX_H
+#define NAUTILUS_SEARCH_INDEX_H
+
+#include <gio/gio.h>
+#include <libnautilus-private/nautilus-query.h>
+
+/* The index covers the local directories listed in the
+ * "search-index-roots" preference. It is kept in a memory mapped file
+ * in the user cache directory, rebuilt in a background thread when it
+ * is missing or stale, and patched in memory from the file changes
+ * queue in between.
+ */
+
+/* Called for each hit, return FALSE to stop the query */
+typedef _Bool (* NautilusSearchIndexHitFunc) (const char *path,
+                                              _Bool       is_directory,
+                                              void       *user_data);
+
+/* Loads the index, or starts building it. Call once at startup. */
+void  nautilus_search_index_init          (void);
+
+/* TRUE if roots are configured and an index covering @path is mapped */
+_Bool nautilus_search_index_covers        (const char                 *path);
+
+/* Reports every indexed file below @root_path whose name matches
+ * @matcher. Does not touch the file system and may be called from
+ * any thread.
+ */
+void  nautilus_search_index_query         (NautilusQueryMatcher       *matcher,
+                                           const char                 *root_path,
+                                           GCancellable               *cancellable,
+                                           NautilusSearchIndexHitFunc  func,
+                                           void                       *user_data);
+
+/* Fed from nautilus_file_changes_consume_changes () */
+void  nautilus_search_index_files_added   (GList                      *locations);
+void  nautilus_search_index_files_removed (GList                      *locations);
+void  nautilus_search_index_files_moved   (GList                      *file_pairs);
+
+#endif /* NAUTILUS_SEARCH_INDEX_H */
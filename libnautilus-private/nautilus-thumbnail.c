@@ -30,6 +30,10 @@
 
 #include <glib.h>
 #include <glib-object.h>
+#include <glib/gstdio.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/stat.h>
 #include <time.h>
 
 #define GDK_PIXBUF_ENABLE_BACKEND
@@ -43,6 +47,20 @@
 
 #define SECONDS_BETWEEN_STATS 10
 
+/* Only this much of a thumbnail is read looking for its tEXt chunks,
+ * they are written before the image data */
+#define THUMBNAIL_TEXT_READ_LIMIT (64 * 1024)
+
+/* Number of validated thumbnails remembered */
+#define VALID_THUMBNAIL_CACHE_SIZE 8192
+
+typedef struct {
+  char *path;
+  time_t mtime;        /* mtime of the thumbnailed file */
+  time_t thumb_mtime;  /* mtime and size of the thumbnail itself */
+  goffset thumb_size;
+} ValidThumbnail;
+
 struct _NautilusThumbnailFactoryPrivate {
   char *application;
   NautilusThumbnailSize size;
@@ -52,10 +70,15 @@ struct _NautilusThumbnailFactoryPrivate {
   GHashTable *scripts_hash;
   unsigned int thumbnailers_notify;
   unsigned int reread_scheduled;
+
+  /* Most recently validated first, protected by lock */
+  GQueue valid_thumbnails;
+  GHashTable *valid_thumbnails_by_path;
 };
 
 static void nautilus_thumbnail_factory_init          (NautilusThumbnailFactory      *factory);
 static void nautilus_thumbnail_factory_class_init    (NautilusThumbnailFactoryClass *class);
+static void valid_thumbnail_free                     (ValidThumbnail                *thumbnail);
 
 G_DEFINE_TYPE (NautilusThumbnailFactory, nautilus_thumbnail_factory, G_TYPE_OBJECT)
 
@@ -90,6 +113,10 @@ nautilus_thumbnail_factory_finalize (GObject *object)
       priv->scripts_hash = NULL;
     }
 
+  g_hash_table_destroy (priv->valid_thumbnails_by_path);
+  g_queue_foreach (&priv->valid_thumbnails, (GFunc) valid_thumbnail_free, NULL);
+  g_queue_clear (&priv->valid_thumbnails);
+
   if (priv->lock)
     {
       g_mutex_free (priv->lock);
@@ -251,6 +278,9 @@ nautilus_thumbnail_factory_init (NautilusThumbnailFactory *factory)
 
   priv->lock = (void*)g_mutex_new ();
 
+  g_queue_init (&priv->valid_thumbnails);
+  priv->valid_thumbnails_by_path = g_hash_table_new (g_str_hash, g_str_equal);
+
   nautilus_thumbnail_factory_reread_scripts (factory);
 
 #if HAVE_GNOME_DESKTOP
@@ -306,6 +336,224 @@ nautilus_thumbnail_factory_new (NautilusThumbnailSize size)
   return factory;
 }
 
+static guint32
+read_png_uint32 (const guchar *data)
+{
+  return ((guint32) data[0] << 24) | ((guint32) data[1] << 16) |
+         ((guint32) data[2] << 8) | (guint32) data[3];
+}
+
+/* Reads the Thumb::URI and Thumb::MTime tEXt chunks of a thumbnail
+ * without decoding it. Returns FALSE when they are not in the first
+ * THUMBNAIL_TEXT_READ_LIMIT bytes, or not stored as plain tEXt.
+ */
+static _Bool
+read_thumbnail_text (const char  *path,
+                     char       **thumb_uri,
+                     char       **thumb_mtime)
+{
+  static const guchar png_signature[8] = { 137, 80, 78, 71, 13, 10, 26, 10 };
+  guchar header[8];
+  guint32 length;
+  goffset offset;
+  char *data, *value;
+  FILE *file;
+
+  *thumb_uri = NULL;
+  *thumb_mtime = NULL;
+
+  file = g_fopen (path, "rb");
+  if (file == NULL)
+    return FALSE;
+
+  if (fread (header, 1, 8, file) != 8 ||
+      memcmp (header, png_signature, 8) != 0)
+    goto out;
+
+  offset = 8;
+  while (offset < THUMBNAIL_TEXT_READ_LIMIT &&
+         (*thumb_uri == NULL || *thumb_mtime == NULL))
+    {
+      /* Chunk length and type */
+      if (fread (header, 1, 8, file) != 8)
+        break;
+      offset += 8;
+
+      length = read_png_uint32 (header);
+      if (memcmp (header + 4, "IDAT", 4) == 0 ||
+          memcmp (header + 4, "IEND", 4) == 0 ||
+          length > THUMBNAIL_TEXT_READ_LIMIT - offset)
+        break;
+
+      if (memcmp (header + 4, "tEXt", 4) == 0)
+        {
+          data = g_malloc (length + 1);
+          if (fread (data, 1, length, file) != length)
+            {
+              g_free (data);
+              break;
+            }
+          data[length] = 0;
+
+          /* keyword, NUL, text */
+          value = memchr (data, 0, length);
+          if (value != NULL)
+            {
+              value++;
+              if (*thumb_uri == NULL && strcmp (data, "Thumb::URI") == 0)
+                *thumb_uri = g_strndup (value, data + length - value);
+              else if (*thumb_mtime == NULL && strcmp (data, "Thumb::MTime") == 0)
+                *thumb_mtime = g_strndup (value, data + length - value);
+            }
+          g_free (data);
+
+          length = 0;
+        }
+
+      /* Skip the rest of the chunk and its CRC */
+      if (fseek (file, (long) length + 4, SEEK_CUR) != 0)
+        break;
+      offset += length + 4;
+    }
+
+ out:
+  fclose (file);
+
+  if (*thumb_uri != NULL && *thumb_mtime != NULL)
+    return TRUE;
+
+  g_free (*thumb_uri);
+  g_free (*thumb_mtime);
+  *thumb_uri = NULL;
+  *thumb_mtime = NULL;
+
+  return FALSE;
+}
+
+static void
+valid_thumbnail_free (ValidThumbnail *thumbnail)
+{
+  g_free (thumbnail->path);
+  g_slice_free (ValidThumbnail, thumbnail);
+}
+
+/* Must be called with the lock held */
+static GList *
+lookup_valid_thumbnail (NautilusThumbnailFactoryPrivate *priv,
+                        const char                      *path)
+{
+  return g_hash_table_lookup (priv->valid_thumbnails_by_path, path);
+}
+
+static void
+remember_valid_thumbnail (NautilusThumbnailFactoryPrivate *priv,
+                          const char                      *path,
+                          time_t                           mtime,
+                          struct stat                     *thumb_stat)
+{
+  ValidThumbnail *thumbnail;
+  GList *link;
+
+  g_mutex_lock (priv->lock);
+
+  link = lookup_valid_thumbnail (priv, path);
+  if (link != NULL)
+    {
+      g_queue_unlink (&priv->valid_thumbnails, link);
+      thumbnail = link->data;
+    }
+  else
+    {
+      if (priv->valid_thumbnails.length >= VALID_THUMBNAIL_CACHE_SIZE)
+        {
+          link = g_queue_peek_tail_link (&priv->valid_thumbnails);
+          thumbnail = link->data;
+          g_hash_table_remove (priv->valid_thumbnails_by_path, thumbnail->path);
+          g_queue_delete_link (&priv->valid_thumbnails, link);
+          valid_thumbnail_free (thumbnail);
+        }
+
+      thumbnail = g_slice_new (ValidThumbnail);
+      thumbnail->path = g_strdup (path);
+      link = g_list_alloc ();
+      link->data = thumbnail;
+      g_hash_table_insert (priv->valid_thumbnails_by_path, thumbnail->path, link);
+    }
+
+  thumbnail->mtime = mtime;
+  thumbnail->thumb_mtime = thumb_stat->st_mtime;
+  thumbnail->thumb_size = thumb_stat->st_size;
+  g_queue_push_head_link (&priv->valid_thumbnails, link);
+
+  g_mutex_unlock (priv->lock);
+}
+
+/* Checks whether the thumbnail at @path was made for @uri at @mtime.
+ * Thumbnails that were validated before and have not changed on disk
+ * since are answered from memory, others only have their tEXt chunks
+ * read. The full image is decoded only if those are not found.
+ */
+static _Bool
+thumbnail_file_is_valid (NautilusThumbnailFactory *factory,
+                         const char               *path,
+                         const char               *uri,
+                         time_t                    mtime)
+{
+  NautilusThumbnailFactoryPrivate *priv = factory->priv;
+  ValidThumbnail *thumbnail;
+  struct stat thumb_stat;
+  char *thumb_uri, *thumb_mtime;
+  GdkPixbuf *pixbuf;
+  GList *link;
+  _Bool res;
+
+  if (g_stat (path, &thumb_stat) != 0)
+    return FALSE;
+
+  res = FALSE;
+
+  g_mutex_lock (priv->lock);
+  link = lookup_valid_thumbnail (priv, path);
+  if (link != NULL)
+    {
+      thumbnail = link->data;
+      if (thumbnail->mtime == mtime &&
+          thumbnail->thumb_mtime == thumb_stat.st_mtime &&
+          thumbnail->thumb_size == thumb_stat.st_size)
+        {
+          g_queue_unlink (&priv->valid_thumbnails, link);
+          g_queue_push_head_link (&priv->valid_thumbnails, link);
+          res = TRUE;
+        }
+    }
+  g_mutex_unlock (priv->lock);
+
+  if (res)
+    return TRUE;
+
+  if (read_thumbnail_text (path, &thumb_uri, &thumb_mtime))
+    {
+      res = strcmp (uri, thumb_uri) == 0 &&
+            mtime == atol (thumb_mtime);
+      g_free (thumb_uri);
+      g_free (thumb_mtime);
+    }
+  else
+    {
+      pixbuf = gdk_pixbuf_new_from_file (path, NULL);
+      if (pixbuf != NULL)
+        {
+          res = nautilus_thumbnail_is_valid (pixbuf, uri, mtime);
+          g_object_unref (pixbuf);
+        }
+    }
+
+  if (res)
+    remember_valid_thumbnail (priv, path, mtime, &thumb_stat);
+
+  return res;
+}
+
 /**
  * nautilus_thumbnail_factory_lookup:
  * @factory: a #NautilusThumbnailFactory
@@ -330,7 +578,6 @@ nautilus_thumbnail_factory_lookup (NautilusThumbnailFactory *factory,
   GChecksum *checksum;
   unsigned char digest[16];
   size_t digest_len = sizeof (digest);
-  GdkPixbuf *pixbuf;
   _Bool res;
 
   g_return_val_if_fail (uri != NULL, NULL);
@@ -352,12 +599,7 @@ nautilus_thumbnail_factory_lookup (NautilusThumbnailFactory *factory,
                            NULL);
   g_free (file);
 
-  pixbuf = gdk_pixbuf_new_from_file (path, NULL);
-  if (pixbuf != NULL)
-    {
-      res = nautilus_thumbnail_is_valid (pixbuf, uri, mtime);
-      g_object_unref (pixbuf);
-    }
+  res = thumbnail_file_is_valid (factory, path, uri, mtime);
 
   g_checksum_free (checksum);
 
@@ -390,7 +632,6 @@ nautilus_thumbnail_factory_has_valid_failed_thumbnail (NautilusThumbnailFactory
 						    time_t                 mtime)
 {
   char *path, *file;
-  GdkPixbuf *pixbuf;
   _Bool res;
   GChecksum *checksum;
   unsigned char digest[16];
@@ -402,8 +643,6 @@ nautilus_thumbnail_factory_has_valid_failed_thumbnail (NautilusThumbnailFactory
   g_checksum_get_digest (checksum, digest, &digest_len);
   g_assert (digest_len == 16);
 
-  res = FALSE;
-
   file = g_strconcat (g_checksum_get_string (checksum), ".png", NULL);
 
   path = g_build_filename (g_get_user_cache_dir (),
@@ -413,15 +652,9 @@ nautilus_thumbnail_factory_has_valid_failed_thumbnail (NautilusThumbnailFactory
 			   NULL);
   g_free (file);
 
-  pixbuf = gdk_pixbuf_new_from_file (path, NULL);
+  res = thumbnail_file_is_valid (factory, path, uri, mtime);
   g_free (path);
 
-  if (pixbuf)
-    {
-      res = nautilus_thumbnail_is_valid (pixbuf, uri, mtime);
-      g_object_unref (pixbuf);
-    }
-
   g_checksum_free (checksum);
 
   return res;
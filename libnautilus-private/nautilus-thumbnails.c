@@ -75,6 +75,12 @@
 #define NAUTILUS_THUMBNAIL_FRAME_RIGHT 3
 #define NAUTILUS_THUMBNAIL_FRAME_BOTTOM 3
 
+/* Upper bound for the number of thumbnail threads, there is one per core */
+#define MAX_THUMBNAIL_THREADS 8
+
+/* Finished thumbnails are reported to the main loop at most this often */
+#define THUMBNAIL_NOTIFY_INTERVAL_MSECS 100
+
 static void * thumbnail_thread_start (void *data);
 
 /* structure used for making thumbnails, associating a uri with where the thumbnail is to be stored */
@@ -83,6 +89,9 @@ typedef struct {
 	char *image_uri;
 	char *mime_type;
 	time_t original_file_mtime;
+	/* Being made by a thumbnail thread, lock thumbnails_mutex when
+	   accessing this */
+	_Bool thumbnailing;
 } NautilusThumbnailInfo;
 
 /*
@@ -94,13 +103,13 @@ typedef struct {
 static guint thumbnail_thread_starter_id = 0;
 
 /* Our mutex used when accessing data shared between the main thread and the
-   thumbnail thread, i.e. the thumbnail_thread_is_running flag and the
-   thumbnails_to_make list. */
+   thumbnail threads, i.e. the thumbnail_threads_running count, the
+   thumbnails_to_make list and the thumbnails_made list. */
 static pthread_mutex_t thumbnails_mutex = PTHREAD_MUTEX_INITIALIZER;
 
-/* A flag to indicate whether a thumbnail thread is running, so we don't
-   start more than one. Lock thumbnails_mutex when accessing this. */
-static volatile _Bool thumbnail_thread_is_running = FALSE;
+/* The number of thumbnail threads running, so we don't start more than
+   get_max_thumbnail_threads (). Lock thumbnails_mutex when accessing this. */
+static volatile int thumbnail_threads_running = 0;
 
 /* The list of NautilusThumbnailInfo structs containing information about the
    thumbnails we are making. Lock thumbnails_mutex when accessing this. */
@@ -109,9 +118,11 @@ static volatile GQueue thumbnails_to_make = G_QUEUE_INIT;
 /* Quickly check if uri is in thumbnails_to_make list */
 static GHashTable *thumbnails_to_make_hash = NULL;
 
-/* The currently thumbnailed icon. it also exists in the thumbnails_to_make list
- * to avoid adding it again. Lock thumbnails_mutex when accessing this. */
-static NautilusThumbnailInfo *currently_thumbnailing = NULL;
+/* Uris of the thumbnails made since the main loop was last told about
+ * them, and the id of the timeout that will. Lock thumbnails_mutex when
+ * accessing these. */
+static GList *thumbnails_made = NULL;
+static guint thumbnails_made_notify_id = 0;
 
 static NautilusThumbnailFactory *thumbnail_factory = NULL;
 
@@ -148,6 +159,20 @@ free_thumbnail_info (NautilusThumbnailInfo *info)
 	g_free (info);
 }
 
+static int
+get_max_thumbnail_threads (void)
+{
+	static int max_threads = 0;
+	long n_cpus;
+
+	if (max_threads == 0) {
+		n_cpus = sysconf (_SC_NPROCESSORS_ONLN);
+		max_threads = CLAMP (n_cpus, 1, MAX_THUMBNAIL_THREADS);
+	}
+
+	return max_threads;
+}
+
 static NautilusThumbnailFactory *
 get_thumbnail_factory (void)
 {
@@ -165,7 +190,7 @@ get_thumbnail_factory (void)
  ***************************************************************************/
 
 /* This function is added as a very low priority idle function to start the
-   thread to create any needed thumbnails. It is added with a very low priority
+   threads to create any needed thumbnails. It is added with a very low priority
    so that it doesn't delay showing the directory in the icon/list views.
    We want to show the files in the directory as quickly as possible. */
 /* Is really _Bool but glib errently defines gboolean as int */
@@ -174,6 +199,7 @@ thumbnail_thread_starter_cb (void *data)
 {
 	pthread_attr_t thread_attributes;
 	pthread_t thumbnail_thread;
+	int n_threads;
 
 	/* Don't do this in thread, since g_object_ref is not threadsafe */
 	if (thumbnail_factory == NULL) {
@@ -188,20 +214,30 @@ thumbnail_thread_starter_cb (void *data)
 #ifdef _POSIX_THREAD_ATTR_STACKSIZE
 	pthread_attr_setstacksize (&thread_attributes, 128*1024);
 #endif
+
+	pthread_mutex_lock (&thumbnails_mutex);
+
+	/* Never more threads than thumbnails waiting to be made */
+	n_threads = MIN (get_max_thumbnail_threads () - thumbnail_threads_running,
+			 (int) g_queue_get_length ((GQueue *)&thumbnails_to_make));
+
+	for (; n_threads > 0; n_threads--) {
 #ifdef DEBUG_THUMBNAILS
-	g_message ("(Main Thread) Creating thumbnails thread\n");
+		g_message ("(Main Thread) Creating thumbnails thread\n");
 #endif
-	/* We set a flag to indicate the thread is running, so we don't create
-	   a new one. We don't need to lock a mutex here, as the thumbnail
-	   thread isn't running yet. And we know we won't create the thread
-	   twice, as we also check thumbnail_thread_starter_id before
-	   scheduling this idle function. */
-	thumbnail_thread_is_running = TRUE;
-	pthread_create (&thumbnail_thread, &thread_attributes,
-			thumbnail_thread_start, NULL);
+		if (pthread_create (&thumbnail_thread, &thread_attributes,
+				    thumbnail_thread_start, NULL) != 0) {
+			break;
+		}
+		thumbnail_threads_running++;
+	}
 
 	thumbnail_thread_starter_id = 0;
 
+	pthread_mutex_unlock (&thumbnails_mutex);
+
+	pthread_attr_destroy (&thread_attributes);
+
 	return FALSE;
 }
 
@@ -222,7 +258,7 @@ nautilus_thumbnail_prioritize (const char *file_uri)
         if (thumbnails_to_make_hash) {
                 node = g_hash_table_lookup (thumbnails_to_make_hash, file_uri);
 
-                if (node && node->data != currently_thumbnailing) {
+                if (node && !((NautilusThumbnailInfo *) node->data)->thumbnailing) {
                         g_queue_unlink ((GQueue *)&thumbnails_to_make, node);
                         g_queue_push_head_link ((GQueue *)&thumbnails_to_make, node);
                 }
@@ -268,6 +304,44 @@ thumbnail_thread_notify_file_changed (void *image_uri)
 
         return FALSE;
 }
+
+/* Tells the main loop about all thumbnails made since the last time,
+   so a folder full of images does not queue one idle per image. */
+/* Is really _Bool but glib errently defines gboolean as int */
+static int
+thumbnails_made_notify_cb (void *data)
+{
+        GList *uris, *l;
+
+        pthread_mutex_lock (&thumbnails_mutex);
+        uris = thumbnails_made;
+        thumbnails_made = NULL;
+        thumbnails_made_notify_id = 0;
+        pthread_mutex_unlock (&thumbnails_mutex);
+
+        uris = g_list_reverse (uris);
+        for (l = uris; l != NULL; l = l->next) {
+                /* Frees the uri */
+                thumbnail_thread_notify_file_changed (l->data);
+        }
+        g_list_free (uris);
+
+        return FALSE;
+}
+
+/* Must be called with thumbnails_mutex locked */
+static void
+add_thumbnail_made (const char *image_uri)
+{
+        thumbnails_made = g_list_prepend (thumbnails_made, g_strdup (image_uri));
+
+        if (thumbnails_made_notify_id == 0) {
+                thumbnails_made_notify_id =
+                        g_timeout_add (THUMBNAIL_NOTIFY_INTERVAL_MSECS,
+                                       thumbnails_made_notify_cb, NULL);
+        }
+}
+
 void
 nautilus_thumbnail_remove_from_queue (const char *file_uri)
 {
@@ -285,7 +359,7 @@ nautilus_thumbnail_remove_from_queue (const char *file_uri)
         if (thumbnails_to_make_hash) {
                 node = g_hash_table_lookup (thumbnails_to_make_hash, file_uri);
 
-                if (node && node->data != currently_thumbnailing) {
+                if (node && !((NautilusThumbnailInfo *) node->data)->thumbnailing) {
                         g_hash_table_remove (thumbnails_to_make_hash, file_uri);
                         free_thumbnail_info (node->data);
                         g_queue_delete_link ((GQueue *)&thumbnails_to_make, node);
@@ -321,7 +395,7 @@ nautilus_thumbnail_remove_all_from_queue (void)
         while (l != NULL) {
                 info = l->data;
                 next = l->next;
-                if (info != currently_thumbnailing) {
+                if (!info->thumbnailing) {
                         g_hash_table_remove (thumbnails_to_make_hash,
                                              info->image_uri);
                         free_thumbnail_info (info);
@@ -566,11 +640,11 @@ nautilus_create_thumbnail (NautilusFile *file)
 		g_hash_table_insert (thumbnails_to_make_hash,
 				     info->image_uri,
 				     node);
-		/* If the thumbnail thread isn't running, and we haven't
-		   scheduled an idle function to start it up, do that now.
-		   We don't want to start it until all the other work is done,
+		/* If not all thumbnail threads are running, and we haven't
+		   scheduled an idle function to start them up, do that now.
+		   We don't want to start them until all the other work is done,
 		   so the GUI will be updated as quickly as possible.*/
-		if (thumbnail_thread_is_running == FALSE &&
+		if (thumbnail_threads_running < get_max_thumbnail_threads () &&
 		    thumbnail_thread_starter_id == 0) {
 			thumbnail_thread_starter_id =
 			g_idle_add_full (G_PRIORITY_LOW,
@@ -598,7 +672,27 @@ nautilus_create_thumbnail (NautilusFile *file)
 	pthread_mutex_unlock (&thumbnails_mutex);
 }
 
-/* thumbnail_thread is invoked as a separate thread to to make thumbnails. */
+/* Must be called with thumbnails_mutex locked. Returns the first
+ * thumbnail in the queue no other thread is making, so the order set
+ * by nautilus_thumbnail_prioritize () is kept. */
+static NautilusThumbnailInfo *
+get_next_thumbnail_to_make (void)
+{
+    NautilusThumbnailInfo *info;
+    GList *l;
+
+    for (l = thumbnails_to_make.head; l != NULL; l = l->next) {
+        info = l->data;
+        if (!info->thumbnailing) {
+            return info;
+        }
+    }
+
+    return NULL;
+}
+
+/* thumbnail_thread is invoked as a separate thread to to make thumbnails.
+ * Up to get_max_thumbnail_threads () of them share the queue. */
 static void*
 thumbnail_thread_start (void *data)
 {
@@ -607,6 +701,9 @@ thumbnail_thread_start (void *data)
     time_t current_orig_mtime = 0;
     time_t current_time;
     GList *node;
+    _Bool made;
+
+    made = FALSE;
 
     /* We loop until there are no more thumbails to make, at which point
      *   we exit the thread. */
@@ -621,43 +718,49 @@ thumbnail_thread_start (void *data)
          * MUTEX LOCKED
          *********************************/
 
-        /* Pop the last thumbnail we just made off the head of the
-         *	   list and free it. I did this here so we only have to lock
-         *	   the mutex once per thumbnail, rather than once before
-         *	   creating it and once after.
+        /* Pop the last thumbnail we just made off the list and free it.
+         *	   I did this here so we only have to lock the mutex once per
+         *	   thumbnail, rather than once before creating it and once after.
          *	   Don't pop the thumbnail off the queue if the original file
          *	   mtime of the request changed. Then we need to redo the thumbnail.
          */
-        if (currently_thumbnailing &&
-            currently_thumbnailing->original_file_mtime == current_orig_mtime)
-        {
-            g_assert (info == currently_thumbnailing);
-            node = g_hash_table_lookup (thumbnails_to_make_hash, info->image_uri);
-            g_assert (node != NULL);
-            g_hash_table_remove (thumbnails_to_make_hash, info->image_uri);
-            free_thumbnail_info (info);
-            g_queue_delete_link ((GQueue *)&thumbnails_to_make, node);
+        if (info != NULL) {
+            if (made) {
+                add_thumbnail_made (info->image_uri);
+            }
+
+            if (info->original_file_mtime == current_orig_mtime) {
+                node = g_hash_table_lookup (thumbnails_to_make_hash, info->image_uri);
+                g_assert (node != NULL);
+                g_hash_table_remove (thumbnails_to_make_hash, info->image_uri);
+                free_thumbnail_info (info);
+                g_queue_delete_link ((GQueue *)&thumbnails_to_make, node);
+            }
+            else {
+                info->thumbnailing = FALSE;
+            }
         }
-        currently_thumbnailing = NULL;
 
-        /* If there are no more thumbnails to make, reset the
-         *	   thumbnail_thread_is_running flag, unlock the mutex, and
-         *	   exit the thread. */
-        if (g_queue_is_empty ((GQueue *)&thumbnails_to_make)) {
+        /* Get the next one to make. We leave it on the list until it
+         *	   is created so the main thread doesn't add it again while we
+         *	   are creating it. */
+        info = get_next_thumbnail_to_make ();
+
+        /* If there are no more thumbnails to make, or the other threads
+         *	   have taken the rest, count this thread out, unlock the mutex,
+         *	   and exit the thread. */
+        if (info == NULL) {
             #ifdef DEBUG_THUMBNAILS
             g_message ("%s (Thumbnail Thread) Exiting\n", __func__);
             #endif
-            thumbnail_thread_is_running = FALSE;
+            thumbnail_threads_running--;
             pthread_mutex_unlock (&thumbnails_mutex);
             pthread_exit (NULL);
         }
 
-        /* Get the next one to make. We leave it on the list until it
-         *	   is created so the main thread doesn't add it again while we
-         *	   are creating it. */
-        info = g_queue_peek_head ((GQueue *)&thumbnails_to_make);
-        currently_thumbnailing = info;
+        info->thumbnailing = TRUE;
         current_orig_mtime = info->original_file_mtime;
+        made = FALSE;
         /*********************************
          * MUTEX UNLOCKED
          *********************************/
@@ -706,13 +809,11 @@ thumbnail_thread_start (void *data)
                                                                 info->image_uri,
                                                                 current_orig_mtime);
         }
-        /* We need to call nautilus_file_changed(), but I don't think that is
-         *	   thread safe. So add an idle handler and do it from the main loop. */
-        /* WEH 04/17/14: No, don't do this, it causes threads to be continuously created
-         * for each image file until the user select a different folder, cpu usage goes
-         * threw the roof, even the mouse does not have time to regenerate the cursor */
-        /*g_idle_add_full (G_PRIORITY_HIGH_IDLE,
-         *			thumbnail_thread_notify_file_changed,
-         *			g_strdup (info->image_uri), NULL);*/
+
+        /* nautilus_file_changed () is not thread safe, the main loop is
+         *	   told about finished thumbnails in batches instead, see
+         *	   thumbnails_made_notify_cb (). One idle per thumbnail kept
+         *	   the main loop too busy to even redraw the cursor. */
+        made = TRUE;
     }
 }
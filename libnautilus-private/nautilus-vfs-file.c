@@ -240,6 +240,7 @@ vfs_file_get_deep_counts (NautilusFile *file,
                           unsigned int *hidden_count,
                           goffset      *total_size)
 {
+        const NautilusFileRareDetails *rare;
         GFileType type;
 
         if (directory_count != NULL) {
@@ -263,20 +264,21 @@ vfs_file_get_deep_counts (NautilusFile *file,
         }
 
         if (file->details->deep_counts_status != NAUTILUS_REQUEST_NOT_STARTED) {
+                rare = nautilus_file_peek_rare_details (file);
                 if (directory_count != NULL) {
-                        *directory_count = file->details->deep_directory_count;
+                        *directory_count = rare->deep_directory_count;
                 }
                 if (file_count != NULL) {
-                        *file_count = file->details->deep_file_count;
+                        *file_count = rare->deep_file_count;
                 }
                 if (unreadable_directory_count != NULL) {
-                        *unreadable_directory_count = file->details->deep_unreadable_count;
+                        *unreadable_directory_count = rare->deep_unreadable_count;
                 }
                 if (total_size != NULL) {
-                        *total_size = file->details->deep_size;
+                        *total_size = rare->deep_size;
                 }
         if (hidden_count != NULL) {
-            *hidden_count = file->details->deep_hidden_count;
+            *hidden_count = rare->deep_hidden_count;
         }
                 return file->details->deep_counts_status;
         }
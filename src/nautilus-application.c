@@ -73,6 +73,7 @@
 #include <libnautilus-private/nautilus-global-preferences.h>
 #include <libnautilus-private/nautilus-lib-self-check-functions.h>
 #include <libnautilus-private/nautilus-module.h>
+#include <libnautilus-private/nautilus-search-index.h>
 #include <libnautilus-private/nautilus-settings.h>
 #include <libnautilus-private/nautilus-signaller.h>
 #include <libnautilus-private/nautilus-ui-utilities.h>
@@ -955,6 +956,9 @@ do_perform_self_checks (int *exit_status)
     /* Create self-contained settings interface object */
     nautilus_settings_perpetuate();
 
+    /* map the search index, or start building it */
+    nautilus_search_index_init ();
+
 #ifndef NAUTILUS_OMIT_SELF_CHECK
 	/* Run the checks (each twice) for nautilus and libnautilus-private. */
 
@@ -1235,6 +1239,9 @@ nautilus_application_startup (GApplication *app)
     /* Create self-contained settings interface object */
     nautilus_settings_perpetuate();
 
+    /* map the search index, or start building it */
+    nautilus_search_index_init ();
+
     /* register views */
     nautilus_icon_view_register ();
 
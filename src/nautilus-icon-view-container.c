@@ -220,6 +220,9 @@ nautilus_icon_view_container_prioritize_thumbnailing (NautilusIconContainer *con
 
 	g_assert (NAUTILUS_IS_FILE (file));
 
+	/* Called for the visible icons, the last one first */
+	nautilus_file_prioritize (file);
+
 	if (nautilus_file_is_thumbnailing (file)) {
 		uri = nautilus_file_get_uri (file);
 		nautilus_thumbnail_prioritize (uri);
@@ -227,6 +230,20 @@ nautilus_icon_view_container_prioritize_thumbnailing (NautilusIconContainer *con
 	}
 }
 
+static void
+nautilus_icon_view_container_deprioritize_thumbnailing (NautilusIconContainer *container,
+                                                        NautilusIconData      *data)
+{
+	NautilusFile *file;
+
+	file = (NautilusFile *) data;
+
+	g_assert (NAUTILUS_IS_FILE (file));
+
+	/* Called for the icons that scrolled out of view */
+	nautilus_file_deprioritize (file);
+}
+
 /*
  * Get the preference for which caption text should appear
  * beneath icons.
@@ -519,6 +536,35 @@ nautilus_icon_view_container_compare_icons (NautilusIconContainer *container,
 
 }
 
+static int
+compare_icon_data_cover (const void *a, const void *b, void *container)
+{
+	return nautilus_icon_view_container_compare_icons (container,
+							    *(NautilusIconData **) a,
+							    *(NautilusIconData **) b);
+}
+
+static void
+nautilus_icon_view_container_sort_icon_data (NautilusIconContainer *container,
+					     NautilusIconData     **data,
+					     unsigned int           n_data)
+{
+	NautilusIconView *icon_view;
+
+	icon_view = get_icon_view (container);
+	g_return_if_fail (icon_view != NULL);
+
+	/* The desktop sorts by category first */
+	if (NAUTILUS_ICON_VIEW_CONTAINER (container)->sort_for_desktop) {
+		g_qsort_with_data (data, n_data, sizeof (NautilusIconData *),
+				   compare_icon_data_cover, container);
+		return;
+	}
+
+	/* The icon data are the files */
+	nautilus_icon_view_sort_items (icon_view, (void **) data, n_data, NULL);
+}
+
 static int
 nautilus_icon_view_container_compare_icons_by_name (NautilusIconContainer *container,
 						    NautilusIconData      *icon_a,
@@ -564,9 +610,11 @@ nautilus_icon_view_container_class_init (NautilusIconViewContainerClass *klass)
 	ic_class->start_monitor_top_left = nautilus_icon_view_container_start_monitor_top_left;
 	ic_class->stop_monitor_top_left = nautilus_icon_view_container_stop_monitor_top_left;
 	ic_class->prioritize_thumbnailing = nautilus_icon_view_container_prioritize_thumbnailing;
+	ic_class->deprioritize_thumbnailing = nautilus_icon_view_container_deprioritize_thumbnailing;
 
 	ic_class->compare_icons = nautilus_icon_view_container_compare_icons;
 	ic_class->compare_icons_by_name = nautilus_icon_view_container_compare_icons_by_name;
+	ic_class->sort_icon_data = nautilus_icon_view_container_sort_icon_data;
 	ic_class->freeze_updates = nautilus_icon_view_container_freeze_updates;
 	ic_class->unfreeze_updates = nautilus_icon_view_container_unfreeze_updates;
 }
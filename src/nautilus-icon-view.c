@@ -1921,6 +1921,27 @@ icon_view_compare_files (NautilusView *view, NautilusFile *a, NautilusFile *b)
                                            icon_view->details->sort_reversed);
 }
 
+void
+nautilus_icon_view_sort_items (NautilusIconView *icon_view,
+                               void **items,
+                               unsigned int n_items,
+                               NautilusFileSortGetFunc get_file)
+{
+    nautilus_file_sort_items (items, n_items, get_file,
+                              icon_view->details->sort->sort_type,
+                              nautilus_view_should_sort_directories_first ((NautilusView *)icon_view),
+                              icon_view->details->sort_reversed);
+}
+
+static void
+icon_view_sort_items (NautilusView *view,
+                      void **items,
+                      unsigned int n_items,
+                      NautilusFileSortGetFunc get_file)
+{
+    nautilus_icon_view_sort_items ((NautilusIconView*)view, items, n_items, get_file);
+}
+
 
 void
 nautilus_icon_view_filter_by_screen (NautilusIconView *icon_view,
@@ -2713,6 +2734,7 @@ nautilus_icon_view_class_init (NautilusIconViewClass *klass)
 	view_class->set_selection                      = icon_view_set_selection;
         view_class->invert_selection                   = icon_view_invert_selection;
 	view_class->compare_files                      = icon_view_compare_files;
+	view_class->sort_items                         = icon_view_sort_items;
         view_class->click_policy_changed               = icon_view_click_policy_changed;
         view_class->merge_menus                        = icon_view_merge_menus;
         view_class->unmerge_menus                      = icon_view_unmerge_menus;
@@ -55,6 +55,10 @@ GType   nautilus_icon_view_get_type              (void);
 int     nautilus_icon_view_compare_files         (NautilusIconView   *icon_view,
                                                   NautilusFile *a,
                                                   NautilusFile *b);
+void    nautilus_icon_view_sort_items            (NautilusIconView   *icon_view,
+                                                  void              **items,
+                                                  unsigned int        n_items,
+                                                  NautilusFileSortGetFunc get_file);
 void    nautilus_icon_view_filter_by_screen      (NautilusIconView *icon_view,
                                                  _Bool filter);
 _Bool   nautilus_icon_view_is_compact            (NautilusIconView *icon_view);
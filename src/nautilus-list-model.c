@@ -703,40 +703,73 @@ nautilus_list_model_compare_func (NautilusListModel *model,
 	return result;
 }
 
+/* Sorts @items, which @get_file maps to files, into the model's order */
+void
+nautilus_list_model_sort_items (NautilusListModel *model,
+				void **items,
+				unsigned int n_items,
+				NautilusFileSortGetFunc get_file)
+{
+	nautilus_file_sort_items_by_attribute_q (items, n_items, get_file,
+						 model->details->sort_attribute,
+						 model->details->sort_directories_first,
+						 (model->details->order == GTK_SORT_DESCENDING));
+}
+
+static NautilusFile *
+file_entry_get_file (void *item)
+{
+	return ((FileEntry *) item)->file;
+}
+
+/* Same order as nautilus_list_model_file_entry_compare_func, with the
+ * entries without a file (the "Loading" and "Empty" rows) first.
+ */
 static void
-nautilus_list_model_sort_file_entries (NautilusListModel *model, GSequence *files, GtkTreePath *path)
+nautilus_list_model_sort_sequence (NautilusListModel *model, GSequence *files)
+{
+	GSequenceIter *ptr, *end;
+	FileEntry **entries;
+	FileEntry *file_entry;
+	int n_entries, i;
+
+	entries = g_new (FileEntry *, g_sequence_get_length (files));
+	n_entries = 0;
+
+	end = g_sequence_get_end_iter (files);
+	for (ptr = g_sequence_get_begin_iter (files); ptr != end; ptr = g_sequence_iter_next (ptr)) {
+		file_entry = g_sequence_get (ptr);
+		if (file_entry->file != NULL) {
+			entries[n_entries++] = file_entry;
+		}
+	}
+
+	nautilus_list_model_sort_items (model, (void **) entries, n_entries, file_entry_get_file);
+
+	for (i = 0; i < n_entries; i++) {
+		g_sequence_move (entries[i]->seq_ptr, end);
+	}
+
+	g_free (entries);
+}
+
+/* Sorts one level and tells the view, old_order holds the
+ * GSequenceIter's in their order before the sort and is freed.
+ */
+static void
+nautilus_list_model_reorder_file_entries (NautilusListModel *model, GSequence *files,
+                                          GSequenceIter **old_order, GtkTreePath *path)
 {
-    GSequenceIter **old_order;
     GtkTreeIter iter;
     int *new_order;
     int length;
     int i;
-    FileEntry *file_entry;
     _Bool has_iter;
 
     length = g_sequence_get_length (files);
 
-    if (length <= 1) {
-        return;
-    }
-
-    /* generate old order of GSequenceIter's */
-    old_order = g_new (GSequenceIter *, length);
-    for (i = 0; i < length; ++i) {
-        GSequenceIter *ptr = g_sequence_get_iter_at_pos (files, i);
-
-        file_entry = g_sequence_get (ptr);
-        if (file_entry->files != NULL) {
-            gtk_tree_path_append_index (path, i);
-            nautilus_list_model_sort_file_entries (model, file_entry->files, path);
-            gtk_tree_path_up (path);
-        }
-
-        old_order[i] = ptr;
-    }
-
     /* sort */
-    g_sequence_sort (files, nautilus_list_model_file_entry_compare_func, model);
+    nautilus_list_model_sort_sequence (model, files);
 
     /* generate new order */
     new_order = g_new (int, length);
@@ -767,6 +800,38 @@ nautilus_list_model_sort_file_entries (NautilusListModel *model, GSequence *file
     g_free (new_order);
 }
 
+static void
+nautilus_list_model_sort_file_entries (NautilusListModel *model, GSequence *files, GtkTreePath *path)
+{
+    GSequenceIter **old_order;
+    int length;
+    int i;
+    FileEntry *file_entry;
+
+    length = g_sequence_get_length (files);
+
+    if (length <= 1) {
+        return;
+    }
+
+    /* generate old order of GSequenceIter's */
+    old_order = g_new (GSequenceIter *, length);
+    for (i = 0; i < length; ++i) {
+        GSequenceIter *ptr = g_sequence_get_iter_at_pos (files, i);
+
+        file_entry = g_sequence_get (ptr);
+        if (file_entry->files != NULL) {
+            gtk_tree_path_append_index (path, i);
+            nautilus_list_model_sort_file_entries (model, file_entry->files, path);
+            gtk_tree_path_up (path);
+        }
+
+        old_order[i] = ptr;
+    }
+
+    nautilus_list_model_reorder_file_entries (model, files, old_order, path);
+}
+
 static void
 nautilus_list_model_sort (NautilusListModel *model)
 {
@@ -1036,6 +1101,101 @@ nautilus_list_model_add_file (NautilusListModel *model, NautilusFile *file,
 	return TRUE;
 }
 
+/* Adding a batch costs a sort of the whole level, inserting the files
+ * one by one costs a lookup per file. Sort when the batch is at least
+ * this fraction of the level.
+ */
+#define ADD_FILES_SORT_FRACTION 8
+
+/**
+ * nautilus_list_model_add_files:
+ * @model: A NautilusListModel.
+ * @files: The NautilusFile's to add.
+ * @directory: The directory the files are in.
+ *
+ * Adds many files to the top level at once. They are appended in the
+ * order given, then the level is sorted once and the view gets a
+ * single reorder instead of a sorted insert per file.
+ **/
+void
+nautilus_list_model_add_files (NautilusListModel *model, GList *files,
+                               NautilusDirectory *directory)
+{
+	GtkTreeIter iter;
+	GtkTreePath *path;
+	GSequenceIter **old_order;
+	GSequenceIter *ptr;
+	GSequence *top_files;
+	FileEntry *file_entry;
+	NautilusFile *file;
+	unsigned int n_files, length, i;
+	GList *l;
+
+	n_files = g_list_length (files);
+	top_files = model->details->files;
+	length = g_sequence_get_length (top_files);
+
+	/* Subdirectories have a dummy row to replace, and small batches
+	 * are cheaper to insert in place.
+	 */
+	if (g_hash_table_lookup (model->details->directory_reverse_map, directory) != NULL ||
+	    n_files < 2 ||
+	    n_files < length / ADD_FILES_SORT_FRACTION) {
+		for (l = files; l != NULL; l = l->next) {
+			nautilus_list_model_add_file (model, l->data, directory);
+		}
+		return;
+	}
+
+	for (l = files; l != NULL; l = l->next) {
+		file = l->data;
+
+		if (g_hash_table_lookup (model->details->top_reverse_map, file) != NULL) {
+			g_warning ("file already in tree!!!\n");
+			continue;
+		}
+
+		file_entry = g_new0 (FileEntry, 1);
+		file_entry->file = nautilus_file_ref (file);
+		file_entry->seq_ptr = g_sequence_append (top_files, file_entry);
+		g_hash_table_insert (model->details->top_reverse_map, file, file_entry->seq_ptr);
+
+		iter.stamp = model->details->stamp;
+		iter.user_data = file_entry->seq_ptr;
+
+		/* Appended, so the path is known without a lookup */
+		path = gtk_tree_path_new_from_indices (g_sequence_iter_get_position (file_entry->seq_ptr), -1);
+		gtk_tree_model_row_inserted (GTK_TREE_MODEL (model), path, &iter);
+
+		if (nautilus_file_is_directory (file)) {
+			file_entry->files = g_sequence_new ((GDestroyNotify)file_entry_free);
+
+			add_dummy_row (model, file_entry);
+
+			gtk_tree_model_row_has_child_toggled (GTK_TREE_MODEL (model),
+							      path, &iter);
+		}
+		gtk_tree_path_free (path);
+	}
+
+	length = g_sequence_get_length (top_files);
+	if (length <= 1) {
+		return;
+	}
+
+	old_order = g_new (GSequenceIter *, length);
+	i = 0;
+	for (ptr = g_sequence_get_begin_iter (top_files);
+	     !g_sequence_iter_is_end (ptr);
+	     ptr = g_sequence_iter_next (ptr)) {
+		old_order[i++] = ptr;
+	}
+
+	path = gtk_tree_path_new ();
+	nautilus_list_model_reorder_file_entries (model, top_files, old_order, path);
+	gtk_tree_path_free (path);
+}
+
 void
 nautilus_list_model_file_changed (NautilusListModel *model, NautilusFile *file,
                                   NautilusDirectory *directory)
@@ -70,6 +70,9 @@ unsigned int  nautilus_list_model_get_type                          (void);
 _Bool         nautilus_list_model_add_file                          (NautilusListModel    *model,
                                                                      NautilusFile         *file,
                                                                      NautilusDirectory    *directory);
+void          nautilus_list_model_add_files                         (NautilusListModel    *model,
+                                                                     GList                *files,
+                                                                     NautilusDirectory    *directory);
 void          nautilus_list_model_file_changed                      (NautilusListModel    *model,
                                                                      NautilusFile         *file,
                                                                      NautilusDirectory    *directory);
@@ -120,6 +123,10 @@ GtkTargetList    *nautilus_list_model_get_drag_target_list          (void);
 int               nautilus_list_model_compare_func                  (NautilusListModel  *model,
                                                                      NautilusFile       *file1,
                                                                      NautilusFile       *file2);
+void              nautilus_list_model_sort_items                    (NautilusListModel  *model,
+                                                                     void              **items,
+                                                                     unsigned int        n_items,
+                                                                     NautilusFileSortGetFunc get_file);
 
 
 int               nautilus_list_model_add_column                    (NautilusListModel  *model,
@@ -124,6 +124,8 @@ struct NautilusListViewDetails {
     NautilusFile   *renaming_file;
     _Bool           rename_done;
     unsigned int    renaming_file_activate_timeout;
+    unsigned int    prioritize_idle_id;
+    GHashTable     *visible_files; /* the files on screen at the last idle */
 
     unsigned long   clipboard_handler_id;
 
@@ -2038,6 +2040,90 @@ focus_in_event_callback (GtkWidget *widget, GdkEventFocus *event, void    *user_
 }
 
 
+/* Is really _Bool but glib errently defines gboolean as int */
+static int
+prioritize_visible_files (void *data)
+{
+    NautilusListView *view;
+    NautilusFile     *file;
+    GtkTreePath      *path, *end;
+    GtkTreeIter       iter;
+    GList            *files, *node;
+    GHashTable       *visible_files;
+    GHashTableIter    hash_iter;
+
+    view = NAUTILUS_LIST_VIEW (data);
+    view->details->prioritize_idle_id = 0;
+
+    /* Walk the rows on screen in the order they are shown */
+    files = NULL;
+    if (!gtk_tree_view_get_visible_range (TreeView, &path, &end)) {
+        path = end = NULL;
+    }
+    while (path != NULL && gtk_tree_path_compare (path, end) <= 0) {
+        file = nautilus_list_model_file_for_path (view->details->model, path);
+        if (file != NULL) {
+            files = g_list_prepend (files, file);
+        }
+
+        if (gtk_tree_view_row_expanded (TreeView, path)) {
+            gtk_tree_path_down (path);
+            continue;
+        }
+
+        /* Past the last child, carry on after its parent */
+        gtk_tree_path_next (path);
+        while (!gtk_tree_model_get_iter (GTK_TREE_MODEL (view->details->model), &iter, path) &&
+               gtk_tree_path_get_depth (path) > 1) {
+            gtk_tree_path_up (path);
+            gtk_tree_path_next (path);
+        }
+        if (!gtk_tree_model_get_iter (GTK_TREE_MODEL (view->details->model), &iter, path)) {
+            break;
+        }
+    }
+
+    gtk_tree_path_free (path);
+    gtk_tree_path_free (end);
+
+    visible_files = g_hash_table_new_full (g_direct_hash, g_direct_equal,
+                                           (GDestroyNotify) nautilus_file_unref, NULL);
+
+    /* The top row goes last, so it ends up first */
+    for (node = files; node != NULL; node = node->next) {
+        nautilus_file_prioritize (node->data);
+        g_hash_table_add (visible_files, node->data);
+    }
+    g_list_free (files);
+
+    /* Drop the work on what scrolled out of view since the last idle */
+    if (view->details->visible_files != NULL) {
+        g_hash_table_iter_init (&hash_iter, view->details->visible_files);
+        while (g_hash_table_iter_next (&hash_iter, (void **) &file, NULL)) {
+            if (!g_hash_table_contains (visible_files, file)) {
+                nautilus_file_deprioritize (file);
+            }
+        }
+        g_hash_table_destroy (view->details->visible_files);
+    }
+    view->details->visible_files = visible_files;
+
+    return SOURCE_REMOVE;
+}
+
+static void
+visible_range_changed_callback (GtkAdjustment *adjustment, void *callback_data)
+{
+    NautilusListView *view;
+
+    view = NAUTILUS_LIST_VIEW (callback_data);
+
+    if (view->details->prioritize_idle_id == 0) {
+        view->details->prioritize_idle_id =
+        g_idle_add (prioritize_visible_files, view);
+    }
+}
+
 static void
 create_and_setup_tree_view (NautilusListView *view)
 {
@@ -2045,6 +2131,7 @@ create_and_setup_tree_view (NautilusListView *view)
     GtkTreeViewColumn *column;
     GtkBindingSet     *binding_set;
     AtkObject         *atk_object;
+    GtkAdjustment     *adjustment;
 
     GList *nautilus_columns;
     GList *iter;
@@ -2234,6 +2321,13 @@ create_and_setup_tree_view (NautilusListView *view)
     gtk_container_add (GTK_CONTAINER (view), GTK_WIDGET (TreeView));
     gtk_widget_show (GTK_WIDGET (TreeView));
 
+    /* Fetch the files on screen first, as the view scrolls or fills */
+    adjustment = gtk_scrollable_get_vadjustment (GTK_SCROLLABLE (TreeView));
+    g_signal_connect_object (adjustment, "value-changed",
+                             G_CALLBACK (visible_range_changed_callback), view, 0);
+    g_signal_connect_object (adjustment, "changed",
+                             G_CALLBACK (visible_range_changed_callback), view, 0);
+
     atk_object = gtk_widget_get_accessible (GTK_WIDGET (TreeView));
     atk_object_set_name (atk_object, _("List View"));
 
@@ -2253,6 +2347,15 @@ list_view_add_file (NautilusView *view, NautilusFile *file, NautilusDirectory *d
 	nautilus_list_model_add_file (model, file, directory);
 }
 
+static void
+list_view_add_files (NautilusView *view, GList *files, NautilusDirectory *directory)
+{
+	NautilusListModel *model;
+
+	model = NAUTILUS_LIST_VIEW (view)->details->model;
+	nautilus_list_model_add_files (model, files, directory);
+}
+
 static char **
 get_default_visible_columns (NautilusListView *list_view)
 {
@@ -3526,6 +3629,18 @@ list_view_compare_files (NautilusView *view, NautilusFile *file1, NautilusFile *
 	return nautilus_list_model_compare_func (ListModel, file1, file2);
 }
 
+static void
+list_view_sort_items (NautilusView *view,
+		      void **items,
+		      unsigned int n_items,
+		      NautilusFileSortGetFunc get_file)
+{
+	NautilusListView *list_view;
+
+	list_view = NAUTILUS_LIST_VIEW (view);
+	nautilus_list_model_sort_items (ListModel, items, n_items, get_file);
+}
+
 static _Bool
 list_view_using_manual_layout (NautilusView *view)
 {
@@ -3553,6 +3668,12 @@ list_view_dispose (GObject *object)
   }
 
   EEL_SOURCE_REMOVE_IF_THEN_ZERO (list_view->details->renaming_file_activate_timeout);
+  EEL_SOURCE_REMOVE_IF_THEN_ZERO (list_view->details->prioritize_idle_id);
+
+  if (list_view->details->visible_files != NULL) {
+    g_hash_table_destroy (list_view->details->visible_files);
+    list_view->details->visible_files = NULL;
+  }
 
   EEL_DISCONNECT_HANDLER_IF_THEN_ZERO (nautilus_clipboard_monitor_get (), list_view->details->clipboard_handler_id)
 
@@ -3746,6 +3867,7 @@ nautilus_list_view_class_init (NautilusListViewClass *class)
     G_OBJECT_CLASS (class)->finalize             = list_view_finalize;
 
     view_class->add_file                         = list_view_add_file;
+    view_class->add_files                        = list_view_add_files;
     view_class->begin_loading                    = list_view_begin_loading;
     view_class->end_loading                      = list_view_end_loading;
     view_class->bump_zoom_level                  = list_view_bump_zoom_level;
@@ -3779,6 +3901,7 @@ nautilus_list_view_class_init (NautilusListViewClass *class)
     view_class->set_selection                    = list_view_set_selection;
     view_class->invert_selection                 = list_view_invert_selection;
     view_class->compare_files                    = list_view_compare_files;
+    view_class->sort_items                       = list_view_sort_items;
     view_class->sort_directories_first_changed   = list_view_sort_directories_first_changed;
     view_class->start_renaming_file              = list_view_start_renaming_file;
 
@@ -152,7 +152,7 @@
 
 #define DirActionGrp view->details->dir_action_group
 enum {
-    ADD_FILE,
+    ADD_FILES,
     BEGIN_FILE_CHANGES,
     BEGIN_LOADING,
     CLEAR,
@@ -1843,19 +1843,29 @@ rename_file (NautilusView *view, NautilusFile *new_file)
 }
 
 static void
-reveal_newly_added_folder (NautilusView *view, NautilusFile *new_file,
+reveal_newly_added_folder (NautilusView *view, GList *new_files,
 			   NautilusDirectory *directory, GFile *target_location)
 {
+	NautilusFile *new_file;
 	GFile *location;
+	_Bool found;
+	GList *l;
+
+	for (l = new_files; l != NULL; l = l->next) {
+		new_file = l->data;
 
-	location = nautilus_file_get_location (new_file);
-	if (g_file_equal (location, target_location)) {
-		g_signal_handlers_disconnect_by_func (view,
-						      G_CALLBACK (reveal_newly_added_folder),
-						      (void *) target_location);
-		rename_file (view, new_file);
+		location = nautilus_file_get_location (new_file);
+		found = g_file_equal (location, target_location);
+		g_object_unref (location);
+
+		if (found) {
+			g_signal_handlers_disconnect_by_func (view,
+							      G_CALLBACK (reveal_newly_added_folder),
+							      (void *) target_location);
+			rename_file (view, new_file);
+			return;
+		}
 	}
-	g_object_unref (location);
 }
 
 typedef struct {
@@ -1865,14 +1875,17 @@ typedef struct {
 
 
 static void
-track_newly_added_locations (NautilusView *view, NautilusFile *new_file,
+track_newly_added_locations (NautilusView *view, GList *new_files,
 			     NautilusDirectory *directory, void * user_data)
 {
 	NewFolderData *data;
+	GList *l;
 
 	data = user_data;
 
-	g_hash_table_insert (data->added_locations, nautilus_file_get_location (new_file), NULL);
+	for (l = new_files; l != NULL; l = l->next) {
+		g_hash_table_insert (data->added_locations, nautilus_file_get_location (l->data), NULL);
+	}
 }
 
 static void
@@ -1914,10 +1927,10 @@ new_folder_done (GFile *new_folder, _Bool success, void *user_data)
 	}
 	else {
 		/* We need to run after the default handler adds the folder we want to
-		 * operate on. The ADD_FILE signal is registered as G_SIGNAL_RUN_LAST, so we
+		 * operate on. The ADD_FILES signal is registered as G_SIGNAL_RUN_LAST, so we
 		 * must use connect_after.
 		 */
-		g_signal_connect_data (directory_view, "add_file",
+		g_signal_connect_data (directory_view, "add_files",
 				       G_CALLBACK (reveal_newly_added_folder),
 				       g_object_ref (new_folder),
 				       (GClosureNotify)g_object_unref,
@@ -1971,7 +1984,7 @@ nautilus_view_new_folder (NautilusView *directory_view)
 
 	data = new_folder_data_new (directory_view);
 
-	g_signal_connect_data (directory_view, "add_file",
+	g_signal_connect_data (directory_view, "add_files",
 			       G_CALLBACK (track_newly_added_locations),
 			       data,
 			       (GClosureNotify)NULL,
@@ -1994,7 +2007,7 @@ setup_new_folder_data (NautilusView *directory_view)
 
 	data = new_folder_data_new (directory_view);
 
-	g_signal_connect_data (directory_view, "add_file",
+	g_signal_connect_data (directory_view, "add_files",
 			       G_CALLBACK (track_newly_added_locations),
 			       data,
 			       (GClosureNotify)NULL,
@@ -3109,28 +3122,37 @@ debuting_files_data_free (DebutingFilesData *data)
  */
 static void
 debuting_files_add_file_callback (NautilusView *view,
-				  NautilusFile *new_file,
+				  GList *new_files,
 				  NautilusDirectory *directory,
 				  DebutingFilesData *data)
 {
+	NautilusFile *new_file;
 	GFile *location;
+	GList *l;
 
-	location = nautilus_file_get_location (new_file);
+	for (l = new_files; l != NULL; l = l->next) {
+		new_file = l->data;
 
-	if (g_hash_table_remove (data->debuting_files, location)) {
-		nautilus_file_ref (new_file);
-		data->added_files = g_list_prepend (data->added_files, new_file);
+		location = nautilus_file_get_location (new_file);
 
-		if (g_hash_table_size (data->debuting_files) == 0) {
-			nautilus_view_call_set_selection (view, data->added_files);
-			nautilus_view_reveal_selection (view);
-			g_signal_handlers_disconnect_by_func (view,
-							      G_CALLBACK (debuting_files_add_file_callback),
-							      data);
+		if (g_hash_table_remove (data->debuting_files, location)) {
+			nautilus_file_ref (new_file);
+			data->added_files = g_list_prepend (data->added_files, new_file);
+
+			if (g_hash_table_size (data->debuting_files) == 0) {
+				g_object_unref (location);
+
+				nautilus_view_call_set_selection (view, data->added_files);
+				nautilus_view_reveal_selection (view);
+				g_signal_handlers_disconnect_by_func (view,
+								      G_CALLBACK (debuting_files_add_file_callback),
+								      data);
+				return;
+			}
 		}
-	}
 
-	g_object_unref (location);
+		g_object_unref (location);
+	}
 }
 
 typedef struct {
@@ -3150,12 +3172,16 @@ copy_move_done_data_free (CopyMoveDoneData *data)
 
 static void
 pre_copy_move_add_file_callback (NautilusView *view,
-				 NautilusFile *new_file,
+				 GList *new_files,
 				 NautilusDirectory *directory,
 				 CopyMoveDoneData *data)
 {
-	nautilus_file_ref (new_file);
-	data->added_files = g_list_prepend (data->added_files, new_file);
+	GList *l;
+
+	for (l = new_files; l != NULL; l = l->next) {
+		data->added_files = g_list_prepend (data->added_files,
+						    nautilus_file_ref (l->data));
+	}
 }
 
 /* This needs to be called prior to nautilus_file_operations_copy_move.
@@ -3174,10 +3200,10 @@ pre_copy_move (NautilusView *directory_view)
 	eel_add_weak_pointer (&copy_move_done_data->directory_view);
 
 	/* We need to run after the default handler adds the folder we want to
-	 * operate on. The ADD_FILE signal is registered as G_SIGNAL_RUN_LAST, so we
+	 * operate on. The ADD_FILES signal is registered as G_SIGNAL_RUN_LAST, so we
 	 * must use connect_after.
 	 */
-	g_signal_connect (directory_view, "add_file",
+	g_signal_connect (directory_view, "add_files",
 			  G_CALLBACK (pre_copy_move_add_file_callback), copy_move_done_data);
 
 	return copy_move_done_data;
@@ -3258,7 +3284,7 @@ copy_move_done_callback (GHashTable *debuting_files, _Bool success, void *data)
 
 		/* Any items in the debuting_files hash table that have
 		 * "FALSE" as their value aren't really being copied
-		 * or moved, so we can't wait for an add_file signal
+		 * or moved, so we can't wait for an add_files signal
 		 * to come in for those.
 		 */
 		g_hash_table_foreach_remove (debuting_files,
@@ -3275,10 +3301,10 @@ copy_move_done_callback (GHashTable *debuting_files, _Bool success, void *data)
 			debuting_files_data_free (debuting_files_data);
 		} else {
 			/* We need to run after the default handler adds the folder we want to
-			 * operate on. The ADD_FILE signal is registered as G_SIGNAL_RUN_LAST, so we
+			 * operate on. The ADD_FILES signal is registered as G_SIGNAL_RUN_LAST, so we
 			 * must use connect_after.
 			 */
-			g_signal_connect_data (directory_view, "add_file",
+			g_signal_connect_data (directory_view, "add_files",
 					       G_CALLBACK (debuting_files_add_file_callback),
 					       debuting_files_data,
 					       (GClosureNotify) debuting_files_data_free,
@@ -3318,28 +3344,99 @@ ready_to_load (NautilusFile *file)
 					     NAUTILUS_FILE_ATTRIBUTES_FOR_ICON);
 }
 
+typedef struct {
+	NautilusView *view;
+	NautilusFileSortGetFunc get_file;
+} CompareItemsData;
+
 static int
-compare_files_cover (gconstpointer a, gconstpointer b, void *callback_data)
+compare_items_cover (const void *a, const void *b, void *callback_data)
+{
+	CompareItemsData *data;
+	NautilusFile *file_a, *file_b;
+
+	data = callback_data;
+	file_a = data->get_file != NULL ? data->get_file (*(void **) a) : *(void **) a;
+	file_b = data->get_file != NULL ? data->get_file (*(void **) b) : *(void **) b;
+
+	return NAUTILUS_VIEW_CLASS (G_OBJECT_GET_CLASS (data->view))->compare_files (data->view, file_a, file_b);
+}
+
+/* For views that only know how to compare two files */
+static void
+real_sort_items (NautilusView *view,
+		 void **items,
+		 unsigned int n_items,
+		 NautilusFileSortGetFunc get_file)
+{
+	CompareItemsData data;
+
+	data.view = view;
+	data.get_file = get_file;
+
+	g_qsort_with_data (items, n_items, sizeof (void *), compare_items_cover, &data);
+}
+
+static int
+compare_files_by_directory (const void *a, const void *b, void *callback_data)
 {
 	const FileAndDirectory *fad1, *fad2;
-	NautilusView *view;
 
-	view = callback_data;
-	fad1 = a; fad2 = b;
+	fad1 = *(FileAndDirectory **) a;
+	fad2 = *(FileAndDirectory **) b;
 
 	if (fad1->directory < fad2->directory) {
 		return -1;
 	} else if (fad1->directory > fad2->directory) {
 		return 1;
-	} else {
-		return NAUTILUS_VIEW_CLASS (G_OBJECT_GET_CLASS (view))->compare_files (view, fad1->file, fad2->file);
 	}
+	return 0;
+}
+
+static NautilusFile *
+file_and_directory_get_file (void *item)
+{
+	return ((FileAndDirectory *) item)->file;
 }
+
+/* Groups the files by directory, then sorts each group in the
+ * view's order. The list keeps its links, only their data moves.
+ */
 static void
 sort_files (NautilusView *view, GList **list)
 {
-	*list = g_list_sort_with_data (*list, compare_files_cover, view);
+	FileAndDirectory **items;
+	unsigned int n_items, start, end;
+	GList *node;
+
+	n_items = g_list_length (*list);
+	if (n_items < 2) {
+		return;
+	}
+
+	items = g_new (FileAndDirectory *, n_items);
+	for (node = *list, end = 0; node != NULL; node = node->next) {
+		items[end++] = node->data;
+	}
+
+	g_qsort_with_data (items, n_items, sizeof (FileAndDirectory *),
+			   compare_files_by_directory, NULL);
 
+	for (start = 0; start < n_items; start = end) {
+		for (end = start + 1;
+		     end < n_items && items[end]->directory == items[start]->directory;
+		     end++) {
+		}
+
+		NAUTILUS_VIEW_CLASS (G_OBJECT_GET_CLASS (view))->sort_items
+			(view, (void **) (items + start), end - start, file_and_directory_get_file);
+	}
+
+	for (node = *list, end = 0; node != NULL; node = node->next) {
+		node->data = items[end++];
+	}
+
+	g_free (items);
 }
 
 /* Go through all the new added and changed files.
@@ -3429,6 +3526,40 @@ process_new_files (NautilusView *view)
 
 }
 
+/* Adds the files in one emission per directory, keeping their order */
+static void
+emit_add_files (NautilusView *view, GList *files_added)
+{
+	GHashTable *files_by_directory;
+	GList *directories, *files, *node;
+	FileAndDirectory *pending;
+
+	files_by_directory = g_hash_table_new (NULL, NULL);
+	directories = NULL;
+
+	for (node = files_added; node != NULL; node = node->next) {
+		pending = node->data;
+
+		files = g_hash_table_lookup (files_by_directory, pending->directory);
+		if (files == NULL) {
+			directories = g_list_prepend (directories, pending->directory);
+		}
+		g_hash_table_insert (files_by_directory, pending->directory,
+				     g_list_prepend (files, pending->file));
+	}
+
+	directories = g_list_reverse (directories);
+	for (node = directories; node != NULL; node = node->next) {
+		files = g_list_reverse (g_hash_table_lookup (files_by_directory, node->data));
+		g_signal_emit (view,
+			       signals[ADD_FILES], 0, files, node->data);
+		g_list_free (files);
+	}
+
+	g_list_free (directories);
+	g_hash_table_destroy (files_by_directory);
+}
+
 static void
 process_old_files (NautilusView *view)
 {
@@ -3445,11 +3576,7 @@ process_old_files (NautilusView *view)
 	if (files_added != NULL || files_changed != NULL) {
 		g_signal_emit (view, signals[BEGIN_FILE_CHANGES], 0);
 
-		for (node = files_added; node != NULL; node = node->next) {
-			pending = node->data;
-			g_signal_emit (view,
-				       signals[ADD_FILE], 0, pending->file, pending->directory);
-		}
+		emit_add_files (view, files_added);
 
 		for (node = files_changed; node != NULL; node = node->next) {
 			pending = node->data;
@@ -3821,6 +3948,16 @@ load_error_callback (NautilusDirectory *directory,
 		       signals[LOAD_ERROR], 0, error);
 }
 
+static void
+real_add_files (NautilusView *view, GList *files, NautilusDirectory *directory)
+{
+	GList *l;
+
+	for (l = files; l != NULL; l = l->next) {
+		NAUTILUS_VIEW_CLASS (G_OBJECT_GET_CLASS (view))->add_file (view, l->data, directory);
+	}
+}
+
 static void
 real_load_error (NautilusView *view, GError *error)
 {
@@ -10145,6 +10282,8 @@ nautilus_view_class_init (NautilusViewClass *klass)
 	klass->get_selected_icon_locations  = real_get_selected_icon_locations;
 	klass->is_read_only                 = real_is_read_only;
 	klass->load_error                   = real_load_error;
+	klass->add_files                    = real_add_files;
+	klass->sort_items                   = real_sort_items;
 	klass->can_rename_file              = can_rename_file;
 	klass->start_renaming_file          = start_renaming_file;
 	klass->get_backing_uri              = real_get_backing_uri;
@@ -10174,13 +10313,13 @@ nautilus_view_class_init (NautilusViewClass *klass)
 
 	g_object_class_install_properties (oclass, NUM_PROPERTIES, properties);
 
-        signals[ADD_FILE]            = g_signal_new ("add_file",
+        signals[ADD_FILES]           = g_signal_new ("add_files",
                                                      G_TYPE_FROM_CLASS (klass),
                                                      G_SIGNAL_RUN_LAST,
-                                                     G_STRUCT_OFFSET (NautilusViewClass, add_file),
+                                                     G_STRUCT_OFFSET (NautilusViewClass, add_files),
                                                      NULL, NULL,
                                                      g_cclosure_marshal_generic,
-                                                     G_TYPE_NONE, 2, NAUTILUS_TYPE_FILE, NAUTILUS_TYPE_DIRECTORY);
+                                                     G_TYPE_NONE, 2, G_TYPE_POINTER, NAUTILUS_TYPE_DIRECTORY);
         signals[BEGIN_FILE_CHANGES]  = g_signal_new ("begin_file_changes",
                                                      G_TYPE_FROM_CLASS (klass),
                                                      G_SIGNAL_RUN_LAST,
@@ -80,7 +80,16 @@ struct NautilusViewClass {
      */
     void    	(* begin_file_changes) (NautilusView *view);
 
-    /* The 'add_file' signal is emitted to add one file to the view.
+    /* The 'add_files' signal is emitted to add a batch of files from
+     * one directory to the view. The list belongs to the emitter. The
+     * default implementation calls add_file for each file, subclasses
+     * that can add many files faster than one at a time replace it.
+     */
+    void       (* add_files)		 (NautilusView *view,
+                                  GList *files,
+                             NautilusDirectory *directory);
+
+    /* Adds one file to the view, called by the default add_files.
      * It must be replaced by each subclass.
      */
     void       (* add_file) 		 (NautilusView *view,
@@ -245,6 +254,15 @@ struct NautilusViewClass {
                                             NautilusFile    *a,
                                             NautilusFile    *b);
 
+    /* sort_items sorts @items, whose files @get_file returns, into
+     * the order of compare_files. The default calls compare_files,
+     * subclasses override it to compute each file's sort key once.
+     */
+    void    (* sort_items)                 (NautilusView *view,
+                                            void           **items,
+                                            unsigned int     n_items,
+                                            NautilusFileSortGetFunc get_file);
+
     /* using_manual_layout is a function pointer that subclasses may
      * override to control whether or not items can be freely positioned
      * on the user-visible area.
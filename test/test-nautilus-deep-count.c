@@ -0,0 +1,159 @@
+/* Deep count benchmark.
+ *
+ * Builds a synthetic tree of regular files (500000 by default), a small
+ * share of which are hard linked, then times how long the directory
+ * state machine takes to deep count it. On a tree of its own it also
+ * checks the counts, and that linked files add their size only once.
+ *
+ * Usage: test-nautilus-deep-count [number-of-files] [existing-directory]
+ */
+
+#include "test.h"
+
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <libnautilus-private/nautilus-file.h>
+#include <libnautilus-private/nautilus-file-attributes.h>
+
+#define DEFAULT_FILE_COUNT 500000
+#define FILES_PER_DIRECTORY 1000
+#define HARD_LINK_EVERY 100
+
+static GTimer *timer;
+static _Bool done;
+static _Bool failed;
+
+/* Only known for a tree we made, -1 otherwise */
+static int expected_directory_count = -1;
+static int expected_file_count = -1;
+static goffset expected_size;
+
+/* Returns the number of hard links made; the linked files hold one byte */
+static int
+create_tree (const char *root, int n_files)
+{
+	char *name, *path, *link_path;
+	int i, n_links;
+
+	n_links = 0;
+
+	for (i = 0; i < n_files; i++) {
+		name = g_strdup_printf ("d%06d/f%06d", i / FILES_PER_DIRECTORY, i);
+
+		/* Give the hard link tracking something to do */
+		if (i % HARD_LINK_EVERY == 0) {
+			path = test_tree_add_file (root, name, "x");
+			link_path = g_strconcat (path, ".link", NULL);
+			if (link (path, link_path) == 0) {
+				n_links++;
+			} else {
+				g_warning ("could not link %s", link_path);
+			}
+			g_free (link_path);
+		} else {
+			path = test_tree_add_file (root, name, NULL);
+		}
+
+		g_free (path);
+		g_free (name);
+	}
+
+	return n_links;
+}
+
+static void
+deep_count_ready (NautilusFile *file, void *callback_data)
+{
+	unsigned int directory_count, file_count, unreadable_count, hidden_count;
+	goffset total_size;
+	double elapsed;
+
+	g_timer_stop (timer);
+	elapsed = g_timer_elapsed (timer, NULL);
+
+	nautilus_file_get_deep_counts (file,
+				       &directory_count,
+				       &file_count,
+				       &unreadable_count,
+				       &hidden_count,
+				       &total_size,
+				       FALSE);
+
+	g_print ("deep count: %u directories, %u files, %u unreadable\n",
+		 directory_count, file_count, unreadable_count);
+	g_print ("deep count took %.3f s (%.0f entries/s)\n",
+		 elapsed, (directory_count + file_count) / MAX (elapsed, 1e-6));
+
+	if (expected_file_count >= 0 &&
+	    (directory_count != (unsigned int) expected_directory_count ||
+	     file_count != (unsigned int) expected_file_count ||
+	     unreadable_count != 0 ||
+	     total_size != expected_size)) {
+		g_printerr ("expected %d directories, %d files and %" G_GINT64_FORMAT " bytes, "
+			    "got %u, %u and %" G_GINT64_FORMAT "\n",
+			    expected_directory_count, expected_file_count, (gint64) expected_size,
+			    directory_count, file_count, (gint64) total_size);
+		failed = TRUE;
+	}
+
+	done = TRUE;
+	test_quit (0);
+}
+
+int
+main (int argc, char **argv)
+{
+	NautilusFile *file;
+	GFile *location;
+	char *root;
+	_Bool own_tree;
+	int n_files, n_links;
+
+	test_init (&argc, &argv);
+
+	n_files = argc > 1 ? atoi (argv[1]) : DEFAULT_FILE_COUNT;
+
+	if (argc > 2) {
+		root = g_strdup (argv[2]);
+		own_tree = FALSE;
+	} else {
+		root = test_tree_new ("nautilus-deep-count-XXXXXX");
+		if (root == NULL) {
+			return 1;
+		}
+		own_tree = TRUE;
+
+		g_print ("creating %d files in %s\n", n_files, root);
+		n_links = create_tree (root, n_files);
+
+		expected_directory_count = (n_files + FILES_PER_DIRECTORY - 1) / FILES_PER_DIRECTORY;
+		expected_file_count = n_files + n_links;
+		/* A link and its file are one inode, counted once */
+		expected_size = (n_files + HARD_LINK_EVERY - 1) / HARD_LINK_EVERY;
+	}
+
+	location = g_file_new_for_path (root);
+	file = nautilus_file_get (location);
+	g_object_unref (location);
+
+	timer = g_timer_new ();
+	nautilus_file_call_when_ready (file,
+				       NAUTILUS_FILE_ATTRIBUTE_DEEP_COUNTS,
+				       deep_count_ready,
+				       NULL);
+
+	if (!done) {
+		gtk_main ();
+	}
+
+	nautilus_file_unref (file);
+	g_timer_destroy (timer);
+
+	if (own_tree) {
+		test_tree_remove (root);
+	}
+	g_free (root);
+
+	return failed ? 1 : 0;
+}
@@ -1,9 +1,21 @@
-#include <gtk/gtk.h>
-#include <unistd.h>
+/* Without arguments, runs a search and prints the files as they come.
+ *
+ * With --benchmark, fills a directory with empty files (200000 by
+ * default) and times how long the directory takes to load them. On a
+ * directory of its own it also checks that every file was added once.
+ *
+ * Usage: test-nautilus-directory-async [--benchmark [number-of-files] [existing-directory]]
+ */
+
+#include "test.h"
+
+#include <stdlib.h>
+#include <string.h>
 
 #include <eel/eel-icons.h>
 
 #include <libnautilus-private/nautilus-directory.h>
+#include <libnautilus-private/nautilus-file.h>
 #include <libnautilus-private/nautilus-query.h>
 #include <libnautilus-private/nautilus-search-directory.h>
 
@@ -85,6 +97,120 @@ done_loading (NautilusDirectory *directory)
 	}
 }
 
+#define BENCHMARK_FILE_COUNT 200000
+
+static GTimer *benchmark_timer;
+static unsigned int benchmark_files_added;
+static GHashTable *benchmark_names_added;
+
+static void
+create_files (const char *root, int n_files)
+{
+	char *name, *path;
+	int i;
+
+	for (i = 0; i < n_files; i++) {
+		name = g_strdup_printf ("f%07d", i);
+		path = test_tree_add_file (root, name, NULL);
+		g_free (path);
+		g_free (name);
+	}
+}
+
+static void
+benchmark_files_added_cb (NautilusDirectory *directory,
+			  GList *added_files)
+{
+	GList *l;
+
+	benchmark_files_added += g_list_length (added_files);
+
+	for (l = added_files; l != NULL; l = l->next) {
+		g_hash_table_add (benchmark_names_added,
+				  nautilus_file_get_name (NAUTILUS_FILE (l->data)));
+	}
+}
+
+static void
+benchmark_done_loading_cb (NautilusDirectory *directory)
+{
+	double elapsed;
+
+	g_timer_stop (benchmark_timer);
+	elapsed = g_timer_elapsed (benchmark_timer, NULL);
+
+	g_print ("loaded %u files in %.3f s (%.0f files/s)\n",
+		 benchmark_files_added, elapsed,
+		 benchmark_files_added / MAX (elapsed, 1e-6));
+
+	gtk_main_quit ();
+}
+
+static int
+run_benchmark (int n_files, const char *existing_directory)
+{
+	NautilusDirectory *directory;
+	GFile *location;
+	char *root, *name;
+	int i, n_missing, result;
+
+	if (existing_directory != NULL) {
+		root = g_strdup (existing_directory);
+	} else {
+		root = test_tree_new ("nautilus-directory-async-XXXXXX");
+		if (root == NULL) {
+			return 1;
+		}
+
+		g_print ("creating %d files in %s\n", n_files, root);
+		create_files (root, n_files);
+	}
+
+	location = g_file_new_for_path (root);
+	directory = nautilus_directory_get (location);
+	g_object_unref (location);
+
+	g_signal_connect (directory, "files-added", G_CALLBACK (benchmark_files_added_cb), NULL);
+	g_signal_connect (directory, "done-loading", G_CALLBACK (benchmark_done_loading_cb), NULL);
+
+	benchmark_names_added = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+	benchmark_timer = g_timer_new ();
+	nautilus_directory_file_monitor_add (directory, client1, TRUE,
+					     NAUTILUS_FILE_ATTRIBUTE_INFO,
+					     NULL, NULL);
+
+	gtk_main ();
+
+	nautilus_directory_file_monitor_remove (directory, client1);
+	nautilus_directory_unref (directory);
+	g_timer_destroy (benchmark_timer);
+
+	result = 0;
+
+	if (existing_directory == NULL) {
+		n_missing = 0;
+		for (i = 0; i < n_files; i++) {
+			name = g_strdup_printf ("f%07d", i);
+			if (!g_hash_table_contains (benchmark_names_added, name)) {
+				n_missing++;
+			}
+			g_free (name);
+		}
+
+		if (n_missing > 0 || benchmark_files_added != (unsigned int) n_files) {
+			g_printerr ("%d files were never added, %u were added for %d files\n",
+				    n_missing, benchmark_files_added, n_files);
+			result = 1;
+		}
+
+		test_tree_remove (root);
+	}
+	g_free (root);
+	g_hash_table_destroy (benchmark_names_added);
+
+	return result;
+}
+
 int
 main (int argc, char **argv)
 {
@@ -95,6 +221,11 @@ main (int argc, char **argv)
 
 	gtk_init (&argc, &argv);
 
+	if (argc > 1 && strcmp (argv[1], "--benchmark") == 0) {
+		return run_benchmark (argc > 2 ? atoi (argv[2]) : BENCHMARK_FILE_COUNT,
+				      argc > 3 ? argv[3] : NULL);
+	}
+
 	query = nautilus_query_new ();
 	nautilus_query_set_text (query, "richard hult");
 	directory = nautilus_directory_get_by_uri ("x-nautilus-search://0/");
@@ -0,0 +1,84 @@
+/* Feeds the file changes queue the kind of bursts a build produces and
+ * checks how many changes coalescing folds into others.
+ *
+ * Usage: test-nautilus-file-changes-queue
+ */
+
+#include <gtk/gtk.h>
+
+#include <libnautilus-private/nautilus-file-changes-queue.h>
+
+#define N_REPEATED_CHANGES 1000
+
+static GFile *
+get_location (const char *name)
+{
+	GFile *location;
+	char *uri;
+
+	uri = g_strconcat ("file:///nautilus-changes-queue-test/", name, NULL);
+	location = g_file_new_for_uri (uri);
+	g_free (uri);
+
+	return location;
+}
+
+int
+main (int argc, char **argv)
+{
+	GFile *a, *b, *c, *d, *e, *f;
+	unsigned int queued_before, suppressed_before;
+	unsigned int queued, suppressed;
+	int i;
+
+	gtk_init (&argc, &argv);
+
+	a = get_location ("a.o");
+	b = get_location ("b.o");
+	c = get_location ("c.tmp");
+	d = get_location ("d.tmp");
+	e = get_location ("e.o");
+	f = get_location ("f.o");
+
+	nautilus_file_changes_queue_get_counts (&queued_before, &suppressed_before);
+
+	/* One change for all of them */
+	for (i = 0; i < N_REPEATED_CHANGES; i++) {
+		nautilus_file_changes_queue_file_changed (a);
+	}
+
+	/* Only the removal is left */
+	nautilus_file_changes_queue_file_added (b);
+	nautilus_file_changes_queue_file_removed (b);
+
+	/* One move from c to e */
+	nautilus_file_changes_queue_file_moved (c, d);
+	nautilus_file_changes_queue_file_moved (d, e);
+
+	/* The addition reads the file anyway */
+	nautilus_file_changes_queue_file_added (f);
+	nautilus_file_changes_queue_file_changed (f);
+
+	nautilus_file_changes_queue_get_counts (&queued, &suppressed);
+	queued -= queued_before;
+	suppressed -= suppressed_before;
+
+	g_print ("%u changes queued, %u suppressed\n", queued, suppressed);
+
+	nautilus_file_changes_consume_changes (TRUE);
+
+	g_object_unref (a);
+	g_object_unref (b);
+	g_object_unref (c);
+	g_object_unref (d);
+	g_object_unref (e);
+	g_object_unref (f);
+
+	if (queued != 5 || suppressed != N_REPEATED_CHANGES + 2) {
+		g_printerr ("expected 5 changes queued and %d suppressed\n",
+			    N_REPEATED_CHANGES + 2);
+		return 1;
+	}
+
+	return 0;
+}
@@ -0,0 +1,290 @@
+/* File info latency benchmark.
+ *
+ * Asks for the file info of files (200 by default) in a directory whose
+ * backend answers every query after a delay, like a network mount, and
+ * times how long it takes until the info of all files is ready. Fetching
+ * one file at a time would take the number of files times the delay.
+ *
+ * The backend is a GFile that wraps a local file and sleeps in
+ * query_info. GFile's default query_info_async runs that in a thread,
+ * the way a remote backend waits on the network.
+ *
+ * Usage: test-nautilus-file-info-latency [number-of-files [latency-in-ms]]
+ */
+
+#include "test.h"
+
+#include <stdlib.h>
+
+#include <libnautilus-private/nautilus-file.h>
+#include <libnautilus-private/nautilus-file-attributes.h>
+
+#define DEFAULT_FILE_COUNT 200
+#define DEFAULT_LATENCY_MSECS 5
+
+typedef struct {
+	GObject parent;
+	GFile *real;
+} SlowFile;
+
+typedef struct {
+	GObjectClass parent_class;
+} SlowFileClass;
+
+static void slow_file_file_iface_init (GFileIface *iface);
+
+G_DEFINE_TYPE_WITH_CODE (SlowFile, slow_file, G_TYPE_OBJECT,
+			 G_IMPLEMENT_INTERFACE (G_TYPE_FILE, slow_file_file_iface_init))
+
+#define SLOW_FILE(obj) (G_TYPE_CHECK_INSTANCE_CAST ((obj), slow_file_get_type (), SlowFile))
+
+static gulong latency_usecs;
+static int n_ready;
+
+static GFile *
+slow_file_new (GFile *real)
+{
+	SlowFile *file;
+
+	if (real == NULL) {
+		return NULL;
+	}
+
+	file = g_object_new (slow_file_get_type (), NULL);
+	file->real = real;
+
+	return G_FILE (file);
+}
+
+static void
+slow_file_finalize (GObject *object)
+{
+	g_object_unref (SLOW_FILE (object)->real);
+
+	G_OBJECT_CLASS (slow_file_parent_class)->finalize (object);
+}
+
+static void
+slow_file_init (SlowFile *file)
+{
+}
+
+static void
+slow_file_class_init (SlowFileClass *class)
+{
+	G_OBJECT_CLASS (class)->finalize = slow_file_finalize;
+}
+
+static GFile *
+slow_file_dup (GFile *file)
+{
+	return slow_file_new (g_file_dup (SLOW_FILE (file)->real));
+}
+
+static unsigned int
+slow_file_hash (GFile *file)
+{
+	return g_file_hash (SLOW_FILE (file)->real);
+}
+
+static gboolean
+slow_file_equal (GFile *file1, GFile *file2)
+{
+	return g_file_equal (SLOW_FILE (file1)->real, SLOW_FILE (file2)->real);
+}
+
+static gboolean
+slow_file_is_native (GFile *file)
+{
+	return FALSE;
+}
+
+static gboolean
+slow_file_has_uri_scheme (GFile *file, const char *uri_scheme)
+{
+	return g_file_has_uri_scheme (SLOW_FILE (file)->real, uri_scheme);
+}
+
+static char *
+slow_file_get_uri_scheme (GFile *file)
+{
+	return g_file_get_uri_scheme (SLOW_FILE (file)->real);
+}
+
+static char *
+slow_file_get_basename (GFile *file)
+{
+	return g_file_get_basename (SLOW_FILE (file)->real);
+}
+
+static char *
+slow_file_get_path (GFile *file)
+{
+	return NULL;
+}
+
+static char *
+slow_file_get_uri (GFile *file)
+{
+	return g_file_get_uri (SLOW_FILE (file)->real);
+}
+
+static char *
+slow_file_get_parse_name (GFile *file)
+{
+	return g_file_get_parse_name (SLOW_FILE (file)->real);
+}
+
+static GFile *
+slow_file_get_parent (GFile *file)
+{
+	return slow_file_new (g_file_get_parent (SLOW_FILE (file)->real));
+}
+
+static gboolean
+slow_file_prefix_matches (GFile *prefix, GFile *file)
+{
+	return g_file_has_prefix (SLOW_FILE (file)->real, SLOW_FILE (prefix)->real);
+}
+
+static char *
+slow_file_get_relative_path (GFile *parent, GFile *descendant)
+{
+	return g_file_get_relative_path (SLOW_FILE (parent)->real, SLOW_FILE (descendant)->real);
+}
+
+static GFile *
+slow_file_resolve_relative_path (GFile *file, const char *relative_path)
+{
+	return slow_file_new (g_file_resolve_relative_path (SLOW_FILE (file)->real, relative_path));
+}
+
+static GFile *
+slow_file_get_child_for_display_name (GFile *file, const char *display_name, GError **error)
+{
+	return slow_file_new (g_file_get_child_for_display_name (SLOW_FILE (file)->real,
+								 display_name, error));
+}
+
+static GFileInfo *
+slow_file_query_info (GFile *file,
+		      const char *attributes,
+		      GFileQueryInfoFlags flags,
+		      GCancellable *cancellable,
+		      GError **error)
+{
+	g_usleep (latency_usecs);
+
+	return g_file_query_info (SLOW_FILE (file)->real, attributes, flags, cancellable, error);
+}
+
+static void
+slow_file_file_iface_init (GFileIface *iface)
+{
+	iface->dup = slow_file_dup;
+	iface->hash = slow_file_hash;
+	iface->equal = slow_file_equal;
+	iface->is_native = slow_file_is_native;
+	iface->has_uri_scheme = slow_file_has_uri_scheme;
+	iface->get_uri_scheme = slow_file_get_uri_scheme;
+	iface->get_basename = slow_file_get_basename;
+	iface->get_path = slow_file_get_path;
+	iface->get_uri = slow_file_get_uri;
+	iface->get_parse_name = slow_file_get_parse_name;
+	iface->get_parent = slow_file_get_parent;
+	iface->prefix_matches = slow_file_prefix_matches;
+	iface->get_relative_path = slow_file_get_relative_path;
+	iface->resolve_relative_path = slow_file_resolve_relative_path;
+	iface->get_child_for_display_name = slow_file_get_child_for_display_name;
+	iface->query_info = slow_file_query_info;
+}
+
+static void
+info_ready_callback (NautilusFile *file, void *callback_data)
+{
+	n_ready++;
+
+	if (n_ready == GPOINTER_TO_INT (callback_data)) {
+		gtk_main_quit ();
+	}
+}
+
+int
+main (int argc, char **argv)
+{
+	NautilusFile **files;
+	GFile *directory, *location;
+	GTimer *timer;
+	char *path, *name, *filename;
+	double elapsed, serial;
+	int n_files, latency_msecs, i;
+
+	gtk_init (&argc, &argv);
+
+	n_files = argc > 1 ? atoi (argv[1]) : DEFAULT_FILE_COUNT;
+	latency_msecs = argc > 2 ? atoi (argv[2]) : DEFAULT_LATENCY_MSECS;
+	if (n_files <= 0 || latency_msecs <= 0) {
+		g_printerr ("usage: test-nautilus-file-info-latency [number-of-files [latency-in-ms]]\n");
+		return 1;
+	}
+	latency_usecs = latency_msecs * 1000;
+
+	path = test_tree_new ("nautilus-file-info-latency-XXXXXX");
+	if (path == NULL) {
+		return 1;
+	}
+
+	for (i = 0; i < n_files; i++) {
+		name = g_strdup_printf ("file-%05d.txt", i);
+		filename = test_tree_add_file (path, name, name);
+		g_free (filename);
+		g_free (name);
+	}
+
+	directory = slow_file_new (g_file_new_for_path (path));
+	files = g_new (NautilusFile *, n_files);
+
+	for (i = 0; i < n_files; i++) {
+		name = g_strdup_printf ("file-%05d.txt", i);
+		location = g_file_get_child (directory, name);
+		files[i] = nautilus_file_get (location);
+		g_object_unref (location);
+		g_free (name);
+	}
+
+	timer = g_timer_new ();
+
+	for (i = 0; i < n_files; i++) {
+		nautilus_file_call_when_ready (files[i],
+					       NAUTILUS_FILE_ATTRIBUTE_INFO,
+					       info_ready_callback,
+					       GINT_TO_POINTER (n_files));
+	}
+	if (n_ready < n_files) {
+		gtk_main ();
+	}
+
+	elapsed = g_timer_elapsed (timer, NULL);
+	serial = (double) n_files * latency_msecs / 1000;
+
+	g_print ("%d files, %d ms per query\n", n_files, latency_msecs);
+	g_print ("all info ready after %.3f s, one at a time would take %.3f s\n",
+		 elapsed, serial);
+
+	for (i = 0; i < n_files; i++) {
+		nautilus_file_unref (files[i]);
+	}
+	test_tree_remove (path);
+
+	g_free (files);
+	g_timer_destroy (timer);
+	g_object_unref (directory);
+	g_free (path);
+
+	if (elapsed > serial / 2) {
+		g_printerr ("file info was not fetched concurrently\n");
+		return 1;
+	}
+
+	return 0;
+}
@@ -0,0 +1,152 @@
+/* File memory benchmark.
+ *
+ * Creates NautilusFiles (100000 by default) from infos like the ones a
+ * directory load hands over, and prints how many bytes of heap each
+ * file takes, next to the size of the file structures themselves. Fails
+ * if a file takes more than its structures and the strings of a plain
+ * directory entry, or allocates its rare details.
+ *
+ * Usage: test-nautilus-file-memory [number-of-files]
+ */
+
+#include <config.h>
+
+#include <stdlib.h>
+#include <gtk/gtk.h>
+
+#ifdef HAVE_MALLOC_H
+#include <malloc.h>
+#endif
+
+#include <libnautilus-private/nautilus-directory.h>
+#include <libnautilus-private/nautilus-file.h>
+#include <libnautilus-private/nautilus-file-private.h>
+
+#define DEFAULT_FILE_COUNT 100000
+
+/* Names, collation keys and allocator overhead of one file */
+#define MAX_STRING_BYTES_PER_FILE 384
+
+static size_t
+get_heap_in_use (void)
+{
+#if defined (HAVE_MALLINFO2)
+	struct mallinfo2 info;
+
+	info = mallinfo2 ();
+	return info.uordblks + info.hblkhd;
+#elif defined (__GLIBC__)
+	/* Wraps around past 4 GB */
+	struct mallinfo info;
+
+	info = mallinfo ();
+	return (size_t) (unsigned int) info.uordblks + (size_t) (unsigned int) info.hblkhd;
+#else
+	return 0;
+#endif
+}
+
+static GFileInfo *
+make_info (int i)
+{
+	GFileInfo *info;
+	GTimeVal mtime;
+	char *name;
+
+	name = g_strdup_printf ("file-%07d.txt", i);
+
+	info = g_file_info_new ();
+	g_file_info_set_name (info, name);
+	g_file_info_set_display_name (info, name);
+	g_file_info_set_file_type (info, G_FILE_TYPE_REGULAR);
+	g_file_info_set_content_type (info, "text/plain");
+	g_file_info_set_size (info, i * 17);
+
+	mtime.tv_sec = 1300000000 + i;
+	mtime.tv_usec = 0;
+	g_file_info_set_modification_time (info, &mtime);
+
+	g_free (name);
+
+	return info;
+}
+
+int
+main (int argc, char **argv)
+{
+	NautilusDirectory *directory;
+	GPtrArray *files;
+	GFileInfo *info;
+	size_t heap_before, heap_after, max_bytes_per_file;
+	double bytes_per_file;
+	int n_files, n_rare, i;
+
+	/* Otherwise the slice allocator hides the files from malloc */
+	g_setenv ("G_SLICE", "always-malloc", TRUE);
+
+	gtk_init (&argc, &argv);
+
+	n_files = argc > 1 ? atoi (argv[1]) : DEFAULT_FILE_COUNT;
+	if (n_files <= 0) {
+		g_printerr ("usage: test-nautilus-file-memory [number-of-files]\n");
+		return 1;
+	}
+
+	directory = nautilus_directory_get_by_uri ("file:///nautilus-file-memory-test");
+	files = g_ptr_array_new_full (n_files + 1, (GDestroyNotify) nautilus_file_unref);
+
+	/* The first file pays for the class and the shared strings */
+	info = make_info (-1);
+	g_ptr_array_add (files, nautilus_file_new_from_info (directory, info));
+	g_object_unref (info);
+
+	heap_before = get_heap_in_use ();
+
+	for (i = 0; i < n_files; i++) {
+		info = make_info (i);
+		g_ptr_array_add (files, nautilus_file_new_from_info (directory, info));
+		g_object_unref (info);
+	}
+
+	heap_after = get_heap_in_use ();
+
+	g_print ("%d files\n", n_files);
+	g_print ("NautilusFile: %u bytes, NautilusFileDetails: %u bytes, rare details: %u bytes\n",
+		 (unsigned int) sizeof (NautilusFile),
+		 (unsigned int) sizeof (NautilusFileDetails),
+		 (unsigned int) sizeof (NautilusFileRareDetails));
+
+	n_rare = 0;
+	for (i = 0; i < (int) files->len; i++) {
+		if (NAUTILUS_FILE (g_ptr_array_index (files, i))->details->rare != NULL) {
+			n_rare++;
+		}
+	}
+
+	max_bytes_per_file = sizeof (NautilusFile) + sizeof (NautilusFileDetails) +
+		MAX_STRING_BYTES_PER_FILE;
+	bytes_per_file = -1;
+
+	if (heap_after > heap_before) {
+		bytes_per_file = (double) (heap_after - heap_before) / n_files;
+		g_print ("heap: %.1f bytes per file, at most %u expected\n",
+			 bytes_per_file, (unsigned int) max_bytes_per_file);
+	} else {
+		g_print ("heap: not measurable here\n");
+	}
+
+	g_ptr_array_free (files, TRUE);
+	nautilus_directory_unref (directory);
+
+	if (n_rare > 0) {
+		g_printerr ("%d files allocated rare details\n", n_rare);
+		return 1;
+	}
+
+	if (bytes_per_file > max_bytes_per_file) {
+		g_printerr ("files take more heap than expected\n");
+		return 1;
+	}
+
+	return 0;
+}
@@ -0,0 +1,126 @@
+/* Icon grid scroll benchmark.
+ *
+ * Lays out a synthetic icon view (50000 icons by default) the way the
+ * icon container does in auto layout, then scrolls a window sized
+ * viewport over it from top to bottom and times how long finding the
+ * visible icons takes with the icon grid and with a scan of every icon.
+ *
+ * Usage: test-nautilus-icon-grid [number-of-icons]
+ */
+
+#include <stdlib.h>
+#include <glib.h>
+
+#include <libnautilus-private/nautilus-icon-grid.h>
+
+#define DEFAULT_ICON_COUNT 50000
+#define ICONS_PER_ROW 12
+#define ICON_WIDTH 96
+#define ICON_HEIGHT 96
+#define LABEL_HEIGHT 40
+#define CELL_SIZE 256
+
+#define VIEWPORT_WIDTH 1280
+#define VIEWPORT_HEIGHT 800
+#define SCROLL_STEP 40
+
+typedef struct {
+	double x, y;
+	double x0, y0, x1, y1;
+} Icon;
+
+static _Bool
+icon_is_visible (const Icon *icon, double y0, double y1)
+{
+	return icon->y1 >= y0 && icon->y0 <= y1;
+}
+
+int
+main (int argc, char **argv)
+{
+	NautilusIconGrid *grid;
+	GPtrArray *candidates;
+	GTimer *timer;
+	Icon *icons;
+	double height, y;
+	double grid_time, scan_time;
+	int n_icons, n_steps, i;
+	unsigned int k;
+	long grid_visible, scan_visible;
+
+	n_icons = argc > 1 ? atoi (argv[1]) : DEFAULT_ICON_COUNT;
+	if (n_icons <= 0) {
+		g_printerr ("usage: test-nautilus-icon-grid [number-of-icons]\n");
+		return 1;
+	}
+
+	icons = g_new (Icon, n_icons);
+	grid = nautilus_icon_grid_new (CELL_SIZE);
+
+	for (i = 0; i < n_icons; i++) {
+		icons[i].x = (i % ICONS_PER_ROW) * (ICON_WIDTH + 8);
+		icons[i].y = (i / ICONS_PER_ROW) * (ICON_HEIGHT + LABEL_HEIGHT + 8);
+
+		/* Every third label wraps to a second line */
+		icons[i].x0 = icons[i].x;
+		icons[i].y0 = icons[i].y;
+		icons[i].x1 = icons[i].x + ICON_WIDTH;
+		icons[i].y1 = icons[i].y + ICON_HEIGHT + LABEL_HEIGHT * (i % 3 == 0 ? 2 : 1);
+
+		nautilus_icon_grid_set_position (grid, &icons[i], icons[i].x, icons[i].y);
+		nautilus_icon_grid_include_bounds (grid, icons[i].x, icons[i].y,
+						   icons[i].x0, icons[i].y0,
+						   icons[i].x1, icons[i].y1);
+	}
+
+	height = icons[n_icons - 1].y1;
+	n_steps = 0;
+
+	candidates = g_ptr_array_new ();
+	timer = g_timer_new ();
+
+	grid_visible = 0;
+	g_timer_start (timer);
+	for (y = 0; y < height; y += SCROLL_STEP) {
+		g_ptr_array_set_size (candidates, 0);
+		nautilus_icon_grid_query (grid, -G_MAXDOUBLE, y, G_MAXDOUBLE, y + VIEWPORT_HEIGHT,
+					  candidates);
+		for (k = 0; k < candidates->len; k++) {
+			if (icon_is_visible (g_ptr_array_index (candidates, k), y, y + VIEWPORT_HEIGHT)) {
+				grid_visible++;
+			}
+		}
+		n_steps++;
+	}
+	g_timer_stop (timer);
+	grid_time = g_timer_elapsed (timer, NULL);
+
+	scan_visible = 0;
+	g_timer_start (timer);
+	for (y = 0; y < height; y += SCROLL_STEP) {
+		for (i = 0; i < n_icons; i++) {
+			if (icon_is_visible (&icons[i], y, y + VIEWPORT_HEIGHT)) {
+				scan_visible++;
+			}
+		}
+	}
+	g_timer_stop (timer);
+	scan_time = g_timer_elapsed (timer, NULL);
+
+	g_print ("%d icons, %d scroll steps of %d px\n", n_icons, n_steps, SCROLL_STEP);
+	g_print ("grid: %.3f ms per step\n", grid_time * 1000 / n_steps);
+	g_print ("scan: %.3f ms per step\n", scan_time * 1000 / n_steps);
+
+	g_ptr_array_free (candidates, TRUE);
+	g_timer_destroy (timer);
+	nautilus_icon_grid_free (grid);
+	g_free (icons);
+
+	if (grid_visible != scan_visible) {
+		g_printerr ("grid found %ld visible icons, scan found %ld\n",
+			    grid_visible, scan_visible);
+		return 1;
+	}
+
+	return 0;
+}
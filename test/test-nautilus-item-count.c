@@ -0,0 +1,152 @@
+/* Item count benchmark.
+ *
+ * Makes a directory with many subdirectories (5000 by default), each
+ * holding a few files, and times counting the items of every one with
+ * a GFileEnumerator, with nautilus_item_count_local_directory () and
+ * with it again once the counts are cached. All three have to agree.
+ *
+ * Usage: test-nautilus-item-count [number-of-directories]
+ */
+
+#include "test.h"
+
+#include <stdlib.h>
+#include <utime.h>
+#include <glib/gstdio.h>
+
+#include <libnautilus-private/nautilus-item-count.h>
+
+#define DEFAULT_DIRECTORY_COUNT 5000
+#define FILES_PER_DIRECTORY 4
+
+static int
+count_with_enumerator (const char *path)
+{
+	GFileEnumerator *enumerator;
+	GFileInfo *info;
+	GFile *location;
+	int count;
+
+	location = g_file_new_for_path (path);
+	enumerator = g_file_enumerate_children (location,
+						G_FILE_ATTRIBUTE_STANDARD_NAME ","
+						G_FILE_ATTRIBUTE_STANDARD_IS_HIDDEN ","
+						G_FILE_ATTRIBUTE_STANDARD_IS_BACKUP,
+						G_FILE_QUERY_INFO_NOFOLLOW_SYMLINKS,
+						NULL, NULL);
+	g_object_unref (location);
+
+	if (enumerator == NULL) {
+		return -1;
+	}
+
+	count = 0;
+	while ((info = g_file_enumerator_next_file (enumerator, NULL, NULL)) != NULL) {
+		count++;
+		g_object_unref (info);
+	}
+	g_object_unref (enumerator);
+
+	return count;
+}
+
+static double
+count_all (char **paths, int n_directories, int *counts, _Bool with_enumerator)
+{
+	GTimer *timer;
+	double elapsed;
+	int i;
+
+	timer = g_timer_new ();
+	for (i = 0; i < n_directories; i++) {
+		if (with_enumerator) {
+			counts[i] = count_with_enumerator (paths[i]);
+		} else if (!nautilus_item_count_local_directory (paths[i], &counts[i])) {
+			counts[i] = -1;
+		}
+	}
+	elapsed = g_timer_elapsed (timer, NULL);
+	g_timer_destroy (timer);
+
+	return elapsed;
+}
+
+int
+main (int argc, char **argv)
+{
+	struct utimbuf old_times;
+	char **paths;
+	char *path, *name, *filename;
+	int *expected, *cold, *cached;
+	double enumerator_time, cold_time, cached_time;
+	int n_directories, i, j, n_wrong;
+
+	g_type_init ();
+
+	n_directories = argc > 1 ? atoi (argv[1]) : DEFAULT_DIRECTORY_COUNT;
+	if (n_directories <= 0) {
+		g_printerr ("usage: test-nautilus-item-count [number-of-directories]\n");
+		return 1;
+	}
+
+	path = test_tree_new ("nautilus-item-count-XXXXXX");
+	if (path == NULL) {
+		return 1;
+	}
+
+	/* Old enough for the counts to be cached */
+	old_times.actime = time (NULL) - 60 * 60;
+	old_times.modtime = old_times.actime;
+
+	paths = g_new0 (char *, n_directories + 1);
+	for (i = 0; i < n_directories; i++) {
+		name = g_strdup_printf ("directory-%05d", i);
+		paths[i] = test_tree_add_directory (path, name);
+		g_free (name);
+
+		for (j = 0; j < i % (FILES_PER_DIRECTORY + 1); j++) {
+			name = g_strdup_printf ("%sfile-%d", j == 0 ? "." : "", j);
+			filename = test_tree_add_file (paths[i], name, name);
+			g_free (filename);
+			g_free (name);
+		}
+
+		g_utime (paths[i], &old_times);
+	}
+
+	expected = g_new (int, n_directories);
+	cold = g_new (int, n_directories);
+	cached = g_new (int, n_directories);
+
+	enumerator_time = count_all (paths, n_directories, expected, TRUE);
+	cold_time = count_all (paths, n_directories, cold, FALSE);
+	cached_time = count_all (paths, n_directories, cached, FALSE);
+
+	n_wrong = 0;
+	for (i = 0; i < n_directories; i++) {
+		if (expected[i] != i % (FILES_PER_DIRECTORY + 1) ||
+		    cold[i] != expected[i] ||
+		    cached[i] != expected[i]) {
+			n_wrong++;
+		}
+	}
+
+	g_print ("%d directories\n", n_directories);
+	g_print ("enumerator: %.3f s, item count: %.3f s, cached: %.3f s\n",
+		 enumerator_time, cold_time, cached_time);
+
+	test_tree_remove (path);
+
+	g_strfreev (paths);
+	g_free (expected);
+	g_free (cold);
+	g_free (cached);
+	g_free (path);
+
+	if (n_wrong > 0) {
+		g_printerr ("%d directories were counted wrong\n", n_wrong);
+		return 1;
+	}
+
+	return 0;
+}
@@ -1,6 +1,8 @@
 #include "test.h"
+#include <errno.h>
 #include <sys/types.h>
 #include <unistd.h>
+#include <glib/gstdio.h>
 
 void
 test_init (int *argc,
@@ -115,3 +117,92 @@ test_window_set_title_with_pid (GtkWindow *window,
 	g_free (tmp);
 }
 
+
+char *
+test_tree_new (const char *name_template)
+{
+	char *root;
+	GError *error;
+
+	error = NULL;
+	root = g_dir_make_tmp (name_template, &error);
+	if (root == NULL) {
+		g_printerr ("could not create a temporary directory: %s\n", error->message);
+		g_error_free (error);
+	}
+
+	return root;
+}
+
+char *
+test_tree_add_directory (const char *root,
+			 const char *relative_path)
+{
+	char *path;
+
+	path = g_build_filename (root, relative_path, NULL);
+	if (g_mkdir_with_parents (path, 0755) != 0) {
+		g_warning ("could not create %s", path);
+	}
+
+	return path;
+}
+
+char *
+test_tree_add_file (const char *root,
+		    const char *relative_path,
+		    const char *contents)
+{
+	char *path, *parent;
+	int fd;
+
+	path = g_build_filename (root, relative_path, NULL);
+
+	if (contents != NULL) {
+		parent = g_path_get_dirname (path);
+		g_mkdir_with_parents (parent, 0755);
+		g_free (parent);
+
+		if (!g_file_set_contents (path, contents, -1, NULL)) {
+			g_warning ("could not create %s", path);
+		}
+		return path;
+	}
+
+	/* Only look at the parents when they are missing, trees are big */
+	fd = g_creat (path, 0644);
+	if (fd < 0 && errno == ENOENT) {
+		parent = g_path_get_dirname (path);
+		g_mkdir_with_parents (parent, 0755);
+		g_free (parent);
+		fd = g_creat (path, 0644);
+	}
+
+	if (fd >= 0) {
+		close (fd);
+	} else {
+		g_warning ("could not create %s", path);
+	}
+
+	return path;
+}
+
+void
+test_tree_remove (const char *root)
+{
+	GDir *dir;
+	const char *name;
+	char *child;
+
+	dir = g_dir_open (root, 0, NULL);
+	if (dir != NULL) {
+		while ((name = g_dir_read_name (dir)) != NULL) {
+			child = g_build_filename (root, name, NULL);
+			test_tree_remove (child);
+			g_free (child);
+		}
+		g_dir_close (dir);
+	}
+
+	g_remove (root);
+}
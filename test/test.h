@@ -35,4 +35,16 @@ void       test_pixbuf_draw_rectangle_tiled     (GdkPixbuf                   *pi
 void       test_window_set_title_with_pid       (GtkWindow                   *window,
 						 const char                  *title);
 
+/* Temporary trees of files. Paths are relative to the root, missing
+ * parent directories are created, and the paths returned are full ones
+ * for the caller to free.
+ */
+char      *test_tree_new                        (const char                  *name_template);
+char      *test_tree_add_directory              (const char                  *root,
+						 const char                  *relative_path);
+char      *test_tree_add_file                   (const char                  *root,
+						 const char                  *relative_path,
+						 const char                  *contents);
+void       test_tree_remove                     (const char                  *root);
+
 #endif /* TEST_H */